@@ -0,0 +1,122 @@
+#ifndef __ADAPTIVE_BENCH_HPP__
+#define __ADAPTIVE_BENCH_HPP__
+
+#include <chrono>
+#include <cmath>
+
+// Adaptive benchmark driver.
+// Samples are first taken in windows of warmup_window until two consecutive window means agree
+// within warmup_threshold (or max_warmup samples were spent); those samples are discarded.
+// Measurement then continues until the 95% confidence interval of the mean is within
+// +-tolerance of the mean, the time budget expires or max_samples were taken.
+typedef struct {
+    double tolerance;        // relative half width of the 95% confidence interval
+    double time_budget;      // seconds, warm-up included
+    int min_samples;
+    int max_samples;
+    int warmup_window;
+    int max_warmup;
+    double warmup_threshold; // relative difference of consecutive window means
+} adaptive_config;
+
+typedef struct {
+    int warmup_samples;
+    int samples;
+    double mean;
+    double stddev;
+    double ci_half_width;    // absolute, same unit as the samples
+    bool converged;          // stopped on the tolerance rather than on a budget
+    double elapsed;          // seconds
+} adaptive_result;
+
+const adaptive_config default_adaptive_config = {
+    .tolerance = 0.01,
+    .time_budget = 10.0,
+    .min_samples = 10,
+    .max_samples = 100000,
+    .warmup_window = 8,
+    .max_warmup = 256,
+    .warmup_threshold = 0.02,
+};
+
+// Two sided 95% quantile of Student's t distribution
+inline double t_quantile_95(int dof){
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if (dof < 1){
+        return INFINITY;
+    }
+    if (dof <= 30){
+        return table[dof - 1];
+    }
+    if (dof <= 60){
+        return 2.000;
+    }
+    if (dof <= 120){
+        return 1.980;
+    }
+    return 1.960;
+}
+
+// sample(bool warmup) performs one measurement and returns its value, warmup tells whether
+// the value will be discarded.
+template <typename F>
+adaptive_result run_adaptive(const adaptive_config& config, F sample){
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    auto elapsed = [&](){
+        return std::chrono::duration<double>(clock::now() - start).count();
+    };
+
+    adaptive_result result = {};
+
+    // Warm-up
+    double previous_window = -1.0;
+    while (result.warmup_samples < config.max_warmup && elapsed() < config.time_budget){
+        double window = 0.0;
+        for (int i = 0; i < config.warmup_window; i++){
+            window += sample(true);
+        }
+        window /= config.warmup_window;
+        result.warmup_samples += config.warmup_window;
+        if (previous_window > 0.0 && std::fabs(window - previous_window) <= config.warmup_threshold * previous_window){
+            break;
+        }
+        previous_window = window;
+    }
+
+    // Measurement, Welford's running mean and variance
+    double mean = 0.0;
+    double m2 = 0.0;
+    int n = 0;
+    while (n < config.max_samples){
+        double value = sample(false);
+        n++;
+        double delta = value - mean;
+        mean += delta / n;
+        m2 += delta * (value - mean);
+        if (n >= config.min_samples && n >= 2){
+            double stddev = std::sqrt(m2 / (n - 1));
+            double half_width = t_quantile_95(n - 1) * stddev / std::sqrt((double)n);
+            if (half_width <= config.tolerance * std::fabs(mean)){
+                result.converged = true;
+                break;
+            }
+        }
+        if (elapsed() >= config.time_budget && n >= 2){
+            break;
+        }
+    }
+
+    result.samples = n;
+    result.mean = mean;
+    result.stddev = (n > 1) ? std::sqrt(m2 / (n - 1)) : 0.0;
+    result.ci_half_width = (n > 1) ? t_quantile_95(n - 1) * result.stddev / std::sqrt((double)n) : INFINITY;
+    result.elapsed = elapsed();
+    return result;
+}
+
+#endif
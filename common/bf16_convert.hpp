@@ -0,0 +1,289 @@
+#ifndef __BF16_CONVERT_HPP__
+#define __BF16_CONVERT_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <stdfloat>
+#include <string>
+#include <vector>
+#include "buffer.hpp"
+#include "buffer_ops.hpp"
+
+// Bulk float32 <-> bfloat16 conversion.
+// bfloat16 is the upper half of a float32, so widening is a shift and narrowing is a rounding of
+// the lower 16 bits. NaNs stay NaNs (quiet) in every mode. The kernels are picked at run time:
+//   avx512_bf16 : vcvtneps2bf16, nearest even only; like the hardware, it flushes float32
+//                 denormals to zero
+//   avx512/avx2 : integer emulation of the rounding, denormals are kept
+//   scalar      : the same emulation one element at a time
+// Large arrays are split across threads like buffer_ops. The buffer helpers convert straight
+// into the mapped BO memory and mark the written range dirty.
+
+typedef enum{
+    bf16_round_nearest_even,
+    bf16_round_toward_zero
+} bf16_rounding;
+
+typedef enum{
+    bf16_kernel_scalar,
+    bf16_kernel_avx2,
+    bf16_kernel_avx512,
+    bf16_kernel_avx512_bf16
+} bf16_kernel;
+
+inline const char* bf16_kernel_name(bf16_kernel kernel){
+    switch (kernel){
+        case bf16_kernel_avx512_bf16: return "avx512bf16";
+        case bf16_kernel_avx512: return "avx512";
+        case bf16_kernel_avx2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+inline bool has_avx512_bf16(){
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx512bf16");
+#else
+    return false;
+#endif
+}
+
+// Fastest kernel for level that implements rounding
+inline bf16_kernel select_bf16_kernel(simd_level level, bf16_rounding rounding){
+    if (level >= simd_avx512){
+        static const bool native = has_avx512_bf16();
+        return native && rounding == bf16_round_nearest_even ? bf16_kernel_avx512_bf16 : bf16_kernel_avx512;
+    }
+    return level >= simd_avx2 ? bf16_kernel_avx2 : bf16_kernel_scalar;
+}
+
+namespace bf16_ops {
+
+inline uint16_t narrow(float value, bf16_rounding rounding){
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    if ((bits & 0x7fffffffu) > 0x7f800000u){
+        return (uint16_t)((bits >> 16) | 0x40);
+    }
+    if (rounding == bf16_round_nearest_even){
+        bits += 0x7fffu + ((bits >> 16) & 1);
+    }
+    return (uint16_t)(bits >> 16);
+}
+
+inline float widen(uint16_t value){
+    uint32_t bits = (uint32_t)value << 16;
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline __m256i narrow8_avx2(__m256i bits, bool nearest){
+    const __m256i abs_mask = _mm256_set1_epi32(0x7fffffff);
+    const __m256i inf = _mm256_set1_epi32(0x7f800000);
+    __m256i nan = _mm256_cmpgt_epi32(_mm256_and_si256(bits, abs_mask), inf);
+    __m256i quiet = _mm256_or_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(0x40));
+    if (nearest){
+        __m256i lsb = _mm256_and_si256(_mm256_srli_epi32(bits, 16), _mm256_set1_epi32(1));
+        bits = _mm256_add_epi32(bits, _mm256_add_epi32(lsb, _mm256_set1_epi32(0x7fff)));
+    }
+    return _mm256_blendv_epi8(_mm256_srli_epi32(bits, 16), quiet, nan);
+}
+
+__attribute__((target("avx2")))
+inline void narrow_avx2(uint16_t* dst, const float* src, size_t count, bool nearest){
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16){
+        __m256i lo = narrow8_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k)), nearest);
+        __m256i hi = narrow8_avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k + 8)), nearest);
+        // packus works per 128 bit lane
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), packed);
+    }
+    for (; k < count; k++){
+        dst[k] = narrow(src[k], nearest ? bf16_round_nearest_even : bf16_round_toward_zero);
+    }
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline void narrow_avx512(uint16_t* dst, const float* src, size_t count, bool nearest){
+    const __m512i abs_mask = _mm512_set1_epi32(0x7fffffff);
+    const __m512i inf = _mm512_set1_epi32(0x7f800000);
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16){
+        __m512i bits = _mm512_loadu_si512(src + k);
+        __mmask16 nan = _mm512_cmpgt_epi32_mask(_mm512_and_si512(bits, abs_mask), inf);
+        __m512i quiet = _mm512_or_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(0x40));
+        if (nearest){
+            __m512i lsb = _mm512_and_si512(_mm512_srli_epi32(bits, 16), _mm512_set1_epi32(1));
+            bits = _mm512_add_epi32(bits, _mm512_add_epi32(lsb, _mm512_set1_epi32(0x7fff)));
+        }
+        __m512i r = _mm512_mask_mov_epi32(_mm512_srli_epi32(bits, 16), nan, quiet);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), _mm512_cvtepi32_epi16(r));
+    }
+    for (; k < count; k++){
+        dst[k] = narrow(src[k], nearest ? bf16_round_nearest_even : bf16_round_toward_zero);
+    }
+}
+
+__attribute__((target("avx512f,avx512bf16")))
+inline void narrow_avx512_bf16(uint16_t* dst, const float* src, size_t count){
+    size_t k = 0;
+    for (; k + 32 <= count; k += 32){
+        __m512bh r = _mm512_cvtne2ps_pbh(_mm512_loadu_ps(src + k + 16), _mm512_loadu_ps(src + k));
+        _mm512_storeu_si512(dst + k, (__m512i)r);
+    }
+    for (; k + 16 <= count; k += 16){
+        __m256bh r = _mm512_cvtneps_pbh(_mm512_loadu_ps(src + k));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), (__m256i)r);
+    }
+    for (; k < count; k++){
+        dst[k] = narrow(src[k], bf16_round_nearest_even);
+    }
+}
+
+__attribute__((target("avx2")))
+inline void widen_avx2(float* dst, const uint16_t* src, size_t count){
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8){
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + k)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), _mm256_slli_epi32(v, 16));
+    }
+    for (; k < count; k++){
+        dst[k] = widen(src[k]);
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void widen_avx512(float* dst, const uint16_t* src, size_t count){
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16){
+        __m512i v = _mm512_cvtepu16_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + k)));
+        _mm512_storeu_si512(dst + k, _mm512_slli_epi32(v, 16));
+    }
+    for (; k < count; k++){
+        dst[k] = widen(src[k]);
+    }
+}
+#endif
+
+// Single threaded narrowing with kernel
+inline void narrow_block(bf16_kernel kernel, uint16_t* dst, const float* src, size_t count, bf16_rounding rounding){
+    bool nearest = rounding == bf16_round_nearest_even;
+#if defined(__x86_64__)
+    switch (kernel){
+        case bf16_kernel_avx512_bf16:
+            if (nearest){
+                narrow_avx512_bf16(dst, src, count);
+                return;
+            }
+            narrow_avx512(dst, src, count, nearest);
+            return;
+        case bf16_kernel_avx512:
+            narrow_avx512(dst, src, count, nearest);
+            return;
+        case bf16_kernel_avx2:
+            narrow_avx2(dst, src, count, nearest);
+            return;
+        default:
+            break;
+    }
+#endif
+    for (size_t k = 0; k < count; k++){
+        dst[k] = narrow(src[k], rounding);
+    }
+}
+
+inline void widen_block(bf16_kernel kernel, float* dst, const uint16_t* src, size_t count){
+#if defined(__x86_64__)
+    if (kernel >= bf16_kernel_avx512){
+        widen_avx512(dst, src, count);
+        return;
+    }
+    if (kernel == bf16_kernel_avx2){
+        widen_avx2(dst, src, count);
+        return;
+    }
+#endif
+    for (size_t k = 0; k < count; k++){
+        dst[k] = widen(src[k]);
+    }
+}
+
+// float32 to bfloat16 with an explicit kernel, threaded on large arrays
+inline void to_bf16(bf16_kernel kernel, std::bfloat16_t* dst, const float* src, size_t count, bf16_rounding rounding,
+    const buffer_ops_config& cfg){
+    uint16_t* out = reinterpret_cast<uint16_t*>(dst);
+    buffer_ops::parallel_for(cfg, count * sizeof(uint16_t), [&](size_t offset, size_t size){
+        size_t begin = offset / sizeof(uint16_t);
+        narrow_block(kernel, out + begin, src + begin, size / sizeof(uint16_t), rounding);
+    });
+}
+
+inline void to_bf16(std::bfloat16_t* dst, const float* src, size_t count, bf16_rounding rounding = bf16_round_nearest_even,
+    const buffer_ops_config& cfg = default_buffer_ops_config()){
+    to_bf16(select_bf16_kernel(cfg.level, rounding), dst, src, count, rounding, cfg);
+}
+
+// bfloat16 to float32 with an explicit kernel, threaded on large arrays
+inline void to_float(bf16_kernel kernel, float* dst, const std::bfloat16_t* src, size_t count, const buffer_ops_config& cfg){
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    // Split on the float side, so chunks hold whole pages of the larger array
+    buffer_ops::parallel_for(cfg, count * sizeof(float), [&](size_t offset, size_t size){
+        size_t begin = offset / sizeof(float);
+        widen_block(kernel, dst + begin, in + begin, size / sizeof(float));
+    });
+}
+
+inline void to_float(float* dst, const std::bfloat16_t* src, size_t count, const buffer_ops_config& cfg = default_buffer_ops_config()){
+    to_float(select_bf16_kernel(cfg.level, bf16_round_nearest_even), dst, src, count, cfg);
+}
+
+// Converts count floats into dst from element index, e.g. straight into a mapped bf16 BO
+inline void store(buffer<std::bfloat16_t>& dst, const float* src, size_t count, size_t index = 0,
+    bf16_rounding rounding = bf16_round_nearest_even, const buffer_ops_config& cfg = default_buffer_ops_config()){
+    if (index + count > dst.size()){
+        throw std::runtime_error("Range out of the buffer in bf16 store");
+    }
+    to_bf16(dst.data() + index, src, count, rounding, cfg);
+    dst.mark_dirty_elements(index, count);
+}
+
+inline void store(buffer<std::bfloat16_t>& dst, const std::vector<float>& src,
+    bf16_rounding rounding = bf16_round_nearest_even, const buffer_ops_config& cfg = default_buffer_ops_config()){
+    if (src.size() != dst.size()){
+        throw std::runtime_error("Size mismatch in bf16 store");
+    }
+    store(dst, src.data(), src.size(), 0, rounding, cfg);
+}
+
+// Converts count elements of src from element index into dst
+inline void load(float* dst, const buffer<std::bfloat16_t>& src, size_t count, size_t index = 0,
+    const buffer_ops_config& cfg = default_buffer_ops_config()){
+    if (index + count > src.size()){
+        throw std::runtime_error("Range out of the buffer in bf16 load");
+    }
+    to_float(dst, src.data() + index, count, cfg);
+}
+
+inline std::vector<float> load(const buffer<std::bfloat16_t>& src, const buffer_ops_config& cfg = default_buffer_ops_config()){
+    std::vector<float> values(src.size());
+    load(values.data(), src, values.size(), 0, cfg);
+    return values;
+}
+
+// Sets every element to value, rounded once
+inline void fill(buffer<std::bfloat16_t>& dst, float value, bf16_rounding rounding = bf16_round_nearest_even){
+    uint16_t bits = narrow(value, rounding);
+    std::bfloat16_t converted;
+    std::memcpy(&converted, &bits, sizeof(bits));
+    dst.memset(converted);
+}
+
+}
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef __BUFFER_HPP__
 #define __BUFFER_HPP__
 
+#include <algorithm>
 #include <cstdint>
 #include <cstddef>
 #include <cassert>
@@ -9,25 +10,24 @@
 #include <iostream>
 #include <stdexcept>
 #include <string>
+#include <utility>
 #include <vector>
 
 // Avoid including heavy non-standard headers in a header file.
 // #include <bits/stdc++.h>
 // #include <boost/program_options.hpp>
 
-#define __XRT__
-
-#ifdef __XRT__
-#include "xrt/xrt_bo.h"
-#include "xrt/xrt_kernel.h"
-#include "xrt/xrt_device.h"
-#endif
-
+#include "npu_device.hpp"
+#include "npu_bo_pool.hpp"
+#include "npu_userptr_cache.hpp"
+#include "host_alloc.hpp"
+#include "buffer_ops.hpp"
 #include "debug_utils.hpp"
 
 /*
 This is a buffer wrapper that maps to a bo_buffer or other memory without performing a deep copy.
 A copy (or mapping) does not duplicate the underlying memory; it only maps the pointer.
+BOs come from an npu_device, so the same buffer works on the XRT and the simulated backend.
 */
 
 // --------------------- Base class: bytes --------------------- //
@@ -36,100 +36,135 @@ protected:
     uint8_t* data_;
     size_t size_;
     bool is_owner_;
-#ifdef __XRT__
     bool is_bo_owner_;
-    xrt::bo* bo_;
-#endif
+    npu_bo* bo_;
+    // Bytes mapped by host_alloc for owned memory, 0 when it came from new[]
+    size_t mapped_size_ = 0;
+    // Sorted, disjoint [begin, end) byte ranges written since the last sync to the device
+    bool track_dirty_ = false;
+    std::vector<std::pair<size_t, size_t>> dirty_;
+
+    // Free owned memory the way it was allocated.
+    void release_data() {
+        if (mapped_size_ > 0) {
+            host_alloc::release(data_, mapped_size_);
+        }
+        else {
+            delete[] data_;
+        }
+        mapped_size_ = 0;
+    }
 
 public:
     // Default constructor (no data)
     bytes() : data_(nullptr), size_(0), is_owner_(false)
-#ifdef __XRT__
         , is_bo_owner_(false), bo_(nullptr)
-#endif
     {}
 
     // Copy constructor: shallow copy, does not take ownership.
     bytes(const bytes& other)
         : data_(other.data_), size_(other.size_), is_owner_(false)
-#ifdef __XRT__
         , is_bo_owner_(false), bo_(nullptr)
-#endif
     {}
 
     // Move constructor: transfers pointer and flags, then clears source.
     bytes(bytes&& other) noexcept
         : data_(other.data_), size_(other.size_), is_owner_(other.is_owner_)
-#ifdef __XRT__
-        , is_bo_owner_(other.is_bo_owner_), bo_(other.bo_)
-#endif
+        , is_bo_owner_(other.is_bo_owner_), bo_(other.bo_), mapped_size_(other.mapped_size_)
+        , track_dirty_(other.track_dirty_), dirty_(std::move(other.dirty_))
     {
         other.data_ = nullptr;
         other.size_ = 0;
         other.is_owner_ = false;
-#ifdef __XRT__
         other.is_bo_owner_ = false;
         other.bo_ = nullptr;
-#endif
+        other.mapped_size_ = 0;
     }
 
     // Construct a buffer of given size (allocates memory and owns it).
     bytes(size_t size)
         : data_(new uint8_t[size]), size_(size), is_owner_(true)
-#ifdef __XRT__
         , is_bo_owner_(false), bo_(nullptr)
-#endif
+    {}
+
+    // Construct a buffer of given size with an allocation policy (huge pages, prefault, NUMA node).
+    bytes(size_t size, const host_alloc_policy& policy)
+        : data_(host_alloc::allocate(size, policy)), size_(size), is_owner_(true)
+        , is_bo_owner_(false), bo_(nullptr), mapped_size_(host_alloc::mapped_size(size, policy))
     {}
 
     // Construct a buffer that maps an existing pointer (does not take ownership).
     bytes(uint8_t* data, size_t size)
         : data_(data), size_(size), is_owner_(false)
-#ifdef __XRT__
         , is_bo_owner_(false), bo_(nullptr)
-#endif
     {}
 
-#ifdef __XRT__
-    // Construct from an xrt::bo (maps the bo; does not claim ownership).
-    bytes(xrt::bo& bo)
+    // Construct from an npu_bo (maps the bo; does not claim ownership).
+    bytes(npu_bo& bo)
         : data_(bo.map<uint8_t*>()), size_(bo.size()), is_owner_(false),
           is_bo_owner_(false), bo_(&bo)
     {}
 
+    // Construct from a newly created npu_bo (maps the bo; takes ownership of the handle).
+    bytes(npu_bo&& bo)
+        : data_(bo.map<uint8_t*>()), size_(bo.size()), is_owner_(false),
+          is_bo_owner_(true), bo_(new npu_bo(std::move(bo)))
+    {}
+
     // Construct a bo-backed buffer (allocates a new bo; takes ownership of the bo).
-    bytes(size_t size, xrt::device& device, xrt::kernel& kernel, int group_id)
+    bytes(size_t size, npu_device& device, npu_kernel& kernel, int group_id)
         : size_(size), is_owner_(false), is_bo_owner_(true)
     {
-        bo_ = new xrt::bo(device, size, XRT_BO_FLAGS_HOST_ONLY, kernel.group_id(group_id));
+        bo_ = new npu_bo(device.create_bo(size, npu_bo_host_only, kernel.group_id(group_id)));
         data_ = bo_->map<uint8_t*>();
     }
-#endif
 
-    // Destructor: free owned memory or bo.
+    // Construct a bo-backed buffer from a pool (the bo returns to the pool when released).
+    bytes(size_t size, npu_bo_pool& pool, npu_kernel& kernel, int group_id)
+        : size_(size), is_owner_(false), is_bo_owner_(true)
+    {
+        bo_ = new npu_bo(pool.acquire(size, npu_bo_host_only, kernel.group_id(group_id)));
+        data_ = bo_->map<uint8_t*>();
+    }
+
+    // Import existing page aligned memory as a user pointer bo (no copy; the memory stays the caller's).
+    bytes(uint8_t* data, size_t size, npu_userptr_cache& cache, npu_kernel& kernel, int group_id)
+        : data_(data), size_(size), is_owner_(false), is_bo_owner_(true)
+    {
+        bo_ = new npu_bo(cache.import(data, size, kernel.group_id(group_id)));
+    }
+
+    // Allocate memory with a policy and import it as a user pointer bo (owns both).
+    bytes(size_t size, const host_alloc_policy& policy, npu_device& device, npu_kernel& kernel, int group_id)
+        : bytes(size, policy)
+    {
+        bo_ = new npu_bo(device.import_bo(data_, size, kernel.group_id(group_id)));
+        is_bo_owner_ = true;
+    }
+
+    // Destructor: free owned bo, then the memory it may map.
     virtual ~bytes() {
-        if (is_owner_ && data_) {
-            delete[] data_;
-        }
-#ifdef __XRT__
         if (is_bo_owner_ && bo_) {
             delete bo_;
         }
-#endif
+        if (is_owner_ && data_) {
+            release_data();
+        }
     }
 
     // Assignment operator: shallow copy (no ownership transfer)
     bytes& operator=(const bytes& other) {
         if (this != &other) {
             if (is_owner_ && data_) {
-                delete[] data_;
+                release_data();
             }
             data_ = other.data_;
             size_ = other.size_;
             is_owner_ = false;
-#ifdef __XRT__
             is_bo_owner_ = false;
             bo_ = other.bo_;
-#endif
+            track_dirty_ = false;
+            dirty_.clear();
         }
         return *this;
     }
@@ -154,9 +189,7 @@ public:
 
     // Resize (only allowed if not a bo-mapped buffer)
     void resize(size_t size) {
-#ifdef __XRT__
         assert(is_bo_owner_ == false && "Cannot resize a bo-mapped buffer");
-#endif
         // special case: size is 0 and data is nullptr: a empty buffer
         // case 1: a owner buffer, delete the memory
         // case 2: a non-owner buffer, throw an error
@@ -164,7 +197,7 @@ public:
             throw std::runtime_error("Cannot resize a non-owner buffer");
         }
         if (is_owner_ && data_) {
-            delete[] data_;
+            release_data();
         }
         data_ = new uint8_t[size];
         size_ = size;
@@ -173,19 +206,15 @@ public:
 
     // Free the buffer memory (only allowed if owned)
     void free() {
-#ifdef __XRT__
         assert(is_bo_owner_ == false && "Cannot free a bo-mapped buffer");
-#endif
         if (is_owner_ && data_) {
-            delete[] data_;
+            release_data();
         }
         data_ = nullptr;
         size_ = 0;
         is_owner_ = false;
-#ifdef __XRT__
         is_bo_owner_ = false;
         bo_ = nullptr;
-#endif
     }
 
     // Reserve and release are aliases for resize/free.
@@ -202,23 +231,102 @@ public:
     bool is_owner() const { return is_owner_; }
     bool is_bo_owner() const { return is_bo_owner_; }
 
-#ifdef __XRT__
-    // XRT-specific functions.
+    // Device BO functions.
+    // With dirty tracking on, only the ranges marked since the last sync are flushed.
     void sync_to_device() {
         assert(bo_ != nullptr);
-        bo_->sync(XCL_BO_SYNC_BO_TO_DEVICE);
+        if (!track_dirty_) {
+            bo_->sync(npu_sync_to_device);
+            return;
+        }
+        for (auto& range : dirty_) {
+            bo_->sync(npu_sync_to_device, range.second - range.first, range.first);
+        }
+        dirty_.clear();
     }
 
     void sync_from_device() {
         assert(bo_ != nullptr);
-        bo_->sync(XCL_BO_SYNC_BO_FROM_DEVICE);
+        bo_->sync(npu_sync_from_device);
+    }
+
+    // Sync size bytes starting at byte offset.
+    void sync_to_device(size_t size, size_t offset) {
+        assert(bo_ != nullptr);
+        bo_->sync(npu_sync_to_device, size, offset);
+    }
+
+    void sync_from_device(size_t size, size_t offset) {
+        assert(bo_ != nullptr);
+        bo_->sync(npu_sync_from_device, size, offset);
+    }
+
+    // --- Dirty tracking --- //
+    // Writes through copy_from(), memset() and write_range() mark their range dirty. Writes
+    // through operator[] or data() are not seen and need mark_dirty(). A buffer starts fully
+    // dirty when tracking is turned on, so the first sync flushes everything.
+    static constexpr size_t dirty_granule = 64;   // cache line
+    static constexpr size_t max_dirty_ranges = 16; // beyond this the ranges collapse into one
+
+    void track_dirty(bool enable) {
+        track_dirty_ = enable;
+        dirty_.clear();
+        if (enable && size_ > 0) {
+            dirty_.push_back({0, size_});
+        }
+    }
+
+    bool is_tracking_dirty() const { return track_dirty_; }
+
+    void mark_dirty(size_t offset, size_t size) {
+        if (!track_dirty_ || size == 0) {
+            return;
+        }
+        if (offset + size > size_) {
+            throw std::runtime_error("Dirty range is out of the buffer");
+        }
+        const size_t granule = dirty_granule;
+        size_t begin = offset & ~(granule - 1);
+        size_t end = std::min(size_, (offset + size + granule - 1) & ~(granule - 1));
+        // Merge with every overlapping or adjacent range
+        auto it = dirty_.begin();
+        while (it != dirty_.end() && it->second < begin) {
+            ++it;
+        }
+        auto last = it;
+        while (last != dirty_.end() && last->first <= end) {
+            begin = std::min(begin, last->first);
+            end = std::max(end, last->second);
+            ++last;
+        }
+        it = dirty_.erase(it, last);
+        dirty_.insert(it, {begin, end});
+        if (dirty_.size() > max_dirty_ranges) {
+            std::pair<size_t, size_t> bound = {dirty_.front().first, dirty_.back().second};
+            dirty_.assign(1, bound);
+        }
     }
 
-    xrt::bo& bo() {
+    void mark_dirty() { mark_dirty(0, size_); }
+
+    // Bytes a sync to the device would flush.
+    size_t dirty_bytes() const {
+        if (!track_dirty_) {
+            return size_;
+        }
+        size_t total = 0;
+        for (auto& range : dirty_) {
+            total += range.second - range.first;
+        }
+        return total;
+    }
+
+    const std::vector<std::pair<size_t, size_t>>& dirty_ranges() const { return dirty_; }
+
+    npu_bo& bo() {
         assert(bo_ != nullptr);
         return *bo_;
     }
-#endif
 };
 
 // --------------------- Derived class template: buffer<T> --------------------- //
@@ -232,6 +340,9 @@ public:
     // Construct a buffer for count elements (allocates memory).
     buffer(size_t count) : bytes(count * sizeof(T)) {}
 
+    // Construct a buffer for count elements with an allocation policy.
+    buffer(size_t count, const host_alloc_policy& policy) : bytes(count * sizeof(T), policy) {}
+
     // Construct from existing T* data (shallow mapping; does not take ownership).
     buffer(T* data, size_t count)
         : bytes(reinterpret_cast<uint8_t*>(data), count * sizeof(T)) {}
@@ -239,14 +350,42 @@ public:
     // Shallow copy constructor.
     buffer(const buffer& other) : bytes(other) {}
 
-#ifdef __XRT__
-    // Construct from an xrt::bo.
-    buffer(xrt::bo& bo) : bytes(bo) {}
+    // Move constructor: takes over the memory or bo, so buffers can live in containers.
+    buffer(buffer&& other) noexcept : bytes(std::move(other)) {}
+
+    // Shallow copy assignment, same as bytes.
+    buffer& operator=(const buffer& other) {
+        bytes::operator=(other);
+        return *this;
+    }
+
+    // Construct from an npu_bo.
+    buffer(npu_bo& bo) : bytes(bo) {}
+
+    // Construct from a newly created npu_bo, e.g. an arena sub-buffer, and own its handle.
+    buffer(npu_bo&& bo) : bytes(std::move(bo)) {}
 
     // Construct a bo-backed buffer for count elements.
-    buffer(size_t count, xrt::device& device, xrt::kernel& kernel, int group_id)
+    buffer(size_t count, npu_device& device, npu_kernel& kernel, int group_id)
         : bytes(count * sizeof(T), device, kernel, group_id) {}
-#endif
+
+    // Construct a bo-backed buffer for count elements over policy allocated memory.
+    buffer(size_t count, const host_alloc_policy& policy, npu_device& device, npu_kernel& kernel, int group_id)
+        : bytes(count * sizeof(T), policy, device, kernel, group_id) {}
+
+    // Construct a pooled bo-backed buffer for count elements.
+    buffer(size_t count, npu_bo_pool& pool, npu_kernel& kernel, int group_id)
+        : bytes(count * sizeof(T), pool, kernel, group_id) {}
+
+    // Import count elements at data as a user pointer bo, without copying them.
+    buffer(T* data, size_t count, npu_userptr_cache& cache, npu_kernel& kernel, int group_id)
+        : bytes(reinterpret_cast<uint8_t*>(data), count * sizeof(T), cache, kernel, group_id) {}
+
+    // Import a vector with a page aligned allocator, e.g. AlignedAllocator. The vector must not
+    // be resized while the buffer is in use.
+    template<typename Alloc>
+    buffer(std::vector<T, Alloc>& vec, npu_userptr_cache& cache, npu_kernel& kernel, int group_id)
+        : bytes(reinterpret_cast<uint8_t*>(vec.data()), vec.size() * sizeof(T), cache, kernel, group_id) {}
 
     // --- New: Constructors from std::vector --- //
 
@@ -277,7 +416,8 @@ public:
         if (vec.size() * sizeof(T) != this->size_) {
             throw std::runtime_error("Size mismatch in copy_from(vector)");
         }
-        std::memcpy(data_, vec.data(), size_);
+        buffer_ops::copy(data_, reinterpret_cast<const uint8_t*>(vec.data()), size_);
+        mark_dirty();
     }
 
     // --- Templated cast_to() --- //
@@ -305,6 +445,27 @@ public:
         return reinterpret_cast<T*>(data_)[index];
     }
 
+    // Element range for an in-place write, marked dirty.
+    T* write_range(size_t index, size_t count) {
+        mark_dirty(index * sizeof(T), count * sizeof(T));
+        return data() + index;
+    }
+
+    // Mark count elements from index dirty.
+    void mark_dirty_elements(size_t index, size_t count) {
+        mark_dirty(index * sizeof(T), count * sizeof(T));
+    }
+
+    // Sync count elements starting at element index. Named apart from the byte ranges of
+    // sync_to_device(size, offset), which take the same argument types.
+    void sync_elements_to_device(size_t count, size_t index) {
+        bytes::sync_to_device(count * sizeof(T), index * sizeof(T));
+    }
+
+    void sync_elements_from_device(size_t count, size_t index) {
+        bytes::sync_from_device(count * sizeof(T), index * sizeof(T));
+    }
+
     // Return the number of T elements in the buffer.
     size_t size() const { return size_ / sizeof(T); }
 
@@ -323,12 +484,10 @@ public:
         bytes::reserve(count * sizeof(T));
     }
 
-    // Set all elements to the given value.
+    // Set all elements to the given value (vectorized, threaded on large buffers).
     void memset(T value) {
-        T* ptr = data();
-        for (size_t i = 0; i < size(); i++) {
-            ptr[i] = value;
-        }
+        buffer_ops::fill(data(), size(), value);
+        mark_dirty();
     }
 
     // Copy data from another bytes object (must have the same byte size).
@@ -336,7 +495,8 @@ public:
         if (size_ != other.size()) {
             throw std::runtime_error("Size mismatch in copy_from(bytes)");
         }
-        std::memcpy(data_, other.data(), size_);
+        buffer_ops::copy(data_, other.data(), size_);
+        mark_dirty();
     }
 
     // Copy data from another buffer (must have the same number of elements).
@@ -344,7 +504,8 @@ public:
         if (size() != other.size()) {
             throw std::runtime_error("Size mismatch in copy_from(buffer)");
         }
-        std::memcpy(data_, other.bdata(), size_ * sizeof(T)); // size_ is in bytes.
+        buffer_ops::copy(data_, other.bdata(), size_); // size_ is in bytes.
+        mark_dirty();
     }
 
     // Copy data from a pointer and provided size.
@@ -352,7 +513,17 @@ public:
         if (size > this->size()) {
             throw std::runtime_error("Size mismatch in copy_from(pointer)");
         }
-        std::memcpy(data_, data, size * sizeof(T));
+        buffer_ops::copy(data_, reinterpret_cast<const uint8_t*>(data), size * sizeof(T));
+        mark_dirty(0, size * sizeof(T));
+    }
+
+    // Copy count elements from a pointer to element index, marking only that range dirty.
+    void copy_from(const T* data, size_t count, size_t index) {
+        if (index + count > this->size()) {
+            throw std::runtime_error("Range out of the buffer in copy_from(pointer, index)");
+        }
+        std::memcpy(reinterpret_cast<T*>(data_) + index, data, count * sizeof(T));
+        mark_dirty(index * sizeof(T), count * sizeof(T));
     }
 
     bytes& as_bytes() {
@@ -0,0 +1,486 @@
+#ifndef __BUFFER_OPS_HPP__
+#define __BUFFER_OPS_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Bulk fill, copy and compare for host buffers.
+// The kernels are picked at run time: AVX-512, AVX2 or a scalar fallback, so the binary does
+// not need -march flags. Large buffers are split into page aligned chunks across the threads
+// of a persistent pool, and buffers larger than the last level cache are written with
+// non-temporal stores, which do not evict the working set and skip the read for ownership
+// of the destination lines.
+// Compare is bitwise on 64 byte blocks first; only differing blocks are checked element by
+// element. Elements match when they are bitwise equal or equal by operator==, so identical
+// NaNs match and so do +0.0 and -0.0.
+
+typedef enum{
+    simd_scalar,
+    simd_avx2,
+    simd_avx512
+} simd_level;
+
+inline const char* simd_level_name(simd_level level){
+    switch (level){
+        case simd_avx512: return "avx512";
+        case simd_avx2: return "avx2";
+        default: return "scalar";
+    }
+}
+
+inline simd_level detect_simd_level(){
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")){
+        return simd_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")){
+        return simd_avx2;
+    }
+#endif
+    return simd_scalar;
+}
+
+inline size_t llc_size(){
+    long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    return size > 0 ? (size_t)size : 32ULL << 20;
+}
+
+typedef enum{
+    nt_auto,  // non-temporal stores above the last level cache size
+    nt_never,
+    nt_always
+} nt_policy;
+
+typedef struct {
+    simd_level level;
+    int threads;           // 0 for one per hardware thread
+    size_t min_chunk;      // bytes, smallest share of a thread
+    nt_policy non_temporal;
+} buffer_ops_config;
+
+inline const buffer_ops_config& default_buffer_ops_config(){
+    static const buffer_ops_config config = {detect_simd_level(), 0, 4ULL << 20, nt_auto};
+    return config;
+}
+
+template<typename T>
+struct mismatch_summary{
+    size_t checked;
+    size_t count;
+    size_t first;  // index of the first mismatch, checked when there is none
+    size_t last;
+    // The lowest max_records mismatches
+    std::vector<size_t> indices;
+    std::vector<T> values;
+    std::vector<T> expected;
+};
+
+namespace buffer_ops {
+
+const size_t block = 64;
+
+inline bool use_non_temporal(const buffer_ops_config& cfg, size_t bytes){
+    return cfg.non_temporal == nt_always || (cfg.non_temporal == nt_auto && bytes > llc_size());
+}
+
+// Threads kept across operations, so splitting an operation does not pay for creating and
+// joining threads on every call. The workers are started on first use and grow to the
+// largest split requested. Operations from several threads take turns; an operation started
+// from inside a task runs on its calling thread.
+class worker_pool{
+private:
+    struct job{
+        std::function<void(size_t)> task;
+        size_t count;
+        std::atomic<size_t> next;
+        size_t finished; // under lock
+    };
+
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    std::mutex run_lock;
+    std::vector<std::thread> workers;
+    std::shared_ptr<job> current;
+    uint64_t generation = 0;
+    bool stopping = false;
+
+    static bool& in_task(){
+        static thread_local bool busy = false;
+        return busy;
+    }
+
+    // Runs the tasks of j that are left, from the caller or a worker
+    void drain(job& j){
+        size_t ran = 0;
+        for (size_t i = j.next++; i < j.count; i = j.next++){
+            j.task(i);
+            ran++;
+        }
+        if (ran > 0){
+            std::lock_guard<std::mutex> guard(lock);
+            j.finished += ran;
+            if (j.finished == j.count){
+                done.notify_all();
+            }
+        }
+    }
+
+    void loop(){
+        in_task() = true;
+        uint64_t seen = 0;
+        while (true){
+            std::shared_ptr<job> j;
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                wake.wait(guard, [&](){ return stopping || generation != seen; });
+                if (stopping){
+                    return;
+                }
+                seen = generation;
+                j = current;
+            }
+            drain(*j);
+        }
+    }
+
+public:
+    worker_pool() = default;
+    worker_pool(const worker_pool&) = delete;
+    worker_pool& operator=(const worker_pool&) = delete;
+
+    ~worker_pool(){
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& w : workers){
+            w.join();
+        }
+    }
+
+    // Runs f(0) .. f(count - 1) on up to count threads, the caller included, and returns when
+    // all are done
+    template<typename F>
+    void run(size_t count, F&& f){
+        if (count <= 1 || in_task()){
+            for (size_t i = 0; i < count; i++){
+                f(i);
+            }
+            return;
+        }
+        std::lock_guard<std::mutex> turn(run_lock);
+        std::shared_ptr<job> j = std::make_shared<job>();
+        j->task = std::ref(f);
+        j->count = count;
+        j->next = 0;
+        j->finished = 0;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            while (workers.size() < count - 1){
+                workers.emplace_back([this](){ loop(); });
+            }
+            current = j;
+            generation++;
+        }
+        wake.notify_all();
+        in_task() = true;
+        drain(*j);
+        in_task() = false;
+        std::unique_lock<std::mutex> guard(lock);
+        done.wait(guard, [&](){ return j->finished == j->count; });
+    }
+};
+
+inline worker_pool& workers(){
+    static worker_pool pool;
+    return pool;
+}
+
+inline size_t thread_count(const buffer_ops_config& cfg){
+    return cfg.threads > 0 ? cfg.threads : std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Splits [0, bytes) into page aligned chunks and runs f(offset, size) on each, one per thread
+template<typename F>
+inline void parallel_for(const buffer_ops_config& cfg, size_t bytes, F f){
+    const size_t page = 4096;
+    size_t threads = std::max<size_t>(1, std::min(thread_count(cfg), bytes / std::max(cfg.min_chunk, page)));
+    if (threads == 1){
+        f(0, bytes);
+        return;
+    }
+    size_t chunk = ((bytes / threads) + page - 1) & ~(page - 1);
+    size_t chunks = (bytes + chunk - 1) / chunk;
+    workers().run(chunks, [&](size_t t){
+        size_t offset = t * chunk;
+        f(offset, std::min(chunk, bytes - offset));
+    });
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline void fill_avx2(uint8_t* dst, size_t bytes, const uint8_t* pattern, bool nt){
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pattern + 32));
+    for (size_t i = 0; i < bytes; i += block){
+        __m256i* p = reinterpret_cast<__m256i*>(dst + i);
+        if (nt){
+            _mm256_stream_si256(p, lo);
+            _mm256_stream_si256(p + 1, hi);
+        }
+        else{
+            _mm256_store_si256(p, lo);
+            _mm256_store_si256(p + 1, hi);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void fill_avx512(uint8_t* dst, size_t bytes, const uint8_t* pattern, bool nt){
+    __m512i v = _mm512_loadu_si512(pattern);
+    for (size_t i = 0; i < bytes; i += block){
+        if (nt){
+            _mm512_stream_si512(reinterpret_cast<__m512i*>(dst + i), v);
+        }
+        else{
+            _mm512_store_si512(dst + i, v);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+inline void copy_nt_avx2(uint8_t* dst, const uint8_t* src, size_t bytes){
+    for (size_t i = 0; i < bytes; i += block){
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i), a);
+        _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + i + 32), b);
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void copy_nt_avx512(uint8_t* dst, const uint8_t* src, size_t bytes){
+    for (size_t i = 0; i < bytes; i += block){
+        _mm512_stream_si512(reinterpret_cast<__m512i*>(dst + i), _mm512_loadu_si512(src + i));
+    }
+}
+
+// Offset of the first differing 64 byte block, or of the tail after the last whole block
+__attribute__((target("avx2")))
+inline size_t diff_avx2(const uint8_t* a, const uint8_t* b, size_t bytes){
+    for (size_t i = 0; i + block <= bytes; i += block){
+        __m256i x0 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i)));
+        __m256i x1 = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i + 32)),
+                                       _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i + 32)));
+        if (_mm256_movemask_epi8(_mm256_and_si256(x0, x1)) != -1){
+            return i;
+        }
+    }
+    return bytes & ~(block - 1);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+inline size_t diff_avx512(const uint8_t* a, const uint8_t* b, size_t bytes){
+    for (size_t i = 0; i + block <= bytes; i += block){
+        if (_mm512_cmpneq_epi8_mask(_mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i)) != 0){
+            return i;
+        }
+    }
+    return bytes & ~(block - 1);
+}
+#endif
+
+inline size_t diff_scalar(const uint8_t* a, const uint8_t* b, size_t bytes){
+    for (size_t i = 0; i + block <= bytes; i += block){
+        if (std::memcmp(a + i, b + i, block) != 0){
+            return i;
+        }
+    }
+    return bytes & ~(block - 1);
+}
+
+// Fills whole 64 byte blocks of a 64 byte aligned dst with pattern
+inline void fill_blocks(simd_level level, uint8_t* dst, size_t bytes, const uint8_t* pattern, bool nt){
+#if defined(__x86_64__)
+    if (level == simd_avx512){
+        fill_avx512(dst, bytes, pattern, nt);
+        return;
+    }
+    if (level == simd_avx2){
+        fill_avx2(dst, bytes, pattern, nt);
+        return;
+    }
+#endif
+    for (size_t i = 0; i < bytes; i += block){
+        std::memcpy(dst + i, pattern, block);
+    }
+}
+
+inline void copy_blocks(simd_level level, uint8_t* dst, const uint8_t* src, size_t bytes, bool nt){
+#if defined(__x86_64__)
+    if (nt && level == simd_avx512){
+        copy_nt_avx512(dst, src, bytes);
+        return;
+    }
+    if (nt && level == simd_avx2){
+        copy_nt_avx2(dst, src, bytes);
+        return;
+    }
+#endif
+    // libc memcpy is already vectorized for cached copies
+    std::memcpy(dst, src, bytes);
+}
+
+inline size_t diff_blocks(simd_level level, const uint8_t* a, const uint8_t* b, size_t bytes){
+#if defined(__x86_64__)
+    if (level == simd_avx512){
+        return diff_avx512(a, b, bytes);
+    }
+    if (level == simd_avx2){
+        return diff_avx2(a, b, bytes);
+    }
+#endif
+    return diff_scalar(a, b, bytes);
+}
+
+inline void store_fence(simd_level level, bool nt){
+#if defined(__x86_64__)
+    if (nt && level != simd_scalar){
+        _mm_sfence();
+    }
+#endif
+}
+
+template<typename T>
+inline void fill(T* dst, size_t count, T value, const buffer_ops_config& cfg = default_buffer_ops_config()){
+    if (block % sizeof(T) != 0 || cfg.level == simd_scalar){
+        std::fill(dst, dst + count, value);
+        return;
+    }
+    uint8_t pattern[block];
+    for (size_t i = 0; i < block; i += sizeof(T)){
+        std::memcpy(pattern + i, &value, sizeof(T));
+    }
+    bool nt = use_non_temporal(cfg, count * sizeof(T));
+    uint8_t* base = reinterpret_cast<uint8_t*>(dst);
+    parallel_for(cfg, count * sizeof(T), [&](size_t offset, size_t size){
+        T* begin = reinterpret_cast<T*>(base + offset);
+        T* end = reinterpret_cast<T*>(base + offset + size);
+        // Elements until the next 64 byte boundary, then whole blocks, then the tail
+        T* body = begin;
+        while (body < end && (reinterpret_cast<uintptr_t>(body) % block) != 0){
+            *body++ = value;
+        }
+        size_t body_bytes = (reinterpret_cast<uint8_t*>(end) - reinterpret_cast<uint8_t*>(body)) & ~(block - 1);
+        fill_blocks(cfg.level, reinterpret_cast<uint8_t*>(body), body_bytes, pattern, nt);
+        store_fence(cfg.level, nt);
+        std::fill(reinterpret_cast<T*>(reinterpret_cast<uint8_t*>(body) + body_bytes), end, value);
+    });
+}
+
+inline void copy(uint8_t* dst, const uint8_t* src, size_t bytes, const buffer_ops_config& cfg = default_buffer_ops_config()){
+    bool nt = use_non_temporal(cfg, bytes);
+    parallel_for(cfg, bytes, [&](size_t offset, size_t size){
+        uint8_t* d = dst + offset;
+        const uint8_t* s = src + offset;
+        size_t head = std::min(size, (block - reinterpret_cast<uintptr_t>(d) % block) % block);
+        std::memcpy(d, s, head);
+        size_t body = (size - head) & ~(block - 1);
+        copy_blocks(cfg.level, d + head, s + head, body, nt);
+        store_fence(cfg.level, nt);
+        std::memcpy(d + head + body, s + head + body, size - head - body);
+    });
+}
+
+// Element by element compare of a range, appending to a summary
+template<typename T>
+inline void compare_elements(const T* a, const T* b, size_t begin, size_t end, size_t max_records, mismatch_summary<T>& s){
+    for (size_t i = begin; i < end; i++){
+        if (a[i] != b[i] && std::memcmp(&a[i], &b[i], sizeof(T)) != 0){
+            if (s.count == 0){
+                s.first = i;
+            }
+            s.last = i;
+            s.count++;
+            if (s.indices.size() < max_records){
+                s.indices.push_back(i);
+                s.values.push_back(a[i]);
+                s.expected.push_back(b[i]);
+            }
+        }
+    }
+}
+
+template<typename T>
+inline mismatch_summary<T> compare(const T* values, const T* expected, size_t count, size_t max_records = 16,
+    const buffer_ops_config& cfg = default_buffer_ops_config()){
+    size_t bytes = count * sizeof(T);
+    // Same split as parallel_for, but on element boundaries and with one summary per chunk
+    size_t used = std::max<size_t>(1, std::min(thread_count(cfg), bytes / std::max<size_t>(cfg.min_chunk, 4096)));
+    size_t chunk = (count + used - 1) / used;
+    std::vector<mismatch_summary<T>> parts(used, mismatch_summary<T>{0, 0, 0, 0, {}, {}, {}});
+    const uint8_t* a = reinterpret_cast<const uint8_t*>(values);
+    const uint8_t* b = reinterpret_cast<const uint8_t*>(expected);
+    auto work = [&](size_t t){
+        mismatch_summary<T>& s = parts[t];
+        size_t begin = std::min(count, t * chunk);
+        size_t end = std::min(count, begin + chunk);
+        s.checked = end - begin;
+        size_t i = begin;
+        while (i < end){
+            // Bitwise scan of whole blocks, the elements of a differing block or of the tail
+            // are checked one by one
+            size_t span = (end - i) * sizeof(T);
+            i += diff_blocks(cfg.level, a + i * sizeof(T), b + i * sizeof(T), span) / sizeof(T);
+            if (i >= end){
+                break;
+            }
+            size_t stop = std::min(end, i + block / sizeof(T) + 1);
+            compare_elements(values, expected, i, stop, max_records, s);
+            i = stop;
+        }
+    };
+    workers().run(used, work);
+    mismatch_summary<T> summary = {0, 0, count, 0, {}, {}, {}};
+    for (size_t t = 0; t < used; t++){
+        mismatch_summary<T>& s = parts[t];
+        summary.checked += s.checked;
+        if (s.count == 0){
+            continue;
+        }
+        if (summary.count == 0){
+            summary.first = s.first;
+        }
+        summary.last = s.last;
+        summary.count += s.count;
+        for (size_t k = 0; k < s.indices.size() && summary.indices.size() < max_records; k++){
+            summary.indices.push_back(s.indices[k]);
+            summary.values.push_back(s.values[k]);
+            summary.expected.push_back(s.expected[k]);
+        }
+    }
+    return summary;
+}
+
+}
+
+#endif
@@ -0,0 +1,293 @@
+#ifndef __DATA_PATTERN_HPP__
+#define __DATA_PATTERN_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "buffer_ops.hpp"
+
+// Data patterns for DMA integrity checks.
+// Every word is a pure function of its index, so any range can be generated or verified on
+// its own, in parallel and at memory speed:
+//   index  : seed + i, a misplaced word tells where it came from
+//   prbs   : pseudo-random, a 32 bit hash of the index. Unlike an LFSR it can be regenerated
+//            from any offset, and it is as unlikely to match shifted or stale data.
+//   column : prbs seeded per region of region_words, e.g. per column or per burst, so data
+//            delivered to the wrong region does not verify either
+// The verifier compares 64 byte blocks against freshly generated data and reports the
+// corrupted bursts by offset.
+
+typedef enum{
+    pattern_index,
+    pattern_prbs,
+    pattern_column
+} pattern_kind;
+
+typedef struct {
+    pattern_kind kind;
+    uint32_t seed;
+    size_t region_words; // column only
+} data_pattern;
+
+typedef struct {
+    size_t burst;       // burst index
+    size_t offset;      // bytes, first corrupted word
+    size_t bad_words;   // corrupted words in the burst
+    uint32_t expected;  // first corrupted word
+    uint32_t actual;
+    int64_t source;     // index pattern: word index the actual value belongs to, else -1
+} corrupt_burst;
+
+typedef struct {
+    size_t words;
+    size_t bad_words;
+    size_t bad_bursts;
+    std::vector<corrupt_burst> bursts; // the lowest max_records corrupted bursts
+} integrity_report;
+
+inline const char* pattern_kind_name(pattern_kind kind){
+    switch (kind){
+        case pattern_index: return "index";
+        case pattern_prbs: return "prbs";
+        default: return "column";
+    }
+}
+
+inline pattern_kind parse_pattern_kind(const std::string& name){
+    if (name == "index"){
+        return pattern_index;
+    }
+    if (name == "prbs"){
+        return pattern_prbs;
+    }
+    if (name == "column"){
+        return pattern_column;
+    }
+    throw std::runtime_error("Unknown data pattern: " + name + " (index, prbs or column)");
+}
+
+namespace data_patterns {
+
+const uint32_t golden = 0x9E3779B9u;
+
+// lowbias32 integer hash
+inline uint32_t mix(uint32_t x){
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+inline uint32_t value(const data_pattern& p, size_t i){
+    switch (p.kind){
+        case pattern_index:
+            return p.seed + (uint32_t)i;
+        case pattern_prbs:
+            return mix((uint32_t)i * golden + p.seed);
+        default:{
+            size_t region = i / p.region_words;
+            return mix((uint32_t)(i % p.region_words) * golden + mix(p.seed + (uint32_t)region));
+        }
+    }
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline void linear_avx2(uint32_t* dst, size_t count, uint32_t key){
+    __m256i v = _mm256_add_epi32(_mm256_set1_epi32(key), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    const __m256i step = _mm256_set1_epi32(8);
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8){
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), v);
+        v = _mm256_add_epi32(v, step);
+    }
+    for (; k < count; k++){
+        dst[k] = key + (uint32_t)k;
+    }
+}
+
+__attribute__((target("avx2")))
+inline void hashed_avx2(uint32_t* dst, size_t count, uint32_t key){
+    const __m256i g = _mm256_set1_epi32(golden);
+    const __m256i m1 = _mm256_set1_epi32(0x7feb352d);
+    const __m256i m2 = _mm256_set1_epi32(0x846ca68b);
+    __m256i x0 = _mm256_add_epi32(_mm256_set1_epi32(key), _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), g));
+    const __m256i step = _mm256_set1_epi32(8 * golden);
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8){
+        __m256i x = x0;
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+        x = _mm256_mullo_epi32(x, m1);
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 15));
+        x = _mm256_mullo_epi32(x, m2);
+        x = _mm256_xor_si256(x, _mm256_srli_epi32(x, 16));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), x);
+        x0 = _mm256_add_epi32(x0, step);
+    }
+    for (; k < count; k++){
+        dst[k] = mix(key + (uint32_t)k * golden);
+    }
+}
+#endif
+
+// dst[k] = key + k
+inline void linear(simd_level level, uint32_t* dst, size_t count, uint32_t key){
+#if defined(__x86_64__)
+    if (level >= simd_avx2){
+        linear_avx2(dst, count, key);
+        return;
+    }
+#endif
+    for (size_t k = 0; k < count; k++){
+        dst[k] = key + (uint32_t)k;
+    }
+}
+
+// dst[k] = mix(key + k * golden)
+inline void hashed(simd_level level, uint32_t* dst, size_t count, uint32_t key){
+#if defined(__x86_64__)
+    if (level >= simd_avx2){
+        hashed_avx2(dst, count, key);
+        return;
+    }
+#endif
+    for (size_t k = 0; k < count; k++){
+        dst[k] = mix(key + (uint32_t)k * golden);
+    }
+}
+
+// Words [first, first + count) of the pattern, single threaded
+inline void generate(simd_level level, uint32_t* dst, size_t count, const data_pattern& p, size_t first){
+    if (p.kind == pattern_index){
+        linear(level, dst, count, p.seed + (uint32_t)first);
+    }
+    else if (p.kind == pattern_prbs){
+        hashed(level, dst, count, (uint32_t)first * golden + p.seed);
+    }
+    else{
+        if (p.region_words == 0){
+            throw std::runtime_error("Column pattern needs a region size");
+        }
+        // One segment per region
+        size_t done = 0;
+        while (done < count){
+            size_t i = first + done;
+            size_t offset = i % p.region_words;
+            size_t n = std::min(count - done, p.region_words - offset);
+            hashed(level, dst + done, n, (uint32_t)offset * golden + mix(p.seed + (uint32_t)(i / p.region_words)));
+            done += n;
+        }
+    }
+}
+
+// Fills count words with the pattern, starting at word first
+inline void fill(uint32_t* dst, size_t count, const data_pattern& p, size_t first = 0,
+    const buffer_ops_config& cfg = default_buffer_ops_config()){
+    buffer_ops::parallel_for(cfg, count * sizeof(uint32_t), [&](size_t offset, size_t size){
+        size_t begin = offset / sizeof(uint32_t);
+        generate(cfg.level, dst + begin, size / sizeof(uint32_t), p, first + begin);
+    });
+}
+
+// Checks count words against the pattern. Bursts of burst_words are the unit of the report;
+// every thread checks whole bursts.
+inline integrity_report verify(const uint32_t* data, size_t count, const data_pattern& p, size_t burst_words,
+    size_t max_records = 16, const buffer_ops_config& cfg = default_buffer_ops_config()){
+    if (burst_words == 0){
+        throw std::runtime_error("Burst size must not be 0");
+    }
+    size_t bursts = (count + burst_words - 1) / burst_words;
+    size_t threads = std::max<size_t>(1, std::min(buffer_ops::thread_count(cfg), count * sizeof(uint32_t) / std::max<size_t>(cfg.min_chunk, 4096)));
+    threads = std::min(threads, std::max<size_t>(bursts, 1));
+    size_t bursts_per_thread = (bursts + threads - 1) / threads;
+    std::vector<integrity_report> parts(threads, integrity_report{0, 0, 0, {}});
+
+    auto work = [&](size_t t){
+        integrity_report& r = parts[t];
+        const size_t block_words = 1024;
+        uint32_t expected[block_words];
+        size_t last = (size_t)-1;
+        size_t begin = std::min(count, t * bursts_per_thread * burst_words);
+        size_t end = std::min(count, begin + bursts_per_thread * burst_words);
+        r.words = end - begin;
+        for (size_t i = begin; i < end; i += block_words){
+            size_t n = std::min(block_words, end - i);
+            generate(cfg.level, expected, n, p, i);
+            const uint8_t* a = reinterpret_cast<const uint8_t*>(data + i);
+            const uint8_t* b = reinterpret_cast<const uint8_t*>(expected);
+            size_t bytes = n * sizeof(uint32_t);
+            size_t pos = 0;
+            while (pos < bytes){
+                pos += buffer_ops::diff_blocks(cfg.level, a + pos, b + pos, bytes - pos);
+                if (pos >= bytes){
+                    break;
+                }
+                // Words of the differing block, or of the tail
+                size_t stop = std::min(bytes, pos + buffer_ops::block);
+                for (size_t w = pos / sizeof(uint32_t); w < stop / sizeof(uint32_t); w++){
+                    if (data[i + w] == expected[w]){
+                        continue;
+                    }
+                    size_t word = i + w;
+                    size_t burst = word / burst_words;
+                    r.bad_words++;
+                    if (burst != last){
+                        // Words are checked in order, so a new burst index starts a new record
+                        last = burst;
+                        r.bad_bursts++;
+                        if (r.bursts.size() < max_records){
+                            int64_t source = -1;
+                            if (p.kind == pattern_index && (uint32_t)(data[word] - p.seed) < count){
+                                source = (uint32_t)(data[word] - p.seed);
+                            }
+                            r.bursts.push_back({burst, word * sizeof(uint32_t), 0, expected[w], data[word], source});
+                        }
+                    }
+                    if (!r.bursts.empty() && r.bursts.back().burst == burst){
+                        r.bursts.back().bad_words++;
+                    }
+                }
+                pos = stop;
+            }
+        }
+    };
+    buffer_ops::workers().run(threads, work);
+
+    integrity_report report = {0, 0, 0, {}};
+    for (integrity_report& r : parts){
+        report.words += r.words;
+        report.bad_words += r.bad_words;
+        report.bad_bursts += r.bad_bursts;
+        for (corrupt_burst& b : r.bursts){
+            if (report.bursts.size() < max_records){
+                report.bursts.push_back(b);
+            }
+        }
+    }
+    return report;
+}
+
+// Bursts that still hold the pattern word for word, e.g. output bursts a DMA never wrote
+inline std::vector<size_t> intact_bursts(const uint32_t* data, size_t count, const data_pattern& p, size_t burst_words,
+    const buffer_ops_config& cfg = default_buffer_ops_config()){
+    std::vector<size_t> intact;
+    std::vector<uint32_t> expected(burst_words);
+    for (size_t first = 0; first < count; first += burst_words){
+        size_t n = std::min(burst_words, count - first);
+        generate(cfg.level, expected.data(), n, p, first);
+        if (std::memcmp(data + first, expected.data(), n * sizeof(uint32_t)) == 0){
+            intact.push_back(first / burst_words);
+        }
+    }
+    return intact;
+}
+
+}
+
+#endif
@@ -0,0 +1,129 @@
+#ifndef __HOST_ALLOC_HPP__
+#define __HOST_ALLOC_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Host memory allocation policies.
+// Memory is mapped anonymously and can be backed by transparent huge pages (madvise) or by
+// explicit 2 MB huge pages (MAP_HUGETLB, needs pages reserved in /proc/sys/vm/nr_hugepages).
+// numa_node binds the pages to one node before they are touched. prefault touches every page
+// on allocation, so the first write or DMA does not take page faults.
+
+typedef enum{
+    host_pages_default,     // 4 KB pages
+    host_pages_transparent, // 2 MB aligned, madvise(MADV_HUGEPAGE)
+    host_pages_huge         // MAP_HUGETLB 2 MB pages
+} host_page_policy;
+
+typedef struct {
+    host_page_policy pages;
+    bool prefault;
+    int numa_node; // -1 for no binding
+} host_alloc_policy;
+
+const host_alloc_policy default_host_alloc_policy = {host_pages_default, false, -1};
+
+inline bool is_default_policy(const host_alloc_policy& policy){
+    return policy.pages == host_pages_default && !policy.prefault && policy.numa_node < 0;
+}
+
+inline std::string host_alloc_policy_name(const host_alloc_policy& policy){
+    std::string name = policy.pages == host_pages_huge ? "2m" : policy.pages == host_pages_transparent ? "thp" : "4k";
+    if (policy.prefault){
+        name += "+prefault";
+    }
+    if (policy.numa_node >= 0){
+        name += " node" + std::to_string(policy.numa_node);
+    }
+    return name;
+}
+
+namespace host_alloc {
+
+const size_t small_page = 4096;
+const size_t huge_page = 2 * 1024 * 1024;
+
+inline size_t page_size(const host_alloc_policy& policy){
+    return policy.pages == host_pages_default ? small_page : huge_page;
+}
+
+// Bytes actually mapped for size bytes, pass it to release()
+inline size_t mapped_size(size_t size, const host_alloc_policy& policy){
+    size_t page = page_size(policy);
+    return std::max<size_t>((size + page - 1) / page, 1) * page;
+}
+
+inline uint8_t* allocate(size_t size, const host_alloc_policy& policy){
+    if (policy.numa_node >= 64){
+        // the node mask below is one unsigned long
+        throw std::runtime_error("NUMA node " + std::to_string(policy.numa_node) + " is out of range, the node mask has 64 bits");
+    }
+    size_t mapped = mapped_size(size, policy);
+    uint8_t* ptr = nullptr;
+    if (policy.pages == host_pages_huge){
+        void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p == MAP_FAILED){
+            throw std::runtime_error("Unable to map " + std::to_string(mapped) + " bytes of 2 MB huge pages, reserve them in /proc/sys/vm/nr_hugepages");
+        }
+        ptr = static_cast<uint8_t*>(p);
+    }
+    else if (policy.pages == host_pages_transparent){
+        // Over-map and trim, so the range starts on a huge page boundary
+        void* p = mmap(nullptr, mapped + huge_page, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED){
+            throw std::bad_alloc();
+        }
+        uintptr_t raw = reinterpret_cast<uintptr_t>(p);
+        uintptr_t aligned = (raw + huge_page - 1) & ~(uintptr_t)(huge_page - 1);
+        if (aligned > raw){
+            munmap(p, aligned - raw);
+        }
+        munmap(reinterpret_cast<void*>(aligned + mapped), raw + huge_page - aligned);
+        ptr = reinterpret_cast<uint8_t*>(aligned);
+        if (madvise(ptr, mapped, MADV_HUGEPAGE) != 0){
+            munmap(ptr, mapped);
+            throw std::runtime_error("Transparent huge pages are not available");
+        }
+    }
+    else{
+        void* p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED){
+            throw std::bad_alloc();
+        }
+        ptr = static_cast<uint8_t*>(p);
+    }
+    if (policy.numa_node >= 0){
+        // mbind(MPOL_BIND) without a libnuma dependency
+        const int mpol_bind = 2;
+        unsigned long mask = 1UL << policy.numa_node;
+        if (syscall(SYS_mbind, ptr, mapped, mpol_bind, &mask, 64 + 1, 0) != 0){
+            munmap(ptr, mapped);
+            throw std::runtime_error("Unable to bind memory to NUMA node " + std::to_string(policy.numa_node));
+        }
+    }
+    if (policy.prefault){
+        // One write per page, after the binding so the pages come from the right node
+        size_t step = page_size(policy);
+        for (size_t offset = 0; offset < mapped; offset += step){
+            reinterpret_cast<volatile uint8_t*>(ptr)[offset] = 0;
+        }
+    }
+    return ptr;
+}
+
+inline void release(uint8_t* ptr, size_t mapped){
+    if (ptr != nullptr){
+        munmap(ptr, mapped);
+    }
+}
+
+}
+
+#endif
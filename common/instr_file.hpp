@@ -0,0 +1,213 @@
+#ifndef __INSTR_FILE_HPP__
+#define __INSTR_FILE_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Instruction files.
+// An instruction sequence is either binary, little endian 32 bit words as written by the
+// host, or text, one hex word per line as written by aiecc. instr_file maps the file read
+// only, so binary words are used in place and text is parsed straight into its destination,
+// e.g. the mapped instruction BO, without an intermediate vector. The format is detected
+// from the first bytes: text files start with hex digits and whitespace, binary sequences
+// start with a header word whose upper bytes are small.
+
+typedef enum{
+    instr_format_auto,
+    instr_format_binary,
+    instr_format_text
+} instr_format;
+
+inline const char* instr_format_name(instr_format format){
+    switch (format){
+        case instr_format_binary: return "binary";
+        case instr_format_text: return "text";
+        default: return "auto";
+    }
+}
+
+namespace instr_text {
+
+// Hex digit values, 0xFF for anything else
+struct hex_table{
+    uint8_t value[256];
+    constexpr hex_table() : value(){
+        for (int i = 0; i < 256; i++){
+            value[i] = 0xFF;
+        }
+        for (int i = 0; i < 10; i++){
+            value['0' + i] = i;
+        }
+        for (int i = 0; i < 6; i++){
+            value['a' + i] = 10 + i;
+            value['A' + i] = 10 + i;
+        }
+    }
+};
+
+inline constexpr hex_table hex = {};
+
+inline bool is_space(char c){
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Skips an optional 0x prefix in front of a word
+inline const char* skip_prefix(const char* p, const char* end){
+    if (end - p > 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X') && hex.value[(uint8_t)p[2]] != 0xFF){
+        return p + 2;
+    }
+    return p;
+}
+
+// Number of whitespace separated words
+inline size_t count_words(const char* p, const char* end){
+    size_t count = 0;
+    bool in_word = false;
+    for (; p < end; p++){
+        bool space = is_space(*p);
+        count += !space && !in_word;
+        in_word = !space;
+    }
+    return count;
+}
+
+// Parses whitespace separated hex words into out, at most max_words. Returns the number of words.
+inline size_t parse(const char* p, const char* end, uint32_t* out, size_t max_words){
+    size_t n = 0;
+    while (true){
+        while (p < end && is_space(*p)){
+            p++;
+        }
+        if (p == end){
+            return n;
+        }
+        if (n == max_words){
+            throw std::runtime_error("Instruction file has more than " + std::to_string(max_words) + " words");
+        }
+        p = skip_prefix(p, end);
+        uint32_t word = 0;
+        int digits = 0;
+        // 8 digit words are the common case, decode them without the loop
+        if (end - p >= 9 && is_space(p[8])){
+            uint32_t bits = 0;
+            for (int i = 0; i < 8; i++){
+                uint8_t v = hex.value[(uint8_t)p[i]];
+                bits |= v;
+                word = (word << 4) | (v & 0xF);
+            }
+            if (bits <= 0xF){
+                p += 8;
+                out[n++] = word;
+                continue;
+            }
+            word = 0;
+        }
+        for (; p < end && !is_space(*p); p++, digits++){
+            uint8_t v = hex.value[(uint8_t)*p];
+            if (v == 0xFF || digits == 8){
+                throw std::runtime_error("Unable to parse instruction file at word " + std::to_string(n));
+            }
+            word = (word << 4) | v;
+        }
+        out[n++] = word;
+    }
+}
+
+inline bool looks_like_text(const char* p, size_t size){
+    size_t probe = size < 64 ? size : 64;
+    if (probe == 0 || hex.value[(uint8_t)p[0]] == 0xFF){
+        return false;
+    }
+    for (size_t i = 0; i < probe; i++){
+        if (hex.value[(uint8_t)p[i]] == 0xFF && !is_space(p[i]) && p[i] != 'x' && p[i] != 'X'){
+            return false;
+        }
+    }
+    return true;
+}
+
+}
+
+// Read only mapping of an instruction file
+class instr_file{
+private:
+    const char* data_;
+    size_t size_;
+    instr_format format_;
+
+public:
+    instr_file(const std::string& path, instr_format format = instr_format_auto) : data_(nullptr), size_(0){
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0){
+            throw std::runtime_error("Failed to open instruction file " + path);
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0){
+            close(fd);
+            throw std::runtime_error("Failed to stat instruction file " + path);
+        }
+        size_ = st.st_size;
+        if (size_ > 0){
+            // populated up front, the whole file is read once right away
+            void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (p == MAP_FAILED){
+                close(fd);
+                throw std::runtime_error("Failed to map instruction file " + path);
+            }
+            data_ = (const char*)p;
+        }
+        close(fd);
+        if (size_ == 0){
+            throw std::runtime_error("Instruction file " + path + " is empty");
+        }
+        format_ = format != instr_format_auto ? format
+            : instr_text::looks_like_text(data_, size_) ? instr_format_text : instr_format_binary;
+        if (format_ == instr_format_binary && size_ % sizeof(uint32_t) != 0){
+            munmap((void*)data_, size_);
+            throw std::runtime_error("Instruction file " + path + " is not a whole number of words");
+        }
+    }
+
+    ~instr_file(){
+        if (data_){
+            munmap((void*)data_, size_);
+        }
+    }
+
+    instr_file(const instr_file&) = delete;
+    instr_file& operator=(const instr_file&) = delete;
+
+    instr_format format() const { return format_; }
+    size_t file_size() const { return size_; }
+
+    // Words in the sequence, counted without parsing for text
+    size_t words() const {
+        return format_ == instr_format_binary ? size_ / sizeof(uint32_t) : instr_text::count_words(data_, data_ + size_);
+    }
+
+    // The mapped words of a binary file
+    const uint32_t* binary_words() const {
+        return format_ == instr_format_binary ? (const uint32_t*)data_ : nullptr;
+    }
+
+    // Writes the words to out, which holds at least words(). Returns the number of words.
+    size_t read(uint32_t* out, size_t max_words) const {
+        if (format_ == instr_format_binary){
+            size_t n = size_ / sizeof(uint32_t);
+            if (n > max_words){
+                throw std::runtime_error("Instruction file has more than " + std::to_string(max_words) + " words");
+            }
+            std::memcpy(out, data_, n * sizeof(uint32_t));
+            return n;
+        }
+        return instr_text::parse(data_, data_ + size_, out, max_words);
+    }
+};
+
+#endif
@@ -11,7 +11,6 @@
 #include <stdio.h>
 #include "buffer.hpp"
 #include "debug_utils.hpp"
-#include "xrt/xrt_bo.h"
 
 const int INSTR_PRINT_WIDTH = 80;
 
@@ -120,9 +119,10 @@ inline void instr_print(int line_number, uint32_t word, std::string msg){
 }
 
 struct npu_cmd{
+    virtual ~npu_cmd() = default;
     virtual int print_cmd(uint32_t *bd, int line_number, int op_count) = 0;
     virtual void to_npu(std::vector<uint32_t>& npu_seq) = 0;
-    // virtual npu_cmd_type get_type() = 0;
+    virtual npu_cmd_type get_type() = 0;
     virtual void dump_cmd(uint32_t *bd) = 0;
     virtual int get_op_lines() = 0;
 };
@@ -73,6 +73,10 @@ struct npu_ddr_cmd : public npu_cmd{
         npu_seq.push_back(0x0);
     }
 
+    npu_cmd_type get_type(){
+        return npu_arg_set;
+    }
+
     int get_op_lines(){
         return 12;
     }
@@ -59,6 +59,10 @@ struct npu_issue_token_cmd : public npu_cmd{
         npu_seq.push_back(this->op_size << 2);
     }
 
+    npu_cmd_type get_type(){
+        return npu_sync;
+    }
+
     int get_op_lines(){
         return 7;
     }
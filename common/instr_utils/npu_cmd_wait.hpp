@@ -40,6 +40,10 @@ struct npu_wait_cmd : public npu_cmd{
         npu_seq.push_back((this->wait_channel << wait_sync_channel_shift) | (1 << wait_sync_row_shift) | (1 << wait_sync_col_shift));
     }
 
+    npu_cmd_type get_type(){
+        return npu_wait;
+    }
+
     int get_op_lines(){
         return 4;
     }
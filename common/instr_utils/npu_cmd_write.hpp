@@ -80,6 +80,11 @@ struct npu_write_cmd : public npu_cmd{
         npu_seq.push_back(this->op_size << 2);
     }
 
+    npu_cmd_type get_type(){
+        // A write to a shim DMA task queue pushes a BD
+        return this->could_be_push_queue ? npu_queue : npu_write;
+    }
+
     int get_op_lines(){
         return 6;
     }
@@ -193,6 +193,10 @@ struct npu_dma_block_cmd : public npu_cmd{
         );
     }
 
+    npu_cmd_type get_type(){
+        return npu_dma_block;
+    }
+
     int get_op_lines(){
         return 12;
     }
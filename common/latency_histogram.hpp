@@ -0,0 +1,127 @@
+#ifndef __LATENCY_HISTOGRAM_HPP__
+#define __LATENCY_HISTOGRAM_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+// Log-bucketed (HDR style) histogram of latencies in nanoseconds.
+// Values below 2^sub_bucket_bits are counted exactly; above that every power of two is split
+// into 2^(sub_bucket_bits - 1) linear buckets, so the relative error stays below 2^-(sub_bucket_bits - 1).
+// record() is a count-leading-zeros, a shift and an increment, without allocation.
+class latency_histogram{
+private:
+    int sub_bucket_bits_;
+    uint64_t sub_bucket_count_;
+    uint64_t half_count_;
+    std::vector<uint64_t> counts_;
+    uint64_t total_;
+    uint64_t min_;
+    uint64_t max_;
+    double sum_;
+    double sum_sq_;
+
+    size_t index_of(uint64_t value) const {
+        if (value < sub_bucket_count_){
+            return value;
+        }
+        int msb = 63 - __builtin_clzll(value);
+        int shift = msb - sub_bucket_bits_ + 1;
+        return shift * half_count_ + (value >> shift);
+    }
+
+    // Highest value that falls into the bucket
+    uint64_t upper_bound_of(size_t index) const {
+        if (index < sub_bucket_count_){
+            return index;
+        }
+        uint64_t shift = index / half_count_ - 1;
+        uint64_t mantissa = index - shift * half_count_;
+        return ((mantissa + 1) << shift) - 1;
+    }
+
+public:
+    latency_histogram(int sub_bucket_bits = 7)
+        : sub_bucket_bits_(sub_bucket_bits), sub_bucket_count_(1ULL << sub_bucket_bits),
+          half_count_(1ULL << (sub_bucket_bits - 1))
+    {
+        if (sub_bucket_bits < 1 || sub_bucket_bits > 16){
+            throw std::runtime_error("sub_bucket_bits must be in [1, 16]");
+        }
+        counts_.resize(index_of(UINT64_MAX) + 1);
+        reset();
+    }
+
+    inline void record(uint64_t value){
+        counts_[index_of(value)]++;
+        total_++;
+        min_ = value < min_ ? value : min_;
+        max_ = value > max_ ? value : max_;
+        double v = (double)value;
+        sum_ += v;
+        sum_sq_ += v * v;
+    }
+
+    void reset(){
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+        min_ = UINT64_MAX;
+        max_ = 0;
+        sum_ = 0.0;
+        sum_sq_ = 0.0;
+    }
+
+    void merge(const latency_histogram& other){
+        if (other.sub_bucket_bits_ != sub_bucket_bits_){
+            throw std::runtime_error("Cannot merge histograms with different precision");
+        }
+        for (size_t i = 0; i < counts_.size(); i++){
+            counts_[i] += other.counts_[i];
+        }
+        total_ += other.total_;
+        min_ = other.min_ < min_ ? other.min_ : min_;
+        max_ = other.max_ > max_ ? other.max_ : max_;
+        sum_ += other.sum_;
+        sum_sq_ += other.sum_sq_;
+    }
+
+    // p in [0, 100]; returns the upper bound of the bucket holding the p-th percentile
+    uint64_t percentile(double p) const {
+        if (total_ == 0){
+            return 0;
+        }
+        if (p >= 100.0){
+            return max_;
+        }
+        uint64_t target = (uint64_t)std::ceil(p / 100.0 * total_);
+        target = target == 0 ? 1 : target;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts_.size(); i++){
+            seen += counts_[i];
+            if (seen >= target){
+                uint64_t value = upper_bound_of(i);
+                value = value > max_ ? max_ : value;
+                return value < min_ ? min_ : value;
+            }
+        }
+        return max_;
+    }
+
+    uint64_t count() const { return total_; }
+    uint64_t min() const { return total_ ? min_ : 0; }
+    uint64_t max() const { return max_; }
+    double mean() const { return total_ ? sum_ / total_ : 0.0; }
+    double stddev() const {
+        if (total_ < 2){
+            return 0.0;
+        }
+        double m = mean();
+        double var = (sum_sq_ - total_ * m * m) / (total_ - 1);
+        return var > 0.0 ? std::sqrt(var) : 0.0;
+    }
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef __NPU_BO_ARENA_HPP__
+#define __NPU_BO_ARENA_HPP__
+
+#include <algorithm>
+#include <stdexcept>
+#include "npu_device.hpp"
+#include "buffer.hpp"
+
+// Arena of sub-buffers carved from one BO.
+// All tensors bound to the same kernel argument slot can share one parent BO: each allocation
+// is a sub-BO with its own handle, so it is synced and passed as a kernel argument on its own
+// range only. Allocation is a bump of the offset; reset() rewinds the arena once none of its
+// sub-buffers is in use anymore. Offsets are aligned to at least a cache line, so syncing one
+// sub-buffer never flushes or invalidates a line of its neighbour.
+
+class npu_bo_arena{
+private:
+    npu_device* device;
+    npu_bo parent;
+    size_t used;
+    size_t count;
+
+public:
+    static const size_t min_alignment = 64;
+
+    npu_bo_arena() : device(nullptr), used(0), count(0) {}
+    npu_bo_arena(npu_device& device, npu_bo parent) : device(&device), parent(parent), used(0), count(0) {}
+
+    npu_bo allocate(size_t size, size_t alignment = min_alignment){
+        if (!parent){
+            throw std::runtime_error("Arena has no BO");
+        }
+        alignment = std::max<size_t>(alignment, size_t(min_alignment));
+        if ((alignment & (alignment - 1)) != 0){
+            throw std::runtime_error("Arena alignment must be a power of two");
+        }
+        size_t offset = (used + alignment - 1) & ~(alignment - 1);
+        if (offset + size > parent.size()){
+            throw std::runtime_error("Arena is full: " + std::to_string(offset + size) + " > " + std::to_string(parent.size()) + " bytes");
+        }
+        used = offset + size;
+        count++;
+        return device->create_sub_bo(parent, size, offset);
+    }
+
+    template<typename T>
+    buffer<T> allocate_buffer(size_t count, size_t alignment = min_alignment){
+        return buffer<T>(allocate(count * sizeof(T), alignment));
+    }
+
+    void reset(){
+        used = 0;
+        count = 0;
+    }
+
+    size_t capacity() const { return parent ? parent.size() : 0; }
+    size_t size() const { return used; }
+    size_t allocations() const { return count; }
+    npu_bo& bo() { return parent; }
+};
+
+#endif
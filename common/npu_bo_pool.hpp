@@ -0,0 +1,157 @@
+#ifndef __NPU_BO_POOL_HPP__
+#define __NPU_BO_POOL_HPP__
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include "npu_device.hpp"
+
+// Size class pool of BOs.
+// acquire() hands out a BO of the size class of the request, keyed by group id and BO type.
+// When the last handle of a pooled BO goes away the BO returns to the pool, still mapped, and
+// the next request of the same class reuses it without allocating, mapping or pinning.
+// Size classes are 4 KiB pages rounded up to 4 steps per power of two, so at most 25% of a BO
+// is unused. Released BOs beyond max_cached_bytes are freed. Reused BOs keep their old contents.
+
+typedef struct {
+    uint64_t requests;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t live;               // BOs handed out and not released yet
+    uint64_t cached;             // BOs waiting in the pool
+    size_t live_bytes;           // size class bytes handed out
+    size_t cached_bytes;
+    size_t high_water_bytes;     // highest live_bytes + cached_bytes
+    size_t live_high_water_bytes;
+} npu_bo_pool_stats;
+
+class npu_bo_pool{
+private:
+    typedef std::tuple<int, npu_bo_type, size_t> pool_key; // group id, type, size class
+
+    struct pool_state{
+        npu_device* device;
+        std::mutex lock;
+        std::map<pool_key, std::vector<npu_bo>> free;
+        npu_bo_pool_stats stats;
+        size_t max_cached_bytes;
+        std::atomic<bool> enabled; // read without the lock on every acquire
+
+        void update_high_water(){
+            stats.high_water_bytes = std::max(stats.high_water_bytes, stats.live_bytes + stats.cached_bytes);
+            stats.live_high_water_bytes = std::max(stats.live_high_water_bytes, stats.live_bytes);
+        }
+    };
+
+    // Handle of a BO lent by the pool, returns the BO on destruction
+    struct pooled_bo_impl : public npu_bo_impl{
+        std::shared_ptr<pool_state> state;
+        pool_key key;
+        npu_bo bo;
+        size_t bytes;
+
+        pooled_bo_impl(std::shared_ptr<pool_state> state, pool_key key, npu_bo bo, size_t bytes)
+            : state(state), key(key), bo(bo), bytes(bytes) {}
+
+        ~pooled_bo_impl(){
+            std::lock_guard<std::mutex> guard(state->lock);
+            size_t capacity = std::get<2>(key);
+            state->stats.live--;
+            state->stats.live_bytes -= capacity;
+            if (state->stats.cached_bytes + capacity <= state->max_cached_bytes){
+                state->free[key].push_back(bo);
+                state->stats.cached++;
+                state->stats.cached_bytes += capacity;
+            }
+        }
+
+        uint8_t* map() { return bo.map<uint8_t*>(); }
+        size_t size() { return bytes; }
+        uint64_t address() { return bo.address(); }
+        void sync(npu_sync_dir dir, size_t size, size_t offset) { bo.sync(dir, size, offset); }
+        npu_bo_impl* base() { return bo.get()->base(); }
+    };
+
+    std::shared_ptr<pool_state> state_;
+
+public:
+    npu_bo_pool(npu_device& device, size_t max_cached_bytes = 1ULL << 30) : state_(std::make_shared<pool_state>()){
+        state_->device = &device;
+        state_->stats = {};
+        state_->max_cached_bytes = max_cached_bytes;
+        state_->enabled = true;
+    }
+
+    static size_t size_class(size_t size){
+        const size_t page = 4096;
+        size_t pages = std::max<size_t>((size + page - 1) / page, 1);
+        if (pages <= 4){
+            return pages * page;
+        }
+        // 4 steps between consecutive powers of two
+        int msb = 63 - __builtin_clzll(pages);
+        size_t step = 1ULL << (msb - 2);
+        return ((pages + step - 1) / step) * step * page;
+    }
+
+    // The BO reports the requested size, its backing allocation is the size class.
+    npu_bo acquire(size_t size, npu_bo_type type, int group_id){
+        if (!state_->enabled){
+            return state_->device->create_bo(size, type, group_id);
+        }
+        pool_key key = {group_id, type, size_class(size)};
+        npu_bo bo;
+        {
+            std::lock_guard<std::mutex> guard(state_->lock);
+            state_->stats.requests++;
+            auto it = state_->free.find(key);
+            if (it != state_->free.end() && !it->second.empty()){
+                bo = it->second.back();
+                it->second.pop_back();
+                state_->stats.hits++;
+                state_->stats.cached--;
+                state_->stats.cached_bytes -= std::get<2>(key);
+            }
+            else{
+                state_->stats.misses++;
+            }
+            state_->stats.live++;
+            state_->stats.live_bytes += std::get<2>(key);
+            state_->update_high_water();
+        }
+        if (!bo){
+            try {
+                bo = state_->device->create_bo(std::get<2>(key), type, group_id);
+            } catch (...) {
+                std::lock_guard<std::mutex> guard(state_->lock);
+                state_->stats.live--;
+                state_->stats.live_bytes -= std::get<2>(key);
+                throw;
+            }
+        }
+        return npu_bo(std::make_shared<pooled_bo_impl>(state_, key, bo, size));
+    }
+
+    // Disabled pools allocate every BO directly, e.g. to compare against pooling
+    void set_enabled(bool enabled){
+        state_->enabled = enabled;
+    }
+
+    // Frees every cached BO
+    void trim(){
+        std::lock_guard<std::mutex> guard(state_->lock);
+        state_->free.clear();
+        state_->stats.cached = 0;
+        state_->stats.cached_bytes = 0;
+    }
+
+    npu_bo_pool_stats stats(){
+        std::lock_guard<std::mutex> guard(state_->lock);
+        return state_->stats;
+    }
+};
+
+#endif
@@ -0,0 +1,264 @@
+#ifndef __NPU_BO_REGISTRY_HPP__
+#define __NPU_BO_REGISTRY_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "npu_device.hpp"
+#include "debug_utils.hpp"
+
+// Footprint of the NPU visible memory.
+// npu_tracked_device wraps a backend and records every BO the driver allocates or pins: data
+// BOs (also those cached by the pool), instruction BOs and imported user pointer BOs. A record
+// holds the size, type, group id, an optional label, e.g. "trace", and the lifetime. Sub-BOs
+// share the memory of their parent and are not recorded. The registry keeps the live records,
+// the last max_history released ones, and live and peak bytes per kind. Copies of a registry
+// share its records.
+
+typedef enum{
+    npu_bo_kind_data,
+    npu_bo_kind_instr,
+    npu_bo_kind_userptr,
+    npu_bo_kind_count
+} npu_bo_kind;
+
+inline const char* npu_bo_kind_name(npu_bo_kind kind){
+    switch (kind){
+        case npu_bo_kind_data: return "data";
+        case npu_bo_kind_instr: return "instr";
+        default: return "userptr";
+    }
+}
+
+typedef struct {
+    uint64_t id;
+    npu_bo_kind kind;
+    npu_bo_type type;
+    int group_id;
+    size_t size;
+    std::string label;
+    double created;  // s since the registry was created
+    double released; // s since the registry was created, negative while live
+} npu_bo_record;
+
+typedef struct {
+    uint64_t allocations;
+    uint64_t releases;
+    uint64_t live;
+    size_t live_bytes;
+    size_t peak_bytes;
+    size_t kind_bytes[npu_bo_kind_count];
+    size_t kind_peak_bytes[npu_bo_kind_count];
+} npu_bo_footprint;
+
+class npu_bo_registry{
+private:
+    typedef std::chrono::steady_clock clock;
+
+    struct registry_state{
+        std::mutex lock;
+        clock::time_point start;
+        uint64_t next_id;
+        std::map<npu_bo_impl*, npu_bo_record> live; // by backend BO
+        std::deque<npu_bo_record> released;
+        size_t max_history;
+        npu_bo_footprint footprint;
+
+        double now(){
+            return std::chrono::duration<double>(clock::now() - start).count();
+        }
+
+        void release(npu_bo_impl* key){
+            std::lock_guard<std::mutex> guard(lock);
+            auto it = live.find(key);
+            if (it == live.end()){
+                return;
+            }
+            npu_bo_record record = it->second;
+            live.erase(it);
+            record.released = now();
+            footprint.releases++;
+            footprint.live--;
+            footprint.live_bytes -= record.size;
+            footprint.kind_bytes[record.kind] -= record.size;
+            released.push_back(record);
+            if (released.size() > max_history){
+                released.pop_front();
+            }
+        }
+    };
+
+    // Handle of a recorded BO, releases the record with the BO
+    struct tracked_bo_impl : public npu_bo_impl{
+        std::shared_ptr<registry_state> state;
+        npu_bo bo;
+
+        tracked_bo_impl(std::shared_ptr<registry_state> state, npu_bo bo) : state(state), bo(bo) {}
+
+        ~tracked_bo_impl(){
+            state->release(bo.get()->base());
+        }
+
+        uint8_t* map() { return bo.map<uint8_t*>(); }
+        size_t size() { return bo.size(); }
+        uint64_t address() { return bo.address(); }
+        void sync(npu_sync_dir dir, size_t size, size_t offset) { bo.sync(dir, size, offset); }
+        npu_bo_impl* base() { return bo.get()->base(); }
+    };
+
+    std::shared_ptr<registry_state> state_;
+
+public:
+    npu_bo_registry(size_t max_history = 256) : state_(std::make_shared<registry_state>()){
+        state_->start = clock::now();
+        state_->next_id = 0;
+        state_->max_history = max_history;
+        state_->footprint = {};
+    }
+
+    // Records bo and returns the handle to hand out in its place
+    npu_bo track(npu_bo bo, npu_bo_kind kind, npu_bo_type type, int group_id){
+        {
+            std::lock_guard<std::mutex> guard(state_->lock);
+            npu_bo_footprint& f = state_->footprint;
+            npu_bo_record record = {state_->next_id++, kind, type, group_id, bo.size(), "", state_->now(), -1.0};
+            state_->live[bo.get()->base()] = record;
+            f.allocations++;
+            f.live++;
+            f.live_bytes += record.size;
+            f.kind_bytes[kind] += record.size;
+            f.peak_bytes = std::max(f.peak_bytes, f.live_bytes);
+            f.kind_peak_bytes[kind] = std::max(f.kind_peak_bytes[kind], f.kind_bytes[kind]);
+        }
+        return npu_bo(std::make_shared<tracked_bo_impl>(state_, bo));
+    }
+
+    // Labels the record of bo, also through pool handles. False if it is not recorded, e.g. a sub-BO.
+    bool tag(const npu_bo& bo, const std::string& label){
+        if (!bo){
+            return false;
+        }
+        std::lock_guard<std::mutex> guard(state_->lock);
+        auto it = state_->live.find(bo.get()->base());
+        if (it == state_->live.end()){
+            return false;
+        }
+        it->second.label = label;
+        return true;
+    }
+
+    npu_bo_footprint footprint(){
+        std::lock_guard<std::mutex> guard(state_->lock);
+        return state_->footprint;
+    }
+
+    // Live records, oldest first
+    std::vector<npu_bo_record> live(){
+        std::lock_guard<std::mutex> guard(state_->lock);
+        std::vector<npu_bo_record> records;
+        for (auto& entry : state_->live){
+            records.push_back(entry.second);
+        }
+        std::sort(records.begin(), records.end(), [](const npu_bo_record& a, const npu_bo_record& b){
+            return a.id < b.id;
+        });
+        return records;
+    }
+
+    // The last released records, oldest first
+    std::vector<npu_bo_record> released(){
+        std::lock_guard<std::mutex> guard(state_->lock);
+        return std::vector<npu_bo_record>(state_->released.begin(), state_->released.end());
+    }
+
+    // Totals per label, unlabeled BOs by kind, then the live BOs when verbose
+    void print_report(bool verbose = false){
+        npu_bo_footprint f = footprint();
+        std::vector<npu_bo_record> records = live();
+        std::map<std::string, std::pair<size_t, size_t>> groups; // count, bytes
+        for (const npu_bo_record& r : records){
+            std::pair<size_t, size_t>& g = groups[r.label.empty() ? npu_bo_kind_name(r.kind) : r.label];
+            g.first++;
+            g.second += r.size;
+        }
+        auto mib = [](size_t bytes){
+            std::ostringstream s;
+            s << std::fixed << std::setprecision(2) << bytes / 1024.0 / 1024.0;
+            return s.str();
+        };
+        const int width = 70;
+        MSG_BONDLINE(width);
+        MSG_BOX_LINE(width, "NPU memory footprint: " << f.live << " BOs, " << mib(f.live_bytes) << " MiB live, "
+            << mib(f.peak_bytes) << " MiB peak");
+        MSG_BOX_LINE(width, f.allocations << " allocated, " << f.releases << " released");
+        MSG_BONDLINE(width);
+        MSG_BOX_LINE(width, std::left << std::setw(20) << "kind" << std::right << std::setw(15) << "live (MiB)" << std::setw(15) << "peak (MiB)");
+        for (int k = 0; k < npu_bo_kind_count; k++){
+            MSG_BOX_LINE(width, std::left << std::setw(20) << npu_bo_kind_name((npu_bo_kind)k) << std::right
+                << std::setw(15) << mib(f.kind_bytes[k]) << std::setw(15) << mib(f.kind_peak_bytes[k]));
+        }
+        MSG_BONDLINE(width);
+        MSG_BOX_LINE(width, std::left << std::setw(20) << "label" << std::right << std::setw(15) << "BOs" << std::setw(15) << "live (MiB)");
+        for (auto& entry : groups){
+            MSG_BOX_LINE(width, std::left << std::setw(20) << entry.first << std::right << std::setw(15) << entry.second.first
+                << std::setw(15) << mib(entry.second.second));
+        }
+        MSG_BONDLINE(width);
+        if (!verbose){
+            return;
+        }
+        MSG_BOX_LINE(width, std::left << std::setw(8) << "id" << std::setw(10) << "kind" << std::setw(14) << "label"
+            << std::right << std::setw(7) << "group" << std::setw(14) << "bytes" << std::setw(12) << "age (s)");
+        double now = state_->now();
+        for (const npu_bo_record& r : records){
+            MSG_BOX_LINE(width, std::left << std::setw(8) << r.id << std::setw(10) << npu_bo_kind_name(r.kind) << std::setw(14) << r.label
+                << std::right << std::setw(7) << r.group_id << std::setw(14) << r.size << std::setw(12) << std::fixed
+                << std::setprecision(3) << now - r.created);
+        }
+        MSG_BONDLINE(width);
+    }
+};
+
+// Backend decorator that records the BOs of the wrapped device
+class npu_tracked_device : public npu_device{
+private:
+    std::unique_ptr<npu_device> device_;
+    npu_bo_registry registry_; // shares the state of the registry it was created with
+
+public:
+    npu_tracked_device(std::unique_ptr<npu_device> device, const npu_bo_registry& registry)
+        : device_(std::move(device)), registry_(registry) {}
+
+    npu_backend backend() { return device_->backend(); }
+    npu_kernel load_xclbin(const std::string& xclbin_name, const amdxdna_qos_info& qos) { return device_->load_xclbin(xclbin_name, qos); }
+
+    npu_bo create_bo(size_t size, npu_bo_type type, int group_id){
+        npu_bo_kind kind = type == npu_bo_cacheable ? npu_bo_kind_instr : npu_bo_kind_data;
+        return registry_.track(device_->create_bo(size, type, group_id), kind, type, group_id);
+    }
+
+    npu_bo create_sub_bo(npu_bo& parent, size_t size, size_t offset){
+        return device_->create_sub_bo(parent, size, offset);
+    }
+
+    npu_bo import_bo(void* ptr, size_t size, int group_id){
+        return registry_.track(device_->import_bo(ptr, size, group_id), npu_bo_kind_userptr, npu_bo_host_only, group_id);
+    }
+
+    int query_clock_metadata(amdxdna_drm_query_clock_metadata& clock) { return device_->query_clock_metadata(clock); }
+    int query_aie_metadata(amdxdna_drm_query_aie_metadata& aie) { return device_->query_aie_metadata(aie); }
+    int query_sensor(amdxdna_drm_query_sensor& sensor) { return device_->query_sensor(sensor); }
+    int query_firmware_version(amdxdna_drm_query_firmware_version& version) { return device_->query_firmware_version(version); }
+    int query_power_mode(amdxdna_drm_get_power_mode& mode) { return device_->query_power_mode(mode); }
+    int read_aie_mem(uint32_t col, uint32_t row, uint32_t addr, uint32_t size, void* buf){
+        return device_->read_aie_mem(col, row, addr, size, buf);
+    }
+};
+
+#endif
@@ -0,0 +1,391 @@
+#ifndef __NPU_DEVICE_HPP__
+#define __NPU_DEVICE_HPP__
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Device backend abstraction used by npu_app and bytes.
+// Two backends are provided:
+//  - xrt: the real XRT/amdxdna path (npu_device_xrt.cpp)
+//  - sim: a software NPU that keeps BOs in host memory and completes runs after a
+//         bandwidth/latency model derived from the instruction sequence (npu_device_sim.cpp)
+// Build with -DNPU_NO_XRT (make NO_XRT=1) to drop the XRT backend; only the simulated
+// backend is available then, and no XRT headers or libraries are required.
+#ifndef NPU_NO_XRT
+#define __XRT__
+#endif
+
+#ifdef __XRT__
+#include "xrt/xrt_bo.h"
+#include "xrt/xrt_device.h"
+#include "xrt/xrt_kernel.h"
+#else
+// Same values as ert_cmd_state in xrt/detail/ert.h
+typedef enum {
+    ERT_CMD_STATE_NEW = 1,
+    ERT_CMD_STATE_QUEUED = 2,
+    ERT_CMD_STATE_RUNNING = 3,
+    ERT_CMD_STATE_COMPLETED = 4,
+    ERT_CMD_STATE_ERROR = 5,
+    ERT_CMD_STATE_ABORT = 6,
+    ERT_CMD_STATE_SUBMITTED = 7,
+    ERT_CMD_STATE_TIMEOUT = 8,
+    ERT_CMD_STATE_NORESPONSE = 9,
+} ert_cmd_state;
+#endif
+
+#include "amdxdna_accel.h"
+
+typedef enum{
+    npu_backend_xrt,
+    npu_backend_sim
+} npu_backend;
+
+#ifdef __XRT__
+#define NPU_DEFAULT_BACKEND npu_backend_xrt
+#else
+#define NPU_DEFAULT_BACKEND npu_backend_sim
+#endif
+
+typedef enum{
+    npu_bo_host_only, // XRT_BO_FLAGS_HOST_ONLY, data buffers
+    npu_bo_cacheable  // XCL_BO_FLAGS_CACHEABLE, instruction buffers
+} npu_bo_type;
+
+typedef enum{
+    npu_sync_to_device,
+    npu_sync_from_device
+} npu_sync_dir;
+
+typedef enum{
+    npu_arg_bo,
+    npu_arg_scalar
+} npu_arg_kind;
+
+inline const char* npu_arg_kind_name(npu_arg_kind kind){
+    return kind == npu_arg_bo ? "BO" : "scalar";
+}
+
+// One argument of a kernel signature, in slot order
+typedef struct {
+    std::string name;
+    npu_arg_kind kind;
+    size_t size; // bytes of a scalar
+} npu_kernel_arg;
+
+// --------------------- Backend interfaces --------------------- //
+// Each backend implements these. The handle classes below share ownership of an
+// implementation, so they are cheap to copy, just like xrt::bo and xrt::run.
+
+struct npu_bo_impl{
+    virtual ~npu_bo_impl() = default;
+    virtual uint8_t* map() = 0;
+    virtual size_t size() = 0;
+    virtual uint64_t address() = 0;
+    virtual void sync(npu_sync_dir dir, size_t size, size_t offset) = 0;
+    // The backend object behind wrappers such as pooled BOs
+    virtual npu_bo_impl* base() { return this; }
+};
+
+class npu_bo;
+
+struct npu_run_impl{
+    virtual ~npu_run_impl() = default;
+    virtual void set_arg(int index, npu_bo& bo) = 0;
+    virtual void set_arg(int index, const void* value, size_t bytes) = 0;
+    virtual void start() = 0;
+    // timeout_ms == 0 waits until the run completes
+    virtual ert_cmd_state wait(unsigned int timeout_ms) = 0;
+    virtual ert_cmd_state state() = 0;
+};
+
+class npu_run;
+
+struct npu_runlist_impl{
+    virtual ~npu_runlist_impl() = default;
+    virtual void add(npu_run& run) = 0;
+    virtual void execute() = 0;
+    virtual void wait() = 0;
+    virtual void reset() = 0;
+};
+
+class npu_runlist;
+
+struct npu_kernel_impl{
+    virtual ~npu_kernel_impl() = default;
+    virtual int group_id(int arg_index) = 0;
+    virtual std::string name() = 0;
+    // Empty when the backend does not know the signature
+    virtual std::vector<npu_kernel_arg> args() = 0;
+    virtual npu_run create_run() = 0;
+    virtual npu_runlist create_runlist() = 0;
+    // Creates the hardware context and kernel. Backends call it on first use; it may be
+    // called ahead of time from any thread and only does the work once.
+    virtual void prepare() {}
+};
+
+// --------------------- Handles --------------------- //
+class npu_bo{
+public:
+    npu_bo() = default;
+    explicit npu_bo(std::shared_ptr<npu_bo_impl> impl) : impl_(std::move(impl)) {}
+
+    template<typename T>
+    T map() { return reinterpret_cast<T>(impl_->map()); }
+    size_t size() const { return impl_->size(); }
+    uint64_t address() const { return impl_->address(); }
+    void sync(npu_sync_dir dir) { impl_->sync(dir, impl_->size(), 0); }
+    void sync(npu_sync_dir dir, size_t size, size_t offset) { impl_->sync(dir, size, offset); }
+
+    npu_bo_impl* get() const { return impl_.get(); }
+    // Refers to the BO without keeping it alive, e.g. from a cache
+    std::weak_ptr<npu_bo_impl> weak() const { return impl_; }
+    explicit operator bool() const { return impl_ != nullptr; }
+
+private:
+    std::shared_ptr<npu_bo_impl> impl_;
+};
+
+class npu_run{
+public:
+    npu_run() = default;
+    explicit npu_run(std::shared_ptr<npu_run_impl> impl) : impl_(std::move(impl)) {}
+
+    void set_arg(int index, npu_bo& bo) { impl_->set_arg(index, bo); }
+    // Scalar arguments are passed by value, e.g. the opcode and the instruction size.
+    template<typename T>
+    void set_arg(int index, const T& value) { impl_->set_arg(index, &value, sizeof(T)); }
+    void set_arg(int index, const void* value, size_t bytes) { impl_->set_arg(index, value, bytes); }
+    void start() { impl_->start(); }
+    ert_cmd_state wait(unsigned int timeout_ms = 0) { return impl_->wait(timeout_ms); }
+    ert_cmd_state state() { return impl_->state(); }
+
+    npu_run_impl* get() const { return impl_.get(); }
+    explicit operator bool() const { return impl_ != nullptr; }
+
+private:
+    std::shared_ptr<npu_run_impl> impl_;
+};
+
+class npu_runlist{
+public:
+    npu_runlist() = default;
+    explicit npu_runlist(std::shared_ptr<npu_runlist_impl> impl) : impl_(std::move(impl)) {}
+
+    void add(npu_run run) { impl_->add(run); }
+    void execute() { impl_->execute(); }
+    void wait() { impl_->wait(); }
+    void reset() { impl_->reset(); }
+
+    npu_runlist_impl* get() const { return impl_.get(); }
+    explicit operator bool() const { return impl_ != nullptr; }
+
+private:
+    std::shared_ptr<npu_runlist_impl> impl_;
+};
+
+class npu_kernel{
+public:
+    npu_kernel() = default;
+    explicit npu_kernel(std::shared_ptr<npu_kernel_impl> impl) : impl_(std::move(impl)) {}
+
+    int group_id(int arg_index) { return impl_->group_id(arg_index); }
+    std::string name() { return impl_->name(); }
+    std::vector<npu_kernel_arg> args() { return impl_->args(); }
+    npu_run create_run() { return impl_->create_run(); }
+    npu_runlist create_runlist() { return impl_->create_runlist(); }
+    void prepare() { impl_->prepare(); }
+
+    npu_kernel_impl* get() const { return impl_.get(); }
+    explicit operator bool() const { return impl_ != nullptr; }
+
+private:
+    std::shared_ptr<npu_kernel_impl> impl_;
+};
+
+// --------------------- Device --------------------- //
+// Driver queries return 0 on success and a negative value on failure.
+class npu_device{
+public:
+    virtual ~npu_device() = default;
+    virtual npu_backend backend() = 0;
+    // Loads and registers an xclbin and returns its MLIR_AIE kernel. The hardware context is
+    // created with the qos hints by npu_kernel::prepare(), at the latest on the first run.
+    // Every call returns a kernel with its own context. Thread safe.
+    virtual npu_kernel load_xclbin(const std::string& xclbin_name, const amdxdna_qos_info& qos) = 0;
+    virtual npu_bo create_bo(size_t size, npu_bo_type type, int group_id) = 0;
+    // View of [offset, offset + size) of parent with its own handle; keeps parent alive.
+    // Syncs and kernel arguments of the view only cover its range.
+    virtual npu_bo create_sub_bo(npu_bo& parent, size_t size, size_t offset) = 0;
+    // User pointer BO over page aligned host memory, no copy. The memory must outlive the BO.
+    virtual npu_bo import_bo(void* ptr, size_t size, int group_id) = 0;
+
+    virtual int query_clock_metadata(amdxdna_drm_query_clock_metadata& clock) = 0;
+    virtual int query_aie_metadata(amdxdna_drm_query_aie_metadata& aie) = 0;
+    virtual int query_sensor(amdxdna_drm_query_sensor& sensor) = 0;
+    virtual int query_firmware_version(amdxdna_drm_query_firmware_version& version) = 0;
+    virtual int query_power_mode(amdxdna_drm_get_power_mode& mode) = 0;
+    virtual int read_aie_mem(uint32_t col, uint32_t row, uint32_t addr, uint32_t size, void* buf) = 0;
+};
+
+// Cost model of the simulated NPU.
+// A run takes launch_latency + tasks * task_latency + max(read time, write time),
+// where the DDR traffic and the number of BD tasks are decoded from the instruction sequence.
+typedef struct{
+    double read_bandwidth;  // GiB/s, DDR to array (MM2S)
+    double write_bandwidth; // GiB/s, array to DDR (S2MM)
+    double launch_latency;  // us, fixed cost of every run
+    double task_latency;    // us, per BD task pushed to a shim DMA queue
+    double xclbin_latency;  // us, loading and registering an xclbin
+    double context_latency; // us, creating a hardware context
+} npu_sim_config;
+
+// Default model, overridable with NPU_SIM_READ_BW, NPU_SIM_WRITE_BW (GiB/s),
+// NPU_SIM_LAUNCH_US, NPU_SIM_TASK_US, NPU_SIM_XCLBIN_US and NPU_SIM_CONTEXT_US (us).
+npu_sim_config npu_sim_config_from_env();
+
+std::unique_ptr<npu_device> create_npu_sim_device(const npu_sim_config& config);
+#ifdef __XRT__
+std::unique_ptr<npu_device> create_npu_xrt_device(unsigned int device_id);
+#endif
+
+inline std::unique_ptr<npu_device> create_npu_device(npu_backend backend, unsigned int device_id = 0U){
+    if (backend == npu_backend_sim){
+        return create_npu_sim_device(npu_sim_config_from_env());
+    }
+#ifdef __XRT__
+    return create_npu_xrt_device(device_id);
+#else
+    throw std::runtime_error("XRT backend is not built (NPU_NO_XRT)");
+#endif
+}
+
+inline npu_backend parse_npu_backend(const std::string& name){
+    if (name == "xrt"){
+        return npu_backend_xrt;
+    }
+    if (name == "sim"){
+        return npu_backend_sim;
+    }
+    throw std::runtime_error("Unknown backend: " + name + ", expected xrt or sim");
+}
+
+inline std::string npu_backend_name(npu_backend backend){
+    return backend == npu_backend_sim ? "sim" : "xrt";
+}
+
+// --------------------- QoS --------------------- //
+// Hints of a hardware context, handed to the driver when the context is created. Zero fields
+// are left out, so the driver picks its own default for them.
+const amdxdna_qos_info default_npu_qos = {
+    .gops = 100000,
+    .fps = 0,
+    .dma_bandwidth = 180,
+    .latency = 0,
+    .frame_exec_time = 0,
+    .priority = AMDXDNA_QOS_HIGH_PRIORITY,
+};
+
+// Driver defaults for every field
+const amdxdna_qos_info no_npu_qos = {};
+
+inline std::vector<std::pair<std::string, uint32_t amdxdna_qos_info::*>> npu_qos_fields(){
+    return {{"gops", &amdxdna_qos_info::gops}, {"fps", &amdxdna_qos_info::fps},
+        {"dma_bandwidth", &amdxdna_qos_info::dma_bandwidth}, {"latency", &amdxdna_qos_info::latency},
+        {"frame_exec_time", &amdxdna_qos_info::frame_exec_time}, {"priority", &amdxdna_qos_info::priority}};
+}
+
+inline std::string npu_qos_priority_name(uint32_t priority){
+    switch (priority){
+        case AMDXDNA_QOS_DEFAULT_PRIORITY: return "default";
+        case AMDXDNA_QOS_REALTIME_PRIORITY: return "realtime";
+        case AMDXDNA_QOS_HIGH_PRIORITY: return "high";
+        case AMDXDNA_QOS_NORMAL_PRIORITY: return "normal";
+        case AMDXDNA_QOS_LOW_PRIORITY: return "low";
+        default: return std::to_string(priority);
+    }
+}
+
+// The set fields as the key/value map xrt::hw_context takes
+inline std::map<std::string, uint32_t> npu_qos_map(const amdxdna_qos_info& qos){
+    std::map<std::string, uint32_t> map;
+    for (const auto& field : npu_qos_fields()){
+        if (qos.*field.second != 0){
+            map[field.first] = qos.*field.second;
+        }
+    }
+    return map;
+}
+
+// "gops=100000,dma_bandwidth=180,priority=high", or "none" when nothing is set
+inline std::string npu_qos_str(const amdxdna_qos_info& qos){
+    std::string str;
+    for (const auto& entry : npu_qos_map(qos)){
+        str += (str.empty() ? "" : ",") + entry.first + "="
+            + (entry.first == "priority" ? npu_qos_priority_name(entry.second) : std::to_string(entry.second));
+    }
+    return str.empty() ? "none" : str;
+}
+
+// Inverse of npu_qos_str, also takes "default" and numeric priorities
+inline amdxdna_qos_info parse_npu_qos(const std::string& spec){
+    if (spec == "default"){
+        return default_npu_qos;
+    }
+    amdxdna_qos_info qos = no_npu_qos;
+    if (spec == "none" || spec.empty()){
+        return qos;
+    }
+    size_t begin = 0;
+    while (begin <= spec.size()){
+        size_t end = spec.find(',', begin);
+        end = end == std::string::npos ? spec.size() : end;
+        std::string item = spec.substr(begin, end - begin);
+        size_t eq = item.find('=');
+        std::string key = item.substr(0, eq);
+        std::string value = eq == std::string::npos ? "" : item.substr(eq + 1);
+        bool found = false;
+        for (const auto& field : npu_qos_fields()){
+            if (field.first != key){
+                continue;
+            }
+            found = true;
+            uint32_t parsed = 0;
+            bool named = false;
+            if (key == "priority"){
+                for (uint32_t p : {AMDXDNA_QOS_DEFAULT_PRIORITY, AMDXDNA_QOS_REALTIME_PRIORITY, AMDXDNA_QOS_HIGH_PRIORITY,
+                    AMDXDNA_QOS_NORMAL_PRIORITY, AMDXDNA_QOS_LOW_PRIORITY}){
+                    if (value == npu_qos_priority_name(p)){
+                        parsed = p;
+                        named = true;
+                    }
+                }
+            }
+            if (!named){
+                try{
+                    size_t used = 0;
+                    parsed = std::stoul(value, &used, 0);
+                    if (used != value.size()){
+                        throw std::invalid_argument(value);
+                    }
+                }
+                catch (const std::exception&){
+                    throw std::runtime_error("Invalid QoS value: " + item);
+                }
+            }
+            qos.*field.second = parsed;
+        }
+        if (!found){
+            throw std::runtime_error("Unknown QoS field: " + key + ", expected gops, fps, dma_bandwidth, latency, frame_exec_time or priority");
+        }
+        begin = end + 1;
+    }
+    return qos;
+}
+
+#endif
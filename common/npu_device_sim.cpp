@@ -0,0 +1,374 @@
+#include "npu_device.hpp"
+#include "npu_instr_utils.hpp"
+#include "debug_utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+// Simulated NPU.
+// BOs are page aligned host memory. Starting a run decodes the instruction BO (argument 1)
+// with npu_sequence, and the run completes once the modeled execution time has elapsed.
+// Runs are executed one after another, as they would be on a single hardware context.
+
+typedef std::chrono::steady_clock sim_clock;
+
+// Device wide state shared by all kernels and runs of one simulated device
+struct sim_state{
+    npu_sim_config config;
+    std::mutex lock;
+    sim_clock::time_point busy_until;
+    uint64_t next_address;
+};
+
+// Sleep for most of the interval, then spin, so short runs are not stretched by the scheduler.
+static void sim_wait_until(sim_clock::time_point t){
+    const auto spin_window = std::chrono::microseconds(200);
+    auto now = sim_clock::now();
+    if (t - now > spin_window){
+        std::this_thread::sleep_until(t - spin_window);
+    }
+    while (sim_clock::now() < t){
+    }
+}
+
+static double env_or(const char* name, double value){
+    const char* env = std::getenv(name);
+    if (env == nullptr){
+        return value;
+    }
+    return std::atof(env);
+}
+
+npu_sim_config npu_sim_config_from_env(){
+    npu_sim_config config = {
+        .read_bandwidth = 60.0,
+        .write_bandwidth = 60.0,
+        .launch_latency = 20.0,
+        .task_latency = 0.5,
+        .xclbin_latency = 2000.0,
+        .context_latency = 10000.0,
+    };
+    config.read_bandwidth = env_or("NPU_SIM_READ_BW", config.read_bandwidth);
+    config.write_bandwidth = env_or("NPU_SIM_WRITE_BW", config.write_bandwidth);
+    config.launch_latency = env_or("NPU_SIM_LAUNCH_US", config.launch_latency);
+    config.task_latency = env_or("NPU_SIM_TASK_US", config.task_latency);
+    config.xclbin_latency = env_or("NPU_SIM_XCLBIN_US", config.xclbin_latency);
+    config.context_latency = env_or("NPU_SIM_CONTEXT_US", config.context_latency);
+    return config;
+}
+
+struct sim_bo_impl : public npu_bo_impl{
+    uint8_t* data;
+    size_t bytes;
+    uint64_t addr;
+    bool owns_data; // false for user pointer BOs
+    // Decoded traffic when this BO holds an instruction sequence, invalidated on sync to device.
+    // Runs on several threads, e.g. the reaper and the callers, decode it, so it is guarded.
+    std::mutex traffic_lock;
+    bool traffic_valid;
+    npu_ddr_traffic traffic;
+
+    sim_bo_impl(size_t size, uint64_t address) : data(nullptr), bytes(size), addr(address), owns_data(true), traffic_valid(false){
+        if (posix_memalign(reinterpret_cast<void**>(&data), 4096, std::max<size_t>(size, 1)) != 0){
+            throw std::bad_alloc();
+        }
+        std::memset(data, 0, size);
+    }
+
+    sim_bo_impl(uint8_t* user_data, size_t size, uint64_t address)
+        : data(user_data), bytes(size), addr(address), owns_data(false), traffic_valid(false) {}
+
+    ~sim_bo_impl(){
+        if (owns_data){
+            free(data);
+        }
+    }
+
+    uint8_t* map(){
+        return data;
+    }
+
+    size_t size(){
+        return bytes;
+    }
+
+    uint64_t address(){
+        return addr;
+    }
+
+    void sync(npu_sync_dir dir, size_t size, size_t offset){
+        if (offset + size > bytes){
+            throw std::runtime_error("Sync range is out of the BO");
+        }
+        if (dir == npu_sync_to_device){
+            std::lock_guard<std::mutex> guard(traffic_lock);
+            traffic_valid = false;
+        }
+    }
+
+    npu_ddr_traffic get_traffic(npu_bo& self){
+        std::lock_guard<std::mutex> guard(traffic_lock);
+        if (!traffic_valid){
+            npu_sequence seq(self);
+            traffic = seq.get_ddr_traffic();
+            traffic_valid = true;
+        }
+        return traffic;
+    }
+};
+
+struct sim_sub_bo_impl : public npu_bo_impl{
+    npu_bo parent;
+    size_t bytes;
+    size_t offset;
+
+    sim_sub_bo_impl(npu_bo& parent, size_t size, size_t offset) : parent(parent), bytes(size), offset(offset){
+        if (offset + size > parent.size()){
+            throw std::runtime_error("Sub-buffer is out of the parent BO");
+        }
+    }
+
+    uint8_t* map(){
+        return parent.map<uint8_t*>() + offset;
+    }
+
+    size_t size(){
+        return bytes;
+    }
+
+    uint64_t address(){
+        return parent.address() + offset;
+    }
+
+    void sync(npu_sync_dir dir, size_t size, size_t offset){
+        if (offset + size > bytes){
+            throw std::runtime_error("Sync range is out of the BO");
+        }
+        parent.sync(dir, size, this->offset + offset);
+    }
+};
+
+struct sim_run_impl : public npu_run_impl{
+    std::shared_ptr<sim_state> state_;
+    std::vector<npu_bo> bo_args;
+    bool started;
+    sim_clock::time_point end_time;
+
+    sim_run_impl(std::shared_ptr<sim_state> state) : state_(state), started(false) {}
+
+    void set_arg(int index, npu_bo& bo){
+        if (index >= bo_args.size()){
+            bo_args.resize(index + 1);
+        }
+        bo_args[index] = bo;
+    }
+
+    void set_arg(int index, const void* value, size_t bytes){
+        // Scalars do not change the modeled execution time
+    }
+
+    void start(){
+        if (bo_args.size() < 2 || !bo_args[1]){
+            throw std::runtime_error("Simulated run started without an instruction BO");
+        }
+        sim_bo_impl* instr = static_cast<sim_bo_impl*>(bo_args[1].get()->base());
+        npu_ddr_traffic traffic = instr->get_traffic(bo_args[1]);
+        const npu_sim_config& config = state_->config;
+        const double gib = 1024.0 * 1024.0 * 1024.0;
+        double read_us = traffic.read_bytes / (config.read_bandwidth * gib) * 1e6;
+        double write_us = traffic.write_bytes / (config.write_bandwidth * gib) * 1e6;
+        double run_us = config.launch_latency + traffic.tasks * config.task_latency + std::max(read_us, write_us);
+        auto duration = std::chrono::duration_cast<sim_clock::duration>(std::chrono::duration<double, std::micro>(run_us));
+
+        std::lock_guard<std::mutex> guard(state_->lock);
+        sim_clock::time_point begin = std::max(sim_clock::now(), state_->busy_until);
+        end_time = begin + duration;
+        state_->busy_until = end_time;
+        started = true;
+        LOG_VERBOSE(3, "Simulated run: " << traffic.read_bytes << " B read, " << traffic.write_bytes << " B written, " << run_us << " us");
+    }
+
+    ert_cmd_state wait(unsigned int timeout_ms){
+        if (!started){
+            return ERT_CMD_STATE_NEW;
+        }
+        sim_clock::time_point until = end_time;
+        if (timeout_ms > 0){
+            until = std::min(until, sim_clock::now() + std::chrono::milliseconds(timeout_ms));
+        }
+        sim_wait_until(until);
+        return sim_clock::now() >= end_time ? ERT_CMD_STATE_COMPLETED : ERT_CMD_STATE_TIMEOUT;
+    }
+
+    ert_cmd_state state(){
+        if (!started){
+            return ERT_CMD_STATE_NEW;
+        }
+        return sim_clock::now() >= end_time ? ERT_CMD_STATE_COMPLETED : ERT_CMD_STATE_RUNNING;
+    }
+};
+
+struct sim_runlist_impl : public npu_runlist_impl{
+    std::vector<npu_run> runs;
+
+    void add(npu_run& run){
+        runs.push_back(run);
+    }
+
+    void execute(){
+        for (int i = 0; i < runs.size(); i++){
+            runs[i].start();
+        }
+    }
+
+    void wait(){
+        // Runs complete in order, the last one finishes the list
+        if (!runs.empty()){
+            runs.back().wait();
+        }
+    }
+
+    void reset(){
+        runs.clear();
+    }
+};
+
+struct sim_kernel_impl : public npu_kernel_impl{
+    std::shared_ptr<sim_state> state_;
+    std::string kernel_name;
+    std::once_flag ready;
+
+    sim_kernel_impl(std::shared_ptr<sim_state> state, std::string name) : state_(state), kernel_name(name) {}
+
+    // Contexts are created concurrently, each takes context_latency
+    void prepare(){
+        std::call_once(ready, [this](){
+            std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(state_->config.context_latency));
+        });
+    }
+
+    int group_id(int arg_index){
+        return arg_index;
+    }
+
+    std::string name(){
+        return kernel_name;
+    }
+
+    // Signature of the MLIR_AIE kernels aiecc generates
+    std::vector<npu_kernel_arg> args(){
+        std::vector<npu_kernel_arg> list = {{"opcode", npu_arg_scalar, 8}, {"instr", npu_arg_bo, 0}, {"ninstr", npu_arg_scalar, 4}};
+        for (int i = 0; i < 5; i++){
+            list.push_back({"bo" + std::to_string(i), npu_arg_bo, 0});
+        }
+        return list;
+    }
+
+    npu_run create_run(){
+        prepare();
+        return npu_run(std::make_shared<sim_run_impl>(state_));
+    }
+
+    npu_runlist create_runlist(){
+        prepare();
+        return npu_runlist(std::make_shared<sim_runlist_impl>());
+    }
+};
+
+class sim_device : public npu_device{
+private:
+    std::shared_ptr<sim_state> state_;
+
+public:
+    sim_device(const npu_sim_config& config) : state_(std::make_shared<sim_state>()){
+        state_->config = config;
+        state_->busy_until = sim_clock::now();
+        state_->next_address = 0x100000000ULL;
+    }
+
+    npu_backend backend(){
+        return npu_backend_sim;
+    }
+
+    npu_kernel load_xclbin(const std::string& xclbin_name, const amdxdna_qos_info& qos){
+        // The xclbin is not read, so sweeps can be dry-run before the bitstreams exist.
+        // QoS hints are not modeled, every context shares the device in run order.
+        LOG_VERBOSE(2, "Simulated xclbin: " << xclbin_name << ", QoS " << npu_qos_str(qos));
+        std::this_thread::sleep_for(std::chrono::duration<double, std::micro>(state_->config.xclbin_latency));
+        return npu_kernel(std::make_shared<sim_kernel_impl>(state_, "MLIR_AIE"));
+    }
+
+    npu_bo create_bo(size_t size, npu_bo_type type, int group_id){
+        std::lock_guard<std::mutex> guard(state_->lock);
+        uint64_t address = state_->next_address;
+        state_->next_address += (size + 4095) & ~(uint64_t)4095;
+        return npu_bo(std::make_shared<sim_bo_impl>(size, address));
+    }
+
+    npu_bo create_sub_bo(npu_bo& parent, size_t size, size_t offset){
+        return npu_bo(std::make_shared<sim_sub_bo_impl>(parent, size, offset));
+    }
+
+    npu_bo import_bo(void* ptr, size_t size, int group_id){
+        std::lock_guard<std::mutex> guard(state_->lock);
+        uint64_t address = state_->next_address;
+        state_->next_address += (size + 4095) & ~(uint64_t)4095;
+        return npu_bo(std::make_shared<sim_bo_impl>(static_cast<uint8_t*>(ptr), size, address));
+    }
+
+    int query_clock_metadata(amdxdna_drm_query_clock_metadata& clock){
+        std::memset(&clock, 0, sizeof(clock));
+        std::strncpy((char*)clock.mp_npu_clock.name, "sim MP-NPU", sizeof(clock.mp_npu_clock.name) - 1);
+        std::strncpy((char*)clock.h_clock.name, "sim H", sizeof(clock.h_clock.name) - 1);
+        clock.mp_npu_clock.freq_mhz = 1267;
+        clock.h_clock.freq_mhz = 1800;
+        return 0;
+    }
+
+    int query_aie_metadata(amdxdna_drm_query_aie_metadata& aie){
+        // Same layout as an npu2 part
+        std::memset(&aie, 0, sizeof(aie));
+        aie.cols = 8;
+        aie.rows = 6;
+        aie.version.major = 1;
+        aie.version.minor = 1;
+        aie.core = {.row_count = 4, .row_start = 2, .dma_channel_count = 2, .lock_count = 16, .event_reg_count = 4};
+        aie.mem = {.row_count = 1, .row_start = 1, .dma_channel_count = 6, .lock_count = 64, .event_reg_count = 6};
+        aie.shim = {.row_count = 1, .row_start = 0, .dma_channel_count = 2, .lock_count = 16, .event_reg_count = 4};
+        return 0;
+    }
+
+    int query_sensor(amdxdna_drm_query_sensor& sensor){
+        std::memset(&sensor, 0, sizeof(sensor));
+        std::strncpy((char*)sensor.label, "Simulated power", sizeof(sensor.label) - 1);
+        std::strncpy((char*)sensor.units, "W", sizeof(sensor.units) - 1);
+        sensor.type = AMDXDNA_SENSOR_TYPE_POWER;
+        return 0;
+    }
+
+    int query_firmware_version(amdxdna_drm_query_firmware_version& version){
+        // 0.0.0.0 marks results that did not come from hardware
+        std::memset(&version, 0, sizeof(version));
+        return 0;
+    }
+
+    int query_power_mode(amdxdna_drm_get_power_mode& mode){
+        std::memset(&mode, 0, sizeof(mode));
+        mode.power_mode = POWER_MODE_DEFAULT;
+        return 0;
+    }
+
+    int read_aie_mem(uint32_t col, uint32_t row, uint32_t addr, uint32_t size, void* buf){
+        // Tile memories are not simulated
+        std::memset(buf, 0, size);
+        return 0;
+    }
+};
+
+std::unique_ptr<npu_device> create_npu_sim_device(const npu_sim_config& config){
+    return std::make_unique<sim_device>(config);
+}
@@ -0,0 +1,277 @@
+#include "npu_device.hpp"
+
+#ifdef __XRT__
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <set>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include "debug_utils.hpp"
+#include "experimental/xrt_kernel.h"
+
+// XRT/amdxdna backend.
+// Thin wrappers around xrt::bo, xrt::run and xrt::runlist. Driver queries go through
+// DRM_IOCTL_AMDXDNA_GET_INFO on /dev/accel/accel0.
+
+struct xrt_bo_impl : public npu_bo_impl{
+    xrt::bo bo;
+
+    xrt_bo_impl(xrt::bo bo) : bo(bo) {}
+
+    uint8_t* map(){
+        return bo.map<uint8_t*>();
+    }
+
+    size_t size(){
+        return bo.size();
+    }
+
+    uint64_t address(){
+        return bo.address();
+    }
+
+    void sync(npu_sync_dir dir, size_t size, size_t offset){
+        bo.sync(dir == npu_sync_to_device ? XCL_BO_SYNC_BO_TO_DEVICE : XCL_BO_SYNC_BO_FROM_DEVICE, size, offset);
+    }
+};
+
+static xrt::bo& to_xrt_bo(npu_bo& bo){
+    xrt_bo_impl* impl = bo ? dynamic_cast<xrt_bo_impl*>(bo.get()->base()) : nullptr;
+    if (impl == nullptr){
+        throw std::runtime_error("BO was not created by the XRT backend");
+    }
+    return impl->bo;
+}
+
+struct xrt_sub_bo_impl : public xrt_bo_impl{
+    npu_bo parent;
+
+    xrt_sub_bo_impl(npu_bo& parent, size_t size, size_t offset)
+        : xrt_bo_impl(xrt::bo(to_xrt_bo(parent), size, offset)), parent(parent) {}
+};
+
+struct xrt_run_impl : public npu_run_impl{
+    xrt::run run;
+
+    xrt_run_impl(xrt::kernel& kernel) : run(kernel) {}
+
+    void set_arg(int index, npu_bo& bo){
+        run.set_arg(index, to_xrt_bo(bo));
+    }
+
+    void set_arg(int index, const void* value, size_t bytes){
+        run.set_arg(index, value, bytes);
+    }
+
+    void start(){
+        run.start();
+    }
+
+    ert_cmd_state wait(unsigned int timeout_ms){
+        return run.wait(std::chrono::milliseconds(timeout_ms));
+    }
+
+    ert_cmd_state state(){
+        return run.state();
+    }
+};
+
+struct xrt_runlist_impl : public npu_runlist_impl{
+    xrt::runlist runlist;
+
+    xrt_runlist_impl(xrt::hw_context& context) : runlist(context) {}
+
+    void add(npu_run& run){
+        xrt_run_impl* impl = dynamic_cast<xrt_run_impl*>(run.get());
+        if (impl == nullptr){
+            throw std::runtime_error("Run was not created by the XRT backend");
+        }
+        runlist.add(impl->run);
+    }
+
+    void execute(){
+        runlist.execute();
+    }
+
+    void wait(){
+        runlist.wait();
+    }
+
+    void reset(){
+        runlist.reset();
+    }
+};
+
+// The xclbin is parsed and registered on load. The hardware context and the kernel are
+// created by prepare(), which runs once, at the latest on the first run or runlist.
+struct xrt_kernel_impl : public npu_kernel_impl{
+    xrt::device device;
+    xrt::xclbin xclbin;
+    xrt::hw_context context;
+    xrt::kernel kernel;
+    std::string kernel_name;
+    std::vector<npu_kernel_arg> signature;
+    std::vector<int> group_ids; // memory index of each argument, -1 when the xclbin has none
+    amdxdna_qos_info qos;
+    std::once_flag ready;
+
+    void prepare(){
+        std::call_once(ready, [this](){
+            LOG_VERBOSE(2, "Creating hardware context for " << kernel_name << ", QoS " << npu_qos_str(qos));
+            context = xrt::hw_context(device, xclbin.get_uuid(), npu_qos_map(qos));
+            kernel = xrt::kernel(context, kernel_name);
+        });
+    }
+
+    // Read from the xclbin connectivity, so instruction and data BOs need no context
+    int group_id(int arg_index){
+        if (arg_index < (int)group_ids.size() && group_ids[arg_index] >= 0){
+            return group_ids[arg_index];
+        }
+        prepare();
+        return kernel.group_id(arg_index);
+    }
+
+    std::string name(){
+        return kernel_name;
+    }
+
+    std::vector<npu_kernel_arg> args(){
+        return signature;
+    }
+
+    npu_run create_run(){
+        prepare();
+        return npu_run(std::make_shared<xrt_run_impl>(kernel));
+    }
+
+    npu_runlist create_runlist(){
+        prepare();
+        return npu_runlist(std::make_shared<xrt_runlist_impl>(context));
+    }
+};
+
+class xrt_device : public npu_device{
+private:
+    xrt::device device;
+    std::mutex register_lock;
+    std::set<std::string> registered; // uuids of the registered xclbins
+
+    int get_info(uint32_t param, void* buffer, size_t size){
+        int fd = open("/dev/accel/accel0", O_RDWR);
+        if (fd < 0) {
+            perror("Failed to open npu device");
+            return -1;
+        }
+        amdxdna_drm_get_info get_info = {
+            .param = param,
+            .buffer_size = (__u32)size,
+            .buffer = (unsigned long)buffer,
+        };
+        int ret = ioctl(fd, DRM_IOCTL_AMDXDNA_GET_INFO, &get_info);
+        if (ret < 0) {
+            std::cout << "Error code: " << ret << std::endl;
+            perror("Failed to get telemetry information");
+        }
+        close(fd);
+        return ret;
+    }
+
+public:
+    xrt_device(unsigned int device_id) : device(device_id) {}
+
+    npu_backend backend(){
+        return npu_backend_xrt;
+    }
+
+    npu_kernel load_xclbin(const std::string& xclbin_name, const amdxdna_qos_info& qos){
+        auto desc = std::make_shared<xrt_kernel_impl>();
+        desc->device = this->device;
+        desc->qos = qos;
+        desc->xclbin = xrt::xclbin(xclbin_name);
+        std::string Node = "MLIR_AIE";
+        auto xkernels = desc->xclbin.get_kernels();
+        auto xkernel = *std::find_if(
+            xkernels.begin(),
+            xkernels.end(),
+            [Node](xrt::xclbin::kernel &k) {
+                auto name = k.get_name();
+                return name.rfind(Node, 0) == 0;
+            }
+        );
+        {
+            // xclbins are parsed concurrently, registration with the device is serialized. An
+            // xclbin loaded again for another context, e.g. with other QoS, is registered once.
+            std::lock_guard<std::mutex> guard(this->register_lock);
+            if (this->registered.insert(desc->xclbin.get_uuid().to_string()).second){
+                this->device.register_xclbin(desc->xclbin);
+            }
+        }
+        desc->kernel_name = xkernel.get_name();
+        // Pointer arguments are BOs, the others scalars
+        std::vector<xrt::xclbin::arg> xargs = xkernel.get_args();
+        std::sort(xargs.begin(), xargs.end(), [](const xrt::xclbin::arg& a, const xrt::xclbin::arg& b){
+            return a.get_index() < b.get_index();
+        });
+        for (const xrt::xclbin::arg& arg : xargs){
+            bool pointer = arg.get_host_type().find('*') != std::string::npos;
+            desc->signature.push_back({arg.get_name(), pointer ? npu_arg_bo : npu_arg_scalar, pointer ? 0 : (size_t)arg.get_size()});
+            std::vector<xrt::xclbin::mem> mems = arg.get_mems();
+            desc->group_ids.push_back(pointer && !mems.empty() ? (int)mems.front().get_index() : -1);
+        }
+        return npu_kernel(desc);
+    }
+
+    npu_bo create_bo(size_t size, npu_bo_type type, int group_id){
+        xrtBufferFlags flags = (type == npu_bo_cacheable) ? XCL_BO_FLAGS_CACHEABLE : XRT_BO_FLAGS_HOST_ONLY;
+        return npu_bo(std::make_shared<xrt_bo_impl>(xrt::bo(this->device, size, flags, group_id)));
+    }
+
+    npu_bo create_sub_bo(npu_bo& parent, size_t size, size_t offset){
+        return npu_bo(std::make_shared<xrt_sub_bo_impl>(parent, size, offset));
+    }
+
+    npu_bo import_bo(void* ptr, size_t size, int group_id){
+        return npu_bo(std::make_shared<xrt_bo_impl>(xrt::bo(this->device, ptr, size, group_id)));
+    }
+
+    int query_clock_metadata(amdxdna_drm_query_clock_metadata& clock){
+        return get_info(DRM_AMDXDNA_QUERY_CLOCK_METADATA, &clock, sizeof(clock));
+    }
+
+    int query_aie_metadata(amdxdna_drm_query_aie_metadata& aie){
+        return get_info(DRM_AMDXDNA_QUERY_AIE_METADATA, &aie, sizeof(aie));
+    }
+
+    int query_sensor(amdxdna_drm_query_sensor& sensor){
+        return get_info(DRM_AMDXDNA_QUERY_SENSORS, &sensor, sizeof(sensor));
+    }
+
+    int query_firmware_version(amdxdna_drm_query_firmware_version& version){
+        return get_info(DRM_AMDXDNA_QUERY_FIRMWARE_VERSION, &version, sizeof(version));
+    }
+
+    int query_power_mode(amdxdna_drm_get_power_mode& mode){
+        return get_info(DRM_AMDXDNA_GET_POWER_MODE, &mode, sizeof(mode));
+    }
+
+    int read_aie_mem(uint32_t col, uint32_t row, uint32_t addr, uint32_t size, void* buf){
+        amdxdna_drm_aie_mem aie_mem = {
+            .col = col,
+            .row = row,
+            .addr = addr,
+            .size = size,
+            .buf_p = (__u64)buf,
+        };
+        return get_info(DRM_AMDXDNA_READ_AIE_MEM, &aie_mem, sizeof(aie_mem));
+    }
+};
+
+std::unique_ptr<npu_device> create_npu_xrt_device(unsigned int device_id){
+    return std::make_unique<xrt_device>(device_id);
+}
+
+#endif
@@ -9,7 +9,7 @@ npu_sequence::npu_sequence(std::vector<uint32_t>& npu_seq){
     this->parse_sequence();
 }
 
-npu_sequence::npu_sequence(xrt::bo& bo){
+npu_sequence::npu_sequence(npu_bo& bo){
     this->npu_seq = buffer<uint32_t>(bo);
 
     // Parse the npu sequence
@@ -34,6 +34,8 @@ npu_sequence::npu_sequence(){
     // Empty constructor
 }
 
+npu_sequence::~npu_sequence() = default;
+
 void npu_sequence::parse_sequence(){
     // Parse the npu sequence
     this->npu_major = (this->npu_seq[0] >> dev_major_shift) & dev_major_mask;
@@ -48,39 +50,39 @@ void npu_sequence::parse_sequence(){
     while (i < this->npu_seq.size()){
         if (this->npu_seq[i] == op_headers::dma_block_write){
             LOG_VERBOSE(1, "DMA block write");
-            npu_cmd* cmd = new npu_dma_block_cmd();
+            std::unique_ptr<npu_cmd> cmd = std::make_unique<npu_dma_block_cmd>();
             cmd->dump_cmd(this->npu_seq.data() + i);
-            this->cmds.push_back(cmd);
             i += cmd->get_op_lines();
+            this->cmds.push_back(std::move(cmd));
             LOG_VERBOSE(1, "DMA block write" << i);
         }
         else if (this->npu_seq[i] == op_headers::dma_ddr_patch_write){
             LOG_VERBOSE(1, "DMA DDR patch write");
-            npu_cmd* cmd = new npu_ddr_cmd();
+            std::unique_ptr<npu_cmd> cmd = std::make_unique<npu_ddr_cmd>();
             cmd->dump_cmd(&(this->npu_seq[i]));
-            this->cmds.push_back(cmd);
             i += cmd->get_op_lines();
+            this->cmds.push_back(std::move(cmd));
         }
         else if (this->npu_seq[i] == op_headers::dma_issue_token_write){
             LOG_VERBOSE(1, "DMA issue token write");
-            npu_cmd* cmd = new npu_issue_token_cmd();
+            std::unique_ptr<npu_cmd> cmd = std::make_unique<npu_issue_token_cmd>();
             cmd->dump_cmd(&(this->npu_seq[i]));
-            this->cmds.push_back(cmd);
             i += cmd->get_op_lines();
+            this->cmds.push_back(std::move(cmd));
         }
         else if (this->npu_seq[i] == op_headers::queue_write){
             LOG_VERBOSE(1, "Queue write");
-            npu_cmd* cmd = new npu_write_cmd();
+            std::unique_ptr<npu_cmd> cmd = std::make_unique<npu_write_cmd>();
             cmd->dump_cmd(&(this->npu_seq[i]));
-            this->cmds.push_back(cmd);
             i += cmd->get_op_lines();
+            this->cmds.push_back(std::move(cmd));
         }
         else if (this->npu_seq[i] == op_headers::dma_sync_write){ // Wait sync, AIETargetNPU.cpp line 62
             LOG_VERBOSE(1, "DMA sync write");
-            npu_cmd* cmd = new npu_wait_cmd();
+            std::unique_ptr<npu_cmd> cmd = std::make_unique<npu_wait_cmd>();
             cmd->dump_cmd(&(this->npu_seq[i]));
-            this->cmds.push_back(cmd);
             i += cmd->get_op_lines();
+            this->cmds.push_back(std::move(cmd));
         }
         else{
             i++;
@@ -140,3 +142,35 @@ void npu_sequence::to_npu(){
         }
     }
 }
+
+npu_ddr_traffic npu_sequence::get_ddr_traffic(){
+    npu_ddr_traffic traffic = {0, 0, 0};
+    // The latest BD written to each (col, bd_id) of the shim tiles
+    std::map<uint32_t, npu_dma_block_cmd*> shim_bds;
+    for (int i = 0; i < this->cmds.size(); i++){
+        if (this->cmds[i]->get_type() == npu_dma_block){
+            npu_dma_block_cmd* bd = static_cast<npu_dma_block_cmd*>(this->cmds[i].get());
+            if (bd->row == 0){
+                shim_bds[(bd->col << 8) | bd->bd_id] = bd;
+            }
+        }
+        else if (this->cmds[i]->get_type() == npu_queue){
+            npu_write_cmd* push = static_cast<npu_write_cmd*>(this->cmds[i].get());
+            auto it = shim_bds.find((push->col << 8) | push->bd_id);
+            if (it == shim_bds.end()){
+                LOG_VERBOSE(1, "Task pushed to col " << push->col << " with unknown BD " << push->bd_id);
+                continue;
+            }
+            // buffer length is in 32-bit words, repeat count is the number of extra iterations
+            size_t bytes = (size_t)it->second->buffer_length * 4 * (push->repeat_count + 1);
+            if (push->channel_direction){
+                traffic.read_bytes += bytes;
+            }
+            else{
+                traffic.write_bytes += bytes;
+            }
+            traffic.tasks++;
+        }
+    }
+    return traffic;
+}
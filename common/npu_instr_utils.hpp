@@ -8,10 +8,13 @@
 #include <chrono>
 #include <cstdint>
 #include <cstdlib>
+#include <map>
+#include <memory>
+#include <vector>
 #include <stdio.h>
 #include "buffer.hpp"
 #include "debug_utils.hpp"
-#include "xrt/xrt_bo.h"
+#include "npu_device.hpp"
 #include "instr_utils/npu_cmd.hpp"
 #include "instr_utils/npu_cmd_write.hpp"
 #include "instr_utils/npu_cmd_ddr.hpp"
@@ -27,20 +30,32 @@
 
 // found in AIETargetNPU.cpp
 
+// DDR traffic described by a sequence, decoded from the BDs pushed to shim DMA queues.
+typedef struct{
+    size_t read_bytes;  // MM2S, DDR to array
+    size_t write_bytes; // S2MM, array to DDR
+    uint32_t tasks;     // BD tasks pushed to shim DMA queues
+} npu_ddr_traffic;
 
 class npu_sequence{
     public:
         npu_sequence(); // for construct from empty
         npu_sequence(std::vector<uint32_t>& npu_seq); // for construct from vector
-        npu_sequence(xrt::bo& bo); // for construct from bo
+        npu_sequence(npu_bo& bo); // for construct from bo
         npu_sequence(std::string filename); // for construct from file
+        ~npu_sequence();
+        // The sequence owns its commands and may alias a BO, it is neither copied nor moved
+        npu_sequence(const npu_sequence&) = delete;
+        npu_sequence& operator=(const npu_sequence&) = delete;
         void parse_sequence(); // parse the sequence
         // void add_instr(uint32_t instr); // add instruction to the sequence
         void print_sequence(); // print the sequence
         void to_npu();
+        const std::vector<std::unique_ptr<npu_cmd>>& get_cmds() const { return this->cmds; }
+        npu_ddr_traffic get_ddr_traffic(); // bytes moved between DDR and the array by one run
     private:
         buffer<uint32_t> npu_seq;
-        std::vector<npu_cmd*> cmds;
+        std::vector<std::unique_ptr<npu_cmd>> cmds;
         uint32_t npu_rows;
         uint32_t npu_cols;
         uint32_t npu_dev_gen;
@@ -0,0 +1,196 @@
+#ifndef __NPU_LAUNCH_HPP__
+#define __NPU_LAUNCH_HPP__
+
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "npu_device.hpp"
+#include "buffer.hpp"
+
+// Variadic kernel launches.
+// An npu_launch is a run together with the layout of what is bound to it. The first three
+// slots of an MLIR_AIE kernel are the opcode, the instruction BO and its size; bind() takes
+// the arguments after them, any mix of npu_bo, buffer<T> and scalars (arithmetic or enum,
+// at most 8 bytes). Argument kinds are checked at compile time, their count, kinds and sizes
+// against the kernel signature read at registration: scalars must have the size of their
+// slot, and a launch starts only once every argument of the design is bound. MLIR_AIE kernels
+// have more BO slots than most designs use, so the design declares its argument count.
+// Rebinding compares every slot with what is bound and only calls set_arg on the slots that
+// changed, so repeat launches with the same BOs do not touch the run at all. The launch only
+// watches its BOs: a BO released since counts as changed.
+
+namespace npu_launch_args {
+
+template<typename T>
+struct is_bo : std::is_same<std::decay_t<T>, npu_bo> {};
+
+template<typename T>
+struct is_buffer : std::is_base_of<bytes, std::decay_t<T>> {};
+
+template<typename T>
+struct is_scalar : std::bool_constant<(std::is_arithmetic_v<std::decay_t<T>> || std::is_enum_v<std::decay_t<T>>)
+    && sizeof(std::decay_t<T>) <= 8> {};
+
+template<typename T>
+struct is_arg : std::bool_constant<is_bo<T>::value || is_buffer<T>::value || is_scalar<T>::value> {};
+
+}
+
+// Slots of the opcode, the instruction BO and its size
+const int npu_instr_arg_count = 3;
+
+class npu_launch{
+private:
+    typedef struct {
+        npu_arg_kind kind;
+        bool set;
+        std::weak_ptr<npu_bo_impl> bo; // a live BO can not share its address with a new one
+        uint64_t value;  // scalar bytes
+        size_t bytes;
+    } bound_slot;
+
+    npu_run run_;
+    std::string kernel_name_;
+    std::vector<npu_kernel_arg> signature_; // empty when the backend does not report one
+    std::vector<bound_slot> slots_;
+    size_t arity_;  // slots bound by a launch, instructions included, 0 when unchecked
+    size_t unset_;  // slots below arity_ not bound yet
+    uint64_t set_args_;
+
+    void check_slot(int index, npu_arg_kind kind, size_t bytes){
+        if (signature_.empty()){
+            return;
+        }
+        if (index >= (int)arity_){
+            throw std::runtime_error("Kernel " + kernel_name_ + " takes " + std::to_string(arity_ - npu_instr_arg_count)
+                + " arguments after the instructions, got more");
+        }
+        const npu_kernel_arg& arg = signature_[index];
+        if (arg.kind != kind){
+            throw std::runtime_error("Argument " + std::to_string(index) + " (" + arg.name + ") of kernel " + kernel_name_
+                + " is a " + npu_arg_kind_name(arg.kind) + ", got a " + npu_arg_kind_name(kind));
+        }
+        // a smaller value would leave the upper bytes of the slot as they were
+        if (kind == npu_arg_scalar && bytes != arg.size){
+            throw std::runtime_error("Argument " + std::to_string(index) + " (" + arg.name + ") of kernel " + kernel_name_
+                + " has " + std::to_string(arg.size) + " bytes, got " + std::to_string(bytes));
+        }
+    }
+
+    bound_slot& slot(int index){
+        if (index >= (int)slots_.size()){
+            slots_.resize(index + 1, bound_slot{npu_arg_bo, false, {}, 0, 0});
+        }
+        return slots_[index];
+    }
+
+    void bind_bo(int index, npu_bo& bo){
+        check_slot(index, npu_arg_bo, 0);
+        if (!bo){
+            throw std::runtime_error("Argument " + std::to_string(index) + " of kernel " + kernel_name_ + " is an empty BO");
+        }
+        bound_slot& s = slot(index);
+        if (s.set && s.kind == npu_arg_bo && s.bo.lock().get() == bo.get()){
+            return;
+        }
+        run_.set_arg(index, bo);
+        if (!s.set && unset_ > 0){
+            unset_--;
+        }
+        s = {npu_arg_bo, true, bo.weak(), 0, 0};
+        set_args_++;
+    }
+
+    void bind_scalar(int index, const void* value, size_t bytes){
+        check_slot(index, npu_arg_scalar, bytes);
+        uint64_t v = 0;
+        std::memcpy(&v, value, bytes);
+        bound_slot& s = slot(index);
+        if (s.set && s.kind == npu_arg_scalar && s.bytes == bytes && s.value == v){
+            return;
+        }
+        run_.set_arg(index, value, bytes);
+        if (!s.set && unset_ > 0){
+            unset_--;
+        }
+        s = {npu_arg_scalar, true, {}, v, bytes};
+        set_args_++;
+    }
+
+    template<typename T>
+    void bind_one(int index, T&& arg){
+        static_assert(npu_launch_args::is_arg<T>::value, "Kernel arguments are npu_bo, buffer<T> or scalars of at most 8 bytes");
+        if constexpr (npu_launch_args::is_bo<T>::value){
+            npu_bo bo = arg;
+            bind_bo(index, bo);
+        }
+        else if constexpr (npu_launch_args::is_buffer<T>::value){
+            bind_bo(index, arg.bo());
+        }
+        else{
+            std::decay_t<T> value = arg;
+            bind_scalar(index, &value, sizeof(value));
+        }
+    }
+
+public:
+    npu_launch() : arity_(0), unset_(0), set_args_(0) {}
+    // arg_count is the number of arguments of the design after the instruction slots, -1 for
+    // every slot of the signature
+    npu_launch(npu_run run, const std::string& kernel_name, const std::vector<npu_kernel_arg>& signature, int arg_count = -1)
+        : run_(run), kernel_name_(kernel_name), signature_(signature), set_args_(0){
+        arity_ = signature_.empty() ? 0 : arg_count < 0 ? signature_.size() : npu_instr_arg_count + arg_count;
+        if (arity_ > signature_.size()){
+            throw std::runtime_error("Kernel " + kernel_name_ + " takes " + std::to_string(signature_.size() - npu_instr_arg_count)
+                + " arguments after the instructions, the design declares " + std::to_string(arg_count));
+        }
+        unset_ = arity_;
+    }
+
+    // opcode, instruction BO and its size in words
+    void bind_instr(npu_bo& instr, size_t instr_size){
+        const uint64_t opcode = 3;
+        uint32_t words = instr_size;
+        bind_scalar(0, &opcode, sizeof(opcode));
+        bind_bo(1, instr);
+        bind_scalar(2, &words, sizeof(words));
+    }
+
+    // Binds args to the slots after the instructions, untouched slots keep their binding
+    template<typename... Args>
+    npu_launch& bind(Args&&... args){
+        int index = npu_instr_arg_count;
+        (bind_one(index++, std::forward<Args>(args)), ...);
+        return *this;
+    }
+
+    // Throws when an argument of the design is not bound
+    void check_complete() const {
+        if (unset_ == 0){
+            return;
+        }
+        for (size_t i = 0; i < arity_; i++){
+            if (i >= slots_.size() || !slots_[i].set){
+                throw std::runtime_error("Argument " + std::to_string(i) + " (" + signature_[i].name + ") of kernel " + kernel_name_
+                    + " is not bound, the design takes " + std::to_string(arity_ - npu_instr_arg_count) + " arguments after the instructions");
+            }
+        }
+    }
+
+    void start(){
+        check_complete();
+        run_.start();
+    }
+    ert_cmd_state wait(unsigned int timeout_ms = 0) { return run_.wait(timeout_ms); }
+
+    npu_run& get_run() { return run_; }
+    explicit operator bool() const { return (bool)run_; }
+    // set_arg calls so far, instruction slots included
+    uint64_t set_args() const { return set_args_; }
+};
+
+#endif
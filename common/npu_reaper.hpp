@@ -0,0 +1,117 @@
+#ifndef __NPU_REAPER_HPP__
+#define __NPU_REAPER_HPP__
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "npu_device.hpp"
+
+// Completion reaper for asynchronous runs.
+// Started runs are handed to one background thread, which waits for them and fulfils their
+// futures, so any number of runs can be in flight without a blocked thread per run. The
+// oldest run is waited on with a short timeout, and the other runs are checked in between,
+// so runs of different contexts that finish out of order are not held back.
+// Callbacks run on the reaper thread and complete before the future becomes ready.
+
+typedef std::function<void(ert_cmd_state)> npu_callback;
+typedef std::shared_future<ert_cmd_state> npu_future;
+
+class npu_reaper{
+private:
+    typedef struct {
+        npu_run run;
+        std::promise<ert_cmd_state> promise;
+        npu_callback callback;
+    } pending_run;
+
+    const unsigned int poll_ms = 1;
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<pending_run> submitted;
+    bool stop;
+    std::thread worker;
+
+    static bool is_done(ert_cmd_state state){
+        return state == ERT_CMD_STATE_COMPLETED || state == ERT_CMD_STATE_ERROR
+            || state == ERT_CMD_STATE_ABORT || state == ERT_CMD_STATE_NORESPONSE;
+    }
+
+    static void complete(pending_run& p, ert_cmd_state state){
+        try {
+            if (p.callback){
+                p.callback(state);
+            }
+            p.promise.set_value(state);
+        } catch (...) {
+            p.promise.set_exception(std::current_exception());
+        }
+    }
+
+    void reap(){
+        // Only the worker touches in_flight
+        std::deque<pending_run> in_flight;
+        while (true){
+            {
+                std::unique_lock<std::mutex> guard(lock);
+                if (in_flight.empty()){
+                    cv.wait(guard, [this](){ return stop || !submitted.empty(); });
+                }
+                while (!submitted.empty()){
+                    in_flight.push_back(std::move(submitted.front()));
+                    submitted.pop_front();
+                }
+                if (stop && in_flight.empty()){
+                    return;
+                }
+            }
+            ert_cmd_state state = in_flight.front().run.wait(poll_ms);
+            if (is_done(state)){
+                complete(in_flight.front(), state);
+                in_flight.pop_front();
+            }
+            for (auto it = in_flight.begin(); it != in_flight.end();){
+                ert_cmd_state s = it->run.state();
+                if (is_done(s)){
+                    complete(*it, s);
+                    it = in_flight.erase(it);
+                }
+                else{
+                    ++it;
+                }
+            }
+        }
+    }
+
+public:
+    npu_reaper() : stop(false){
+        worker = std::thread([this](){ reap(); });
+    }
+
+    // Waits for every submitted run before returning
+    ~npu_reaper(){
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    // Starts the run and returns a future of its final state
+    npu_future submit(npu_run run, npu_callback callback = nullptr){
+        pending_run p = {run, std::promise<ert_cmd_state>(), std::move(callback)};
+        npu_future future = p.promise.get_future().share();
+        run.start();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            submitted.push_back(std::move(p));
+        }
+        cv.notify_one();
+        return future;
+    }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef __NPU_USERPTR_CACHE_HPP__
+#define __NPU_USERPTR_CACHE_HPP__
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "npu_device.hpp"
+
+// Registration cache of user pointer BOs.
+// import() wraps page aligned host memory as a BO without copying it. Importing a range is
+// not free: the driver pins every page. So importing a range that is already imported, or a
+// range inside it, returns the imported BO or a sub-BO of it instead of pinning again.
+// The cache does not own the BOs: an entry lives as long as a BO or sub-BO handed out for it,
+// and the pages are unpinned when the last of them is released. Once the caller drops its
+// BOs the memory may be freed, and a later allocation at the same address is imported anew.
+
+typedef struct {
+    uint64_t requests;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t releases;       // entries whose BOs were all released
+    uint64_t entries;
+    size_t registered_bytes; // bytes pinned by live entries
+} npu_userptr_stats;
+
+class npu_userptr_cache{
+private:
+    typedef struct {
+        uintptr_t begin;
+        size_t size;
+        int group_id;
+        std::weak_ptr<npu_bo_impl> bo;
+    } entry;
+
+    npu_device* device;
+    std::mutex lock;
+    std::vector<entry> entries;
+    npu_userptr_stats stats_;
+
+    // Drops the entries whose BOs were all released, under the lock
+    void prune(){
+        for (size_t i = entries.size(); i-- > 0;){
+            if (entries[i].bo.expired()){
+                stats_.registered_bytes -= entries[i].size;
+                stats_.releases++;
+                entries.erase(entries.begin() + i);
+            }
+        }
+        stats_.entries = entries.size();
+    }
+
+public:
+    static constexpr size_t page_size = 4096;
+
+    npu_userptr_cache(npu_device& device) : device(&device), stats_() {}
+
+    npu_userptr_cache(const npu_userptr_cache&) = delete;
+    npu_userptr_cache& operator=(const npu_userptr_cache&) = delete;
+
+    npu_bo import(void* ptr, size_t size, int group_id){
+        uintptr_t begin = reinterpret_cast<uintptr_t>(ptr);
+        if (begin % page_size != 0){
+            throw std::runtime_error("User pointer BOs must start on a page boundary");
+        }
+        if (size == 0){
+            throw std::runtime_error("User pointer BOs cannot be empty");
+        }
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stats_.requests++;
+            prune();
+            for (const entry& e : entries){
+                if (e.group_id != group_id || begin < e.begin || begin + size > e.begin + e.size){
+                    continue;
+                }
+                std::shared_ptr<npu_bo_impl> impl = e.bo.lock();
+                if (!impl){
+                    continue;
+                }
+                stats_.hits++;
+                npu_bo bo(std::move(impl));
+                if (begin == e.begin && size == e.size){
+                    return bo;
+                }
+                // the sub-BO holds its parent, so it keeps the entry alive as well
+                return device->create_sub_bo(bo, size, begin - e.begin);
+            }
+            stats_.misses++;
+        }
+        // Pin outside the lock, it takes time proportional to the range
+        npu_bo bo = device->import_bo(ptr, size, group_id);
+        std::lock_guard<std::mutex> guard(lock);
+        entries.push_back({begin, size, group_id, bo.weak()});
+        stats_.entries = entries.size();
+        stats_.registered_bytes += size;
+        return bo;
+    }
+
+    npu_userptr_stats stats(){
+        std::lock_guard<std::mutex> guard(lock);
+        prune();
+        return stats_;
+    }
+};
+
+#endif
@@ -3,147 +3,269 @@
 
 // global device, used by all npu_app instances, only one instance is allowed
 
-npu_app::npu_app(int max_xclbins, int max_instrs, unsigned int device_id){
-    this->device = xrt::device(device_id);
-    this->kernel_descs.resize(max_xclbins);
-    this->hw_descs.resize(max_instrs);
-    this->registered_xclbin_names.clear();
-    this->kernel_desc_count = 0;
-    this->hw_desc_count = 0;
-}
-
-int npu_app::register_accel_app(accel_user_desc& user_desc){
-    int xclbin_id = -1;
-    for (int i = 0; i < this->registered_xclbin_names.size(); i++){
-        if (this->registered_xclbin_names[i] == user_desc.xclbin_name){
-            xclbin_id = i;
-            break;
+npu_app::npu_app(int max_xclbins, int max_instrs, unsigned int device_id, npu_backend backend)
+    : npu_app(create_npu_device(backend, device_id), max_xclbins, max_instrs){
+}
+
+npu_app::npu_app(std::unique_ptr<npu_device> device, int max_xclbins, int max_instrs){
+    this->device = std::make_unique<npu_tracked_device>(std::move(device), this->bo_registry);
+    this->bo_pool = std::make_unique<npu_bo_pool>(*this->device);
+    this->userptr_cache = std::make_unique<npu_userptr_cache>(*this->device);
+    LOG_VERBOSE(1, "Using " << npu_backend_name(this->device->backend()) << " backend");
+    this->xclbin_ids.reserve(max_xclbins);
+    this->app_ids.reserve(max_instrs);
+    this->instr_stats = {};
+    this->startup_config = default_accel_startup_config;
+    this->startup = {};
+}
+
+static double elapsed_us(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+int npu_app::register_accel_app(const accel_user_desc& user_desc){
+    auto start = std::chrono::steady_clock::now();
+    int app_id = _register_accel_app(user_desc);
+    this->startup.wall_time += elapsed_us(start);
+    return app_id;
+}
+
+static std::string xclbin_key(const std::string& xclbin_name, const amdxdna_qos_info& qos, const std::string& context_tag){
+    return xclbin_name + '\n' + npu_qos_str(qos) + '\n' + context_tag;
+}
+
+std::vector<int> npu_app::register_accel_apps(const std::vector<accel_user_desc>& user_descs){
+    auto start = std::chrono::steady_clock::now();
+    // new xclbin, QoS and context tag combinations, in order of first use
+    std::vector<std::string> keys;
+    std::vector<const accel_user_desc*> names;
+    for (const accel_user_desc& desc : user_descs){
+        std::string key = xclbin_key(desc.xclbin_name, desc.qos, desc.context_tag);
+        if (this->xclbin_ids.count(key) == 0 && std::find(keys.begin(), keys.end(), key) == keys.end()){
+            keys.push_back(key);
+            names.push_back(&desc);
         }
     }
-    LOG_VERBOSE_IF_ELSE(2, xclbin_id > -1, 
-        "Found xclbin: " << user_desc.xclbin_name << "registered as id " << xclbin_id << "!",
-        "Xclbin: " << user_desc.xclbin_name << " not registered yet!"
-    );
-
-    if (xclbin_id == -1){ // the xclbin is not registered yet
-        if (this->kernel_desc_count >= this->kernel_descs.size()){
-            throw std::runtime_error("Max number of xclbins reached");
+    // loading waits on the file system and the driver, so the default does not follow the core count
+    size_t threads = this->startup_config.threads > 0 ? this->startup_config.threads : 8;
+    threads = std::max<size_t>(1, std::min(threads, names.size()));
+    std::vector<accel_kernel_desc> loaded(names.size());
+    std::vector<std::exception_ptr> errors(names.size());
+    std::atomic<size_t> next(0);
+    auto work = [&](){
+        for (size_t i = next++; i < names.size(); i = next++){
+            try{
+                loaded[i] = _prepare_xclbin(*names[i]);
+            }
+            catch (...){
+                errors[i] = std::current_exception();
+            }
         }
-        if (_load_xclbin(user_desc.xclbin_name) != 0){
-            std::cout<< "Load " << user_desc.xclbin_name << "ERROR!" << std::endl;
-            exit(-1);
-        }
-        this->registered_xclbin_names.push_back(user_desc.xclbin_name);
-        xclbin_id = this->registered_xclbin_names.size() - 1;
-        LOG_VERBOSE(2, "Xclbin: " << user_desc.xclbin_name << " registered as id " << xclbin_id << "!");
-        this->kernel_desc_count++;
+    };
+    std::vector<std::thread> workers;
+    for (size_t t = 1; t < threads; t++){
+        workers.emplace_back(work);
     }
-    // register the instr
-    int app_id = -1;
-    for (int i = 0; i < this->hw_descs.size(); i++){
-        if (this->hw_descs[i].instr_name == user_desc.instr_name){
-            app_id = i;
-            break;
-        }
+    work();
+    for (std::thread& w : workers){
+        w.join();
     }
-    LOG_VERBOSE_IF_ELSE(2, app_id > -1, 
-        "Found instruction: " << user_desc.instr_name << "registered as id " << app_id << "!",
-        "Instruction: " << user_desc.instr_name << " not registered yet!"
-    );
-    if (app_id == -1){ // instr is not registered yet
-        if (this->hw_desc_count >= this->hw_descs.size()){
-            throw std::runtime_error("Max number of instructions reached");
+    // the xclbins that loaded are kept, so registering again only retries the failed ones
+    std::exception_ptr first_error;
+    for (size_t i = 0; i < names.size(); i++){
+        if (errors[i]){
+            first_error = first_error ? first_error : errors[i];
+            continue;
         }
-        this->hw_descs[this->hw_desc_count].kernel_desc = &(this->kernel_descs[xclbin_id]);
-        _load_instr_sequence(user_desc, this->hw_descs[this->hw_desc_count]);
-        app_id = this->hw_desc_count;
-        LOG_VERBOSE(2, "Instruction: " << user_desc.instr_name << " registered as id " << app_id << "!");
-        this->hw_desc_count++;
+        _add_xclbin(loaded[i]);
+    }
+    this->startup.threads = threads;
+    if (first_error){
+        std::rethrow_exception(first_error);
+    }
+    LOG_VERBOSE(2, "Loaded " << names.size() << " xclbins on " << threads << " threads");
+    // instruction BOs share the cache, so they are loaded in order
+    std::vector<int> app_ids;
+    for (const accel_user_desc& desc : user_descs){
+        app_ids.push_back(_register_accel_app(desc));
+    }
+    this->startup.wall_time += elapsed_us(start);
+    return app_ids;
+}
+
+int npu_app::_register_accel_app(const accel_user_desc& user_desc){
+    std::string key = xclbin_key(user_desc.xclbin_name, user_desc.qos, user_desc.context_tag) + '\n' + user_desc.instr_name;
+    auto found = this->app_ids.find(key);
+    if (found != this->app_ids.end()){
+        LOG_VERBOSE(2, "Found instruction: " << user_desc.instr_name << " registered as id " << found->second << "!");
+        return found->second;
+    }
+    LOG_VERBOSE(2, "Instruction: " << user_desc.instr_name << " not registered yet!");
+
+    accel_registration reg = {};
+    reg.xclbin_name = user_desc.xclbin_name;
+    reg.instr_name = user_desc.instr_name;
+    auto start = std::chrono::steady_clock::now();
+    int xclbin_id = _load_xclbin(user_desc);
+    accel_kernel_desc& kernel_desc = this->kernel_descs[xclbin_id];
+    // the first app of an xclbin reports its load, also when register_accel_apps loaded it ahead
+    reg.xclbin_cached = kernel_desc.apps++ > 0;
+    reg.xclbin_time = reg.xclbin_cached ? elapsed_us(start) : kernel_desc.load_time;
+    reg.context_time = reg.xclbin_cached ? 0.0 : kernel_desc.context_time;
+    reg.context_deferred = kernel_desc.deferred;
+
+    auto instr_start = std::chrono::steady_clock::now();
+    accel_hw_desc hw_desc = {};
+    hw_desc.kernel_desc = &kernel_desc;
+    _load_instr_sequence(user_desc, hw_desc, reg);
+    reg.instr_time = elapsed_us(instr_start);
+    this->startup.instr_time += reg.instr_time;
+    // The signature is read once; launches check their arguments against it
+    hw_desc.args = hw_desc.kernel_desc->kernel.args();
+    if (!hw_desc.args.empty() && (hw_desc.args.size() < npu_instr_arg_count || hw_desc.args[0].kind != npu_arg_scalar
+        || hw_desc.args[1].kind != npu_arg_bo || hw_desc.args[2].kind != npu_arg_scalar)){
+        throw std::runtime_error("Kernel " + hw_desc.kernel_desc->kernel.name() + " does not take an opcode, instruction BO and size first");
     }
+    if (!hw_desc.args.empty() && user_desc.arg_count > (int)hw_desc.args.size() - npu_instr_arg_count){
+        throw std::runtime_error("Kernel " + hw_desc.kernel_desc->kernel.name() + " takes " + std::to_string(hw_desc.args.size() - npu_instr_arg_count)
+            + " arguments after the instructions, " + user_desc.instr_name + " declares " + std::to_string(user_desc.arg_count));
+    }
+    hw_desc.arg_count = user_desc.arg_count;
+    LOG_VERBOSE(2, "Kernel " << hw_desc.kernel_desc->kernel.name() << " takes " << hw_desc.args.size() << " arguments");
+
+    int app_id = this->hw_descs.size();
+    this->hw_descs.push_back(std::move(hw_desc));
+    this->app_ids[key] = app_id;
+    reg.app_id = app_id;
+    reg.total_time = reg.xclbin_time + reg.context_time + elapsed_us(instr_start);
+    this->registrations.push_back(reg);
+    LOG_VERBOSE(2, "Instruction: " << user_desc.instr_name << " registered as id " << app_id << "!");
     return app_id;
 }
 
+// FNV-1a over 32 bit words
+static uint64_t hash_instr(const uint32_t* words, size_t count){
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < count; i++){
+        hash = (hash ^ words[i]) * 1099511628211ULL;
+    }
+    return (hash ^ count) * 1099511628211ULL;
+}
+
+npu_bo npu_app::_find_instr_bo(const uint32_t* words, size_t count, uint64_t hash, int group_id){
+    size_t bytes = count * sizeof(uint32_t);
+    this->instr_stats.lookups++;
+    auto bucket = this->instr_bos.find(hash);
+    if (bucket == this->instr_bos.end()){
+        return npu_bo();
+    }
+    for (std::pair<int, npu_bo>& entry : bucket->second){
+        // the hash only narrows the search, the content decides
+        if (entry.first == group_id && entry.second.size() == bytes && memcmp(entry.second.map<void*>(), words, bytes) == 0){
+            this->instr_stats.hits++;
+            this->instr_stats.saved_bytes += bytes;
+            return entry.second;
+        }
+    }
+    return npu_bo();
+}
 
-int npu_app::_load_instr_sequence(accel_user_desc& user_desc, accel_hw_desc& hw_desc){
+void npu_app::_load_instr_sequence(const accel_user_desc& user_desc, accel_hw_desc& hw_desc, accel_registration& reg){
     LOG_VERBOSE(2, "Loading instruction sequence: " << user_desc.instr_name);
-    std::ifstream instr_file(user_desc.instr_name, std::ios::binary);
+    instr_file file(user_desc.instr_name, user_desc.format);
     hw_desc.instr_name = user_desc.instr_name;
-#define INSTR_IN_BIN 1
-#if INSTR_IN_BIN
-    instr_file.seekg(0, std::ios::end);
-    size_t instr_size = instr_file.tellg();
-    instr_file.seekg(0, std::ios::beg);
-
-    if (instr_size % 4 != 0){
-        throw std::runtime_error("Instr file is invalied!");
+    int group_id = hw_desc.kernel_desc->kernel.group_id(1);
+    size_t count = file.words();
+    size_t bytes = count * sizeof(uint32_t);
+    npu_bo bo;
+    uint64_t hash = 0;
+    if (file.format() == instr_format_binary){
+        // binary words are hashed in the mapping and copied once, on a miss
+        hash = hash_instr(file.binary_words(), count);
+        bo = _find_instr_bo(file.binary_words(), count, hash, group_id);
+    }
+    reg.instr_cached = (bool)bo;
+    if (!bo){
+        bo = this->device->create_bo(bytes, npu_bo_cacheable, group_id);
+        uint32_t* words = bo.map<uint32_t*>();
+        file.read(words, count);
+        if (file.format() == instr_format_text){
+            // text is parsed into the BO, which is dropped again if the cache holds the same words
+            hash = hash_instr(words, count);
+            npu_bo cached = _find_instr_bo(words, count, hash, group_id);
+            if (cached){
+                bo = cached;
+                reg.instr_cached = true;
+            }
+        }
+        if (!reg.instr_cached){
+            bo.sync(npu_sync_to_device);
+            this->instr_bos[hash].push_back({group_id, bo});
+            this->instr_stats.bytes += bytes;
+        }
     }
+    hw_desc.bo_instr = bo;
+    hw_desc.instr_size = count;
+    reg.format = file.format();
+    reg.instr_bytes = file.file_size();
+    LOG_VERBOSE(2, "Instruction sequence (" << instr_format_name(file.format()) << ", " << count << " words) "
+        << (reg.instr_cached ? "shared with an earlier app" : "loaded successfully") << "!");
+}
+
 
-    std::vector<uint32_t> instr_v(instr_size / 4);
-    if (!instr_file.read(reinterpret_cast<char *>(instr_v.data()), instr_size)) {
-            throw std::runtime_error("Failed to read instruction file\n");
+int npu_app::_load_xclbin(const accel_user_desc& user_desc){
+    auto found = this->xclbin_ids.find(xclbin_key(user_desc.xclbin_name, user_desc.qos, user_desc.context_tag));
+    if (found != this->xclbin_ids.end()){
+        LOG_VERBOSE(2, "Found xclbin: " << user_desc.xclbin_name << " registered as id " << found->second << "!");
+        return found->second;
     }
-#else
-    std::string line;
-    std::vector<uint32_t> instr_v;
-    while (std::getline(instr_file, line)) {
-        std::istringstream iss(line);
-        uint32_t a;
-        if (!(iss >> std::hex >> a)) {
-            throw std::runtime_error("Unable to parse instruction file\n");
-        }
-        instr_v.push_back(a);
+    return _add_xclbin(_prepare_xclbin(user_desc));
+}
+
+accel_kernel_desc npu_app::_prepare_xclbin(const accel_user_desc& user_desc){
+    LOG_VERBOSE(2, "Loading xclbin: " << user_desc.xclbin_name << ", QoS " << npu_qos_str(user_desc.qos));
+    accel_kernel_desc kernel_desc = {};
+    kernel_desc.xclbin_name = user_desc.xclbin_name;
+    kernel_desc.qos = user_desc.qos;
+    kernel_desc.context_tag = user_desc.context_tag;
+    auto start = std::chrono::steady_clock::now();
+    kernel_desc.kernel = this->device->load_xclbin(user_desc.xclbin_name, user_desc.qos);
+    kernel_desc.load_time = elapsed_us(start);
+    kernel_desc.deferred = this->startup_config.defer_contexts;
+    if (!kernel_desc.deferred){
+        auto context_start = std::chrono::steady_clock::now();
+        kernel_desc.kernel.prepare();
+        kernel_desc.context_time = elapsed_us(context_start);
     }
-#endif
-    hw_desc.bo_instr = xrt::bo(this->device, instr_v.size() * sizeof(int), XCL_BO_FLAGS_CACHEABLE, hw_desc.kernel_desc->kernel.group_id(1));
-    void *bufInstr = hw_desc.bo_instr.map<void *>();
-    memcpy(bufInstr, instr_v.data(), instr_v.size() * sizeof(int));
-    hw_desc.bo_instr.sync(XCL_BO_SYNC_BO_TO_DEVICE);
-    hw_desc.instr_size = instr_v.size();
-    LOG_VERBOSE(2, "Instruction sequence loaded successfully!");
-    return 0;
-}
-
-
-int npu_app::_load_xclbin(std::string xclbin_name){
-    LOG_VERBOSE(2, "Loading xclbin: " << xclbin_name);
-    this->kernel_descs[this->kernel_desc_count].xclbin = xrt::xclbin(xclbin_name);
-    // int verbosity = VERBOSE;
-    std::string Node = "MLIR_AIE";
-    auto xkernels = this->kernel_descs[this->kernel_desc_count].xclbin.get_kernels();
-    auto xkernel = *std::find_if(
-        xkernels.begin(), 
-        xkernels.end(),
-        [Node](xrt::xclbin::kernel &k) {
-            auto name = k.get_name();
-            return name.rfind(Node, 0) == 0;
-        }
-    );
-    this->device.register_xclbin(this->kernel_descs[this->kernel_desc_count].xclbin);
-    auto kernelName = xkernel.get_name();
-    std::map<std::string, uint32_t> qos_map = {
-        {"gops", 100000},
-        {"dma_bandwidth", 180},
-        {"priority", AMDXDNA_QOS_HIGH_PRIORITY}
-    };
-    this->kernel_descs[this->kernel_desc_count].context = xrt::hw_context(this->device, this->kernel_descs[this->kernel_desc_count].xclbin.get_uuid(), qos_map);
-    this->kernel_descs[this->kernel_desc_count].context;
-    this->kernel_descs[this->kernel_desc_count].kernel = xrt::kernel(this->kernel_descs[this->kernel_desc_count].context, kernelName);
-    LOG_VERBOSE(2, "Xclbin: " << xclbin_name << " loaded successfully!");
-    return 0;
+    return kernel_desc;
 }
 
-xrt::bo npu_app::create_buffer(size_t size, int group_id, int app_id){
+int npu_app::_add_xclbin(const accel_kernel_desc& kernel_desc){
+    int xclbin_id = this->kernel_descs.size();
+    this->kernel_descs.push_back(kernel_desc);
+    this->xclbin_ids[xclbin_key(kernel_desc.xclbin_name, kernel_desc.qos, kernel_desc.context_tag)] = xclbin_id;
+    this->startup.load_time += kernel_desc.load_time;
+    this->startup.context_time += kernel_desc.context_time;
+    LOG_VERBOSE(2, "Xclbin: " << kernel_desc.xclbin_name << " registered as id " << xclbin_id << "!");
+    return xclbin_id;
+}
+
+npu_bo npu_app::create_buffer(size_t size, int group_id, int app_id){
     LOG_VERBOSE(2, "Creating buffer with size: " << size << " and group_id: " << group_id << " and app_id: " << app_id);
     if (app_id >= this->hw_descs.size()){
         throw std::runtime_error("App ID is out of range");
     }
-    return xrt::bo(this->device, size, XRT_BO_FLAGS_HOST_ONLY, this->hw_descs[app_id].kernel_desc->kernel.group_id(group_id));
+    return this->bo_pool->acquire(size, npu_bo_host_only, this->hw_descs[app_id].kernel_desc->kernel.group_id(group_id));
+}
+
+npu_bo_arena npu_app::create_arena(size_t size, int group_id, int app_id){
+    return npu_bo_arena(*this->device, this->create_buffer(size, group_id, app_id));
 }
 
 template<typename T>
 buffer<T> npu_app::create_bo_buffer(size_t size, int group_id, int app_id){
     LOG_VERBOSE(2, "Creating buffer buffer with size: " << size << " and group_id: " << group_id << " and app_id: " << app_id);
-    return buffer<T>(size, this->device, this->hw_descs[app_id].kernel_desc->kernel, group_id);
+    return buffer<T>(size, *this->bo_pool, this->hw_descs[app_id].kernel_desc->kernel, group_id);
 }
 
 template buffer<float> npu_app::create_bo_buffer<float>(size_t size, int group_id, int app_id);
@@ -152,68 +274,134 @@ template buffer<int32_t> npu_app::create_bo_buffer<int32_t>(size_t size, int gro
 template buffer<int8_t> npu_app::create_bo_buffer<int8_t>(size_t size, int group_id, int app_id);
 template buffer<std::bfloat16_t> npu_app::create_bo_buffer<std::bfloat16_t>(size_t size, int group_id, int app_id);
 
-ert_cmd_state npu_app::run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, xrt::bo& Out1, int app_id){
-    unsigned int opcode = 3;
+template<typename T>
+buffer<T> npu_app::create_bo_buffer(size_t size, int group_id, int app_id, const host_alloc_policy& policy){
+    if (is_default_policy(policy)){
+        return this->create_bo_buffer<T>(size, group_id, app_id);
+    }
+    LOG_VERBOSE(2, "Creating " << host_alloc_policy_name(policy) << " buffer with size: " << size << " and group_id: " << group_id << " and app_id: " << app_id);
+    if (app_id >= this->hw_descs.size()){
+        throw std::runtime_error("App ID is out of range");
+    }
+    return buffer<T>(size, policy, *this->device, this->hw_descs[app_id].kernel_desc->kernel, group_id);
+}
+
+template buffer<float> npu_app::create_bo_buffer<float>(size_t size, int group_id, int app_id, const host_alloc_policy& policy);
+template buffer<uint32_t> npu_app::create_bo_buffer<uint32_t>(size_t size, int group_id, int app_id, const host_alloc_policy& policy);
+template buffer<int32_t> npu_app::create_bo_buffer<int32_t>(size_t size, int group_id, int app_id, const host_alloc_policy& policy);
+template buffer<int8_t> npu_app::create_bo_buffer<int8_t>(size_t size, int group_id, int app_id, const host_alloc_policy& policy);
+template buffer<std::bfloat16_t> npu_app::create_bo_buffer<std::bfloat16_t>(size_t size, int group_id, int app_id, const host_alloc_policy& policy);
+
+npu_bo npu_app::import_buffer(void* ptr, size_t size, int group_id, int app_id){
+    LOG_VERBOSE(2, "Importing buffer with size: " << size << " and group_id: " << group_id << " and app_id: " << app_id);
+    if (app_id >= this->hw_descs.size()){
+        throw std::runtime_error("App ID is out of range");
+    }
+    return this->userptr_cache->import(ptr, size, this->hw_descs[app_id].kernel_desc->kernel.group_id(group_id));
+}
+
+template<typename T>
+buffer<T> npu_app::import_bo_buffer(T* data, size_t count, int group_id, int app_id){
+    LOG_VERBOSE(2, "Importing buffer buffer with size: " << count << " and group_id: " << group_id << " and app_id: " << app_id);
+    if (app_id >= this->hw_descs.size()){
+        throw std::runtime_error("App ID is out of range");
+    }
+    return buffer<T>(data, count, *this->userptr_cache, this->hw_descs[app_id].kernel_desc->kernel, group_id);
+}
+
+template buffer<float> npu_app::import_bo_buffer<float>(float* data, size_t count, int group_id, int app_id);
+template buffer<uint32_t> npu_app::import_bo_buffer<uint32_t>(uint32_t* data, size_t count, int group_id, int app_id);
+template buffer<int32_t> npu_app::import_bo_buffer<int32_t>(int32_t* data, size_t count, int group_id, int app_id);
+template buffer<int8_t> npu_app::import_bo_buffer<int8_t>(int8_t* data, size_t count, int group_id, int app_id);
+template buffer<std::bfloat16_t> npu_app::import_bo_buffer<std::bfloat16_t>(std::bfloat16_t* data, size_t count, int group_id, int app_id);
+
+ert_cmd_state npu_app::run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id){
     LOG_VERBOSE(3, "Running kernel with app_id: " << app_id);
-    auto run = this->hw_descs[app_id].kernel_desc->kernel(opcode, this->hw_descs[app_id].bo_instr, this->hw_descs[app_id].instr_size, In0, In1, Out0, Out1);
-    ert_cmd_state r = run.wait();
-    LOG_VERBOSE(3, "Kernel run finished with status: " << r);
-    return r;
+    return this->run(app_id, In0, In1, Out0, Out1);
 }
 
-ert_cmd_state npu_app::run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, int app_id){
-    unsigned int opcode = 3;
+ert_cmd_state npu_app::run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id){
     LOG_VERBOSE(3, "Running kernel with app_id: " << app_id);
-    auto run = this->hw_descs[app_id].kernel_desc->kernel(opcode, this->hw_descs[app_id].bo_instr, this->hw_descs[app_id].instr_size, In0, In1, Out0);
-    ert_cmd_state r = run.wait();
-    LOG_VERBOSE(3, "Kernel run finished with status: " << r);
-    return r;
+    return this->run(app_id, In0, In1, Out0);
 }
 
-ert_cmd_state npu_app::run(xrt::bo& In0, xrt::bo& Out0, int app_id){
-    unsigned int opcode = 3;
+ert_cmd_state npu_app::run(npu_bo& In0, npu_bo& Out0, int app_id){
     LOG_VERBOSE(3, "Running kernel with app_id: " << app_id);
-    auto run = this->hw_descs[app_id].kernel_desc->kernel(opcode, this->hw_descs[app_id].bo_instr, this->hw_descs[app_id].instr_size, In0, Out0);
-    ert_cmd_state r = run.wait();
-    LOG_VERBOSE(3, "Kernel run finished with status: " << r);
-    return r;
+    return this->run(app_id, In0, Out0);
 }
 
-xrt::run npu_app::create_run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, xrt::bo& Out1, int app_id){
-    xrt::run run = xrt::run(this->hw_descs[app_id].kernel_desc->kernel);
-    run.set_arg(0, 3);
-    run.set_arg(1, this->hw_descs[app_id].bo_instr);
-    run.set_arg(2, this->hw_descs[app_id].instr_size);
-    run.set_arg(3, In0);
-    run.set_arg(4, In1);
-    run.set_arg(5, Out0);
-    run.set_arg(6, Out1);
-    return run;
+npu_future npu_app::run_async(npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id, npu_callback callback){
+    return this->submit(this->create_run(In0, In1, Out0, Out1, app_id), std::move(callback));
 }
 
-xrt::run npu_app::create_run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, int app_id){
-    xrt::run run = xrt::run(this->hw_descs[app_id].kernel_desc->kernel);
-    run.set_arg(0, 3);
-    run.set_arg(1, this->hw_descs[app_id].bo_instr);
-    run.set_arg(2, this->hw_descs[app_id].instr_size);
-    run.set_arg(3, In0);
-    run.set_arg(4, In1);
-    run.set_arg(5, Out0);
-    return run;
+npu_future npu_app::run_async(npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id, npu_callback callback){
+    return this->submit(this->create_run(In0, In1, Out0, app_id), std::move(callback));
+}
+
+npu_future npu_app::run_async(npu_bo& In0, npu_bo& Out0, int app_id, npu_callback callback){
+    return this->submit(this->create_run(In0, Out0, app_id), std::move(callback));
+}
+
+npu_future npu_app::submit(npu_run run, npu_callback callback){
+    if (!this->reaper){
+        this->reaper = std::make_unique<npu_reaper>();
+    }
+    return this->reaper->submit(run, std::move(callback));
 }
 
-xrt::run npu_app::create_run(xrt::bo& In0, xrt::bo& Out0, int app_id){
-    xrt::run run = xrt::run(this->hw_descs[app_id].kernel_desc->kernel);
-    run.set_arg(0, 3);
+npu_run npu_app::create_unbound_run(int app_id){
+    return this->hw_descs[app_id].kernel_desc->kernel.create_run();
+}
+
+void npu_app::bind_instr(npu_run& run, int app_id){
+    run.set_arg(0, (uint64_t)3);
     run.set_arg(1, this->hw_descs[app_id].bo_instr);
-    run.set_arg(2, this->hw_descs[app_id].instr_size);
-    run.set_arg(3, In0);
-    run.set_arg(4, Out0);
-    return run;
+    run.set_arg(2, (uint32_t)this->hw_descs[app_id].instr_size);
+}
+
+npu_run npu_app::create_run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id){
+    return this->create_run(app_id, In0, In1, Out0, Out1);
+}
+
+npu_run npu_app::create_run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id){
+    return this->create_run(app_id, In0, In1, Out0);
+}
+
+npu_run npu_app::create_run(npu_bo& In0, npu_bo& Out0, int app_id){
+    return this->create_run(app_id, In0, Out0);
+}
+
+npu_runlist npu_app::create_runlist(int app_id){
+    return this->hw_descs[app_id].kernel_desc->kernel.create_runlist();
+}
+
+npu_run_pool npu_app::create_run_pool(int count, npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id){
+    return this->_create_run_pool(count, {&In0, &In1, &Out0, &Out1}, app_id);
+}
+
+npu_run_pool npu_app::create_run_pool(int count, npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id){
+    return this->_create_run_pool(count, {&In0, &In1, &Out0}, app_id);
 }
 
-xrt::runlist npu_app::create_runlist(int app_id){
-    return xrt::runlist(this->hw_descs[app_id].kernel_desc->context);
+npu_run_pool npu_app::create_run_pool(int count, npu_bo& In0, npu_bo& Out0, int app_id){
+    return this->_create_run_pool(count, {&In0, &Out0}, app_id);
+}
+
+npu_run_pool npu_app::_create_run_pool(int count, std::vector<npu_bo*> bos, int app_id){
+    std::vector<npu_run> runs;
+    std::vector<std::vector<npu_bo>> bound;
+    for (int i = 0; i < count; i++){
+        npu_run run = this->create_unbound_run(app_id);
+        this->bind_instr(run, app_id);
+        std::vector<npu_bo> args(3 + bos.size());
+        for (int j = 0; j < bos.size(); j++){
+            run.set_arg(3 + j, *bos[j]);
+            args[3 + j] = *bos[j];
+        }
+        runs.push_back(run);
+        bound.push_back(args);
+    }
+    return npu_run_pool(runs, bound, this->create_runlist(app_id));
 }
 
 npu_app::~npu_app(){
@@ -230,8 +418,43 @@ void npu_app::list_kernels(){
     }
     std::cout << "Listing xclbins: (Total: " << this->kernel_descs.size() << ")" << std::endl;
     for (int i = 0; i < this->kernel_descs.size(); i++){
-        std::cout << "Xclbin " << i << " at address: " <<  &this->kernel_descs[i].xclbin << std::endl;
+        std::cout << "Xclbin " << i << ": " << this->kernel_descs[i].xclbin_name << std::endl;
+    }
+}
+
+void npu_app::print_registrations(){
+    const int width = 114;
+    const accel_startup& st = this->startup;
+    double phases = st.load_time + st.context_time + st.instr_time;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, "Registered apps: " << this->registrations.size() << ", xclbins: " << this->kernel_descs.size()
+        << ", instruction BOs: " << this->instr_stats.lookups - this->instr_stats.hits);
+    MSG_BOX_LINE(width, "Instruction cache: " << this->instr_stats.hits << "/" << this->instr_stats.lookups << " hits, "
+        << this->instr_stats.bytes << " bytes allocated, " << this->instr_stats.saved_bytes << " bytes shared");
+    MSG_BOX_LINE(width, std::fixed << std::setprecision(1) << "Startup (us): xclbins " << st.load_time << ", contexts "
+        << st.context_time << (this->startup_config.defer_contexts ? " deferred" : "") << ", instructions " << st.instr_time
+        << ", wall " << st.wall_time << " on " << std::max(st.threads, 1) << " threads, "
+        << std::setprecision(2) << (st.wall_time > 0 ? phases / st.wall_time : 0.0) << "x");
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::left << std::setw(4) << "id" << std::setw(38) << "instructions" << std::right
+        << std::setw(7) << "format" << std::setw(8) << "KiB" << std::setw(7) << "xclbin" << std::setw(7) << "instr"
+        << std::setw(10) << "xclbin us" << std::setw(10) << "ctx us" << std::setw(10) << "instr us" << std::setw(10) << "total us");
+    for (const accel_registration& reg : this->registrations){
+        std::string name = reg.instr_name.size() > 36 ? "..." + reg.instr_name.substr(reg.instr_name.size() - 33) : reg.instr_name;
+        std::ostringstream context;
+        if (reg.context_deferred){
+            context << "deferred";
+        }
+        else{
+            context << std::fixed << std::setprecision(1) << reg.context_time;
+        }
+        MSG_BOX_LINE(width, std::left << std::setw(4) << reg.app_id << std::setw(38) << name << std::right
+            << std::setw(7) << instr_format_name(reg.format) << std::fixed << std::setprecision(1) << std::setw(8) << reg.instr_bytes / 1024.0
+            << std::setw(7) << (reg.xclbin_cached ? "cached" : "loaded") << std::setw(7) << (reg.instr_cached ? "shared" : "new")
+            << std::setw(10) << reg.xclbin_time << std::setw(10) << context.str() << std::setw(10) << reg.instr_time
+            << std::setw(10) << reg.total_time);
     }
+    MSG_BONDLINE(width);
 }
 
 void npu_app::write_out_trace(char *traceOutPtr, size_t trace_size, std::string path) {
@@ -247,38 +470,16 @@ void npu_app::write_out_trace(char *traceOutPtr, size_t trace_size, std::string
 }
 
 void npu_app::print_npu_info(){
-    int fd = open("/dev/accel/accel0", O_RDWR);
-    if (fd < 0) {
-        perror("Failed to open amdgpu device");
-        return;
-    }
     amdxdna_drm_query_clock_metadata query_clock_metadata;
-    amdxdna_drm_get_info get_info = {
-        .param = DRM_AMDXDNA_QUERY_CLOCK_METADATA,
-        .buffer_size = sizeof(amdxdna_drm_query_clock_metadata),
-        .buffer = (unsigned long)&query_clock_metadata,
-    };
-    int ret = ioctl(fd, DRM_IOCTL_AMDXDNA_GET_INFO, &get_info);
-    if (ret < 0) {
-        std::cout << "Error code: " << ret << std::endl;
-        perror("Failed to get telemetry information");
-        close(fd);
+    if (this->device->query_clock_metadata(query_clock_metadata) < 0) {
         return;
     }
 
     amdxdna_drm_query_aie_metadata query_aie_metadata;
-    get_info.param = DRM_AMDXDNA_QUERY_AIE_METADATA;
-    get_info.buffer_size = sizeof(amdxdna_drm_query_aie_metadata);
-    get_info.buffer = (unsigned long)&query_aie_metadata;
-    ret = ioctl(fd, DRM_IOCTL_AMDXDNA_GET_INFO, &get_info);
-    if (ret < 0) {
-        std::cout << "Error code: " << ret << std::endl;
-        perror("Failed to get telemetry information");
-        close(fd);
+    if (this->device->query_aie_metadata(query_aie_metadata) < 0) {
         return;
     }
 
-    close(fd);
     MSG_BONDLINE(40);
     MSG_BOX_LINE(40, "NPU version: " << query_aie_metadata.version.major << "." << query_aie_metadata.version.minor);
     MSG_BOX_LINE(40, "MP-NPU clock frequency: " << query_clock_metadata.mp_npu_clock.freq_mhz << " MHz");
@@ -310,69 +511,52 @@ void npu_app::print_npu_info(){
 
 float npu_app::get_npu_power(bool print){
     // get the npu power consumption, unit is Watt
-    int fd = open("/dev/accel/accel0", O_RDWR);
-    if (fd < 0) {
-        perror("Failed to open amdgpu device");
-        return -1;
-    }
     amdxdna_drm_query_sensor query_sensor;
-
-    amdxdna_drm_get_info get_info = {
-        .param = DRM_AMDXDNA_QUERY_SENSORS,
-        .buffer_size = sizeof(amdxdna_drm_query_sensor),
-        .buffer = (unsigned long)&query_sensor,
-    };
-    int ret = ioctl(fd, DRM_IOCTL_AMDXDNA_GET_INFO, &get_info);
-    if (ret < 0) {
-        std::cout << "Error code: " << ret << std::endl;
-        perror("Failed to get telemetry information");
-        close(fd);
+    if (this->device->query_sensor(query_sensor) < 0) {
         return -1;
     }
     if (print){
         MSG_BOX(40, "NPU power: " << query_sensor.input << " " << query_sensor.units);
     }
-    close(fd);
     return (float)query_sensor.input * pow(10, query_sensor.unitm);
 }
 
+npu_environment query_npu_environment(npu_device& device){
+    npu_environment env = {};
+    env.backend = device.backend();
+    env.firmware_valid = device.query_firmware_version(env.firmware) >= 0;
+    env.clock_valid = device.query_clock_metadata(env.clock) >= 0;
+    env.aie_valid = device.query_aie_metadata(env.aie) >= 0;
+    env.power_mode_valid = device.query_power_mode(env.power_mode) >= 0;
+    amdxdna_drm_query_sensor sensor;
+    env.power = device.query_sensor(sensor) < 0 ? -1 : (float)sensor.input * pow(10, sensor.unitm);
+    return env;
+}
+
+npu_environment npu_app::get_environment(){
+    return query_npu_environment(*this->device);
+}
+
 void npu_app::interperate_bd(int app_id){
     // sync from the device to be consistent
-    this->hw_descs[app_id].bo_instr.sync(XCL_BO_SYNC_BO_FROM_DEVICE);
+    this->hw_descs[app_id].bo_instr.sync(npu_sync_from_device);
     npu_sequence seq(this->hw_descs[app_id].bo_instr);
     seq.print_sequence();
     seq.to_npu();
 }
 
+npu_ddr_traffic npu_app::get_ddr_traffic(int app_id){
+    npu_sequence seq(this->hw_descs[app_id].bo_instr);
+    return seq.get_ddr_traffic();
+}
+
 std::vector<u_int64_t> npu_app::read_mem(uint32_t col, uint32_t row, uint32_t addr, uint32_t size){
     // read the register from the device
     std::vector<u_int64_t> regs(size);
-    int fd = open("/dev/accel/accel0", O_RDWR);
-    if (fd < 0) {
-        perror("Failed to open npu device");
-        return std::vector<u_int64_t>();
-    }
-    amdxdna_drm_aie_mem aie_mem = {
-        .col = col,
-        .row = row,
-        .addr = addr,
-        .size = size,
-        .buf_p = (__u64)regs.data(),
-    };
-
-    amdxdna_drm_get_info get_info = {
-        .param = DRM_AMDXDNA_READ_AIE_MEM,
-        .buffer_size = sizeof(amdxdna_drm_aie_mem),
-        .buffer = (unsigned long)&aie_mem,
-    };
-    int ret = ioctl(fd, DRM_IOCTL_AMDXDNA_GET_INFO, &get_info);
-    if (ret < 0) {
-        std::cout << "Error code: " << ret << std::endl;
+    if (this->device->read_aie_mem(col, row, addr, size, regs.data()) < 0) {
         perror("Failed to read memory");
-        close(fd);
         return std::vector<u_int64_t>();
     }
-    close(fd);
     return regs;
 }
 
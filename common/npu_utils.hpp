@@ -10,6 +10,11 @@
 #include <cstdint>
 #include <cstdlib>
 #include <ctime>
+#include <atomic>
+#include <deque>
+#include <exception>
+#include <thread>
+#include <unordered_map>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
@@ -20,41 +25,167 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <linux/types.h>
-#include <drm/drm.h>
 #include <stdfloat>
-#include "xrt/xrt_bo.h"
-#include "xrt/xrt_device.h"
-#include "xrt/xrt_kernel.h"
+#include "npu_device.hpp"
+#include "npu_reaper.hpp"
+#include "npu_bo_arena.hpp"
+#include "npu_bo_registry.hpp"
+#include "npu_launch.hpp"
+#include "instr_file.hpp"
 #include "amdxdna_accel.h"
 #include "buffer.hpp"
+#include "bf16_convert.hpp"
 #include "debug_utils.hpp"
+#ifdef __XRT__
 #include "experimental/xrt_kernel.h"
 #include "experimental/xrt_ext.h"
 #include "experimental/xrt_module.h"
 #include "experimental/xrt_elf.h"
 #include "xrt/xrt_graph.h"
+#endif
 
 #include "npu_instr_utils.hpp"
+#include "vector_view.hpp"
 // Accelerator description
 // There should be only one npu_app inside main.
 typedef struct {
     std::string xclbin_name;
     std::string instr_name;
+    instr_format format = instr_format_auto; // of the instruction file
+    amdxdna_qos_info qos = default_npu_qos;  // hints of the hardware context
+    int arg_count = -1;                      // arguments after the instruction slots, -1 for every kernel slot
+    std::string context_tag;                 // apps with other tags get separate contexts of the same xclbin and QoS
 } accel_user_desc;
 
 typedef struct {
-    xrt::xclbin xclbin;
-    xrt::kernel kernel;
-    xrt::hw_context context;
+    std::string xclbin_name;
+    amdxdna_qos_info qos;
+    std::string context_tag;
+    npu_kernel kernel;   // xclbin, hardware context and kernel, owned by the device backend
+    int apps;            // registered apps using the xclbin
+    bool deferred;       // context created on the first run instead of at load
+    double load_time;    // us, loading and registering the xclbin
+    double context_time; // us, creating the hardware context, 0 when deferred
 } accel_kernel_desc;
 
 typedef struct {
     std::string instr_name;
     accel_kernel_desc* kernel_desc;
-    xrt::bo bo_instr;
+    npu_bo bo_instr;
     size_t instr_size;
+    std::vector<npu_kernel_arg> args; // kernel signature, checked at registration
+    int arg_count;                    // arguments of the design after the instruction slots
 } accel_hw_desc;
 
+// Cost of one registration
+typedef struct {
+    int app_id;
+    std::string xclbin_name;
+    std::string instr_name;
+    bool xclbin_cached; // xclbin loaded by an earlier registration
+    bool instr_cached;  // instruction BO shared with an earlier registration
+    instr_format format;
+    size_t instr_bytes; // size of the instruction file
+    bool context_deferred;
+    double xclbin_time;  // us, loading the xclbin, or looking it up when cached
+    double context_time; // us, creating the hardware context
+    double instr_time;   // us, reading, hashing and uploading the instructions
+    double total_time;  // us
+} accel_registration;
+
+// How xclbins are brought up
+typedef struct {
+    int threads;         // xclbins loaded concurrently by register_accel_apps, 0 for up to 8
+    bool defer_contexts; // create hardware contexts on the first run instead of at registration
+} accel_startup_config;
+
+const accel_startup_config default_accel_startup_config = {0, false};
+
+// Startup time by phase. The phase times are summed over xclbins and apps, wall_time is what
+// registration took, so the phase sum over wall_time is the gain of loading concurrently.
+typedef struct {
+    int threads;         // of the last register_accel_apps
+    double load_time;    // us
+    double context_time; // us
+    double instr_time;   // us
+    double wall_time;    // us
+} accel_startup;
+
+// Instruction BOs by content, shared by every app with the same instruction stream
+typedef struct {
+    uint64_t lookups;
+    uint64_t hits;
+    size_t bytes;       // instruction BO bytes allocated
+    size_t saved_bytes; // bytes shared instead of allocated
+} instr_cache_stats;
+
+// Snapshot of the device state a result was measured on.
+// The *_valid flags are false when the driver query failed.
+typedef struct {
+    npu_backend backend;
+    bool firmware_valid;
+    amdxdna_drm_query_firmware_version firmware;
+    bool clock_valid;
+    amdxdna_drm_query_clock_metadata clock;
+    bool aie_valid;
+    amdxdna_drm_query_aie_metadata aie;
+    bool power_mode_valid;
+    amdxdna_drm_get_power_mode power_mode;
+    float power; // W, negative when unavailable
+} npu_environment;
+
+// Queries the environment of a device, also without an npu_app
+npu_environment query_npu_environment(npu_device& device);
+
+inline std::string npu_power_mode_name(uint8_t mode){
+    switch (mode){
+        case POWER_MODE_DEFAULT: return "default";
+        case POWER_MODE_LOW: return "low";
+        case POWER_MODE_MEDIUM: return "medium";
+        case POWER_MODE_HIGH: return "high";
+        case POWER_MODE_TURBO: return "turbo";
+        default: return "unknown";
+    }
+}
+// Pre-armed runs of one accelerator, bound to a persistent runlist.
+// The runs and the runlist are created and bound once by npu_app::create_run_pool and can be
+// resubmitted with execute()/wait() any number of times. set_bo() rebinds an argument
+// between submissions, and only on the runs where the BO actually changed.
+class npu_run_pool{
+private:
+    std::vector<npu_run> runs;
+    // Bound BO per run and argument. The handles keep the BOs alive, so a new BO can never
+    // reuse the address of a bound one and be mistaken for it.
+    std::vector<std::vector<npu_bo>> bound;
+    npu_runlist runlist;
+
+public:
+    npu_run_pool() = default;
+    npu_run_pool(std::vector<npu_run> runs, std::vector<std::vector<npu_bo>> bound, npu_runlist runlist)
+        : runs(std::move(runs)), bound(std::move(bound)), runlist(runlist){
+        for (npu_run& run : this->runs){
+            this->runlist.add(run);
+        }
+    }
+
+    size_t size() const { return runs.size(); }
+    npu_run& operator[](size_t i) { return runs[i]; }
+
+    void set_bo(int arg_index, npu_bo& bo){
+        for (size_t i = 0; i < runs.size(); i++){
+            if (bound[i].size() <= arg_index){
+                bound[i].resize(arg_index + 1);
+            }
+            if (bound[i][arg_index].get() != bo.get()){
+                runs[i].set_arg(arg_index, bo);
+                bound[i][arg_index] = bo;
+            }
+        }
+    }
+
+    void execute() { runlist.execute(); }
+    void wait() { runlist.wait(); }
+};
 
 template <typename T>
 struct AlignedAllocator {
@@ -80,48 +211,161 @@ struct AlignedAllocator {
 // There should be only one npu_app inside main.
 // It handles all xclbins and instr_sequences.
 // Each xclbin may have multiple instr_sequences.
-// Each xclbin and instr_sequence has a unique id.
-// Both id shall be provided to run an accelerator.
-// Therefore, the xclbin_name between different accel_descriptions may overlap, but the instr_name is unique.
+// Each (xclbin, instr_sequence) pair is registered once and gets a unique app id.
+// The xclbin_name between different accel_descriptions may overlap; each xclbin is loaded once.
+// Both registries grow as needed and are indexed by path. Instruction BOs are cached by content
+// hash, so identical instruction streams share one BO.
+// The device backend is either the real XRT device or the simulated NPU (see npu_device.hpp).
 class npu_app{
 private:
-    std::vector<accel_kernel_desc> kernel_descs;
-    std::vector<accel_hw_desc> hw_descs;
-    std::vector<std::string> registered_xclbin_names;
+    // deques keep the kernel_desc pointers of hw_descs valid while growing
+    std::deque<accel_kernel_desc> kernel_descs;
+    std::deque<accel_hw_desc> hw_descs;
+    std::unordered_map<std::string, int> xclbin_ids; // by xclbin path and QoS, one context each
+    std::unordered_map<std::string, int> app_ids;    // by xclbin path, QoS and instruction path
+    std::unordered_map<uint64_t, std::vector<std::pair<int, npu_bo>>> instr_bos; // group id and BO by content hash
+    instr_cache_stats instr_stats;
+    std::vector<accel_registration> registrations;
+    accel_startup_config startup_config;
+    accel_startup startup;
 
-    int kernel_desc_count;
-    int hw_desc_count;
+    // every BO the device allocates or pins, shared with the device
+    npu_bo_registry bo_registry;
+    // the only device instance, wrapped by npu_tracked_device
+    std::unique_ptr<npu_device> device;
+    // started on the first asynchronous run, destroyed before the device
+    std::unique_ptr<npu_reaper> reaper;
+    // data BOs of create_buffer and create_bo_buffer
+    std::unique_ptr<npu_bo_pool> bo_pool;
+    // user pointer BOs of import_buffer and import_bo_buffer
+    std::unique_ptr<npu_userptr_cache> userptr_cache;
 
-    // the only device instance
-    xrt::device device;
+    accel_hw_desc& get_hw_desc(int app_id){
+        if (app_id < 0 || app_id >= (int)this->hw_descs.size()){
+            throw std::runtime_error("App ID " + std::to_string(app_id) + " is not registered");
+        }
+        return this->hw_descs[app_id];
+    }
 public:
-    npu_app(int max_xclbins = 1, int max_instrs = 1, unsigned int device_id = 0U);
+    // max_xclbins and max_instrs are kept for existing callers, the registries grow as needed.
+    npu_app(int max_xclbins = 1, int max_instrs = 1, unsigned int device_id = 0U, npu_backend backend = NPU_DEFAULT_BACKEND);
+    // Use an already created device, e.g. a simulated device with a custom cost model.
+    npu_app(std::unique_ptr<npu_device> device, int max_xclbins = 1, int max_instrs = 1);
 
-    int register_accel_app(accel_user_desc& user_desc);
+    // Returns the app id of the pair, registering it on first use
+    int register_accel_app(const accel_user_desc& user_desc);
+    // Registers all pairs and returns their app ids. New xclbins are loaded and their contexts
+    // created on startup_config.threads threads, then the instructions are loaded in order.
+    std::vector<int> register_accel_apps(const std::vector<accel_user_desc>& user_descs);
+    void set_startup_config(const accel_startup_config& config) { this->startup_config = config; }
+    accel_startup get_startup() { return this->startup; }
     ~npu_app();
-    int _load_instr_sequence(accel_user_desc& user_desc, accel_hw_desc& hw_desc);
-    int _load_xclbin(std::string xclbin_name);
-    xrt::bo create_buffer(size_t size, int group_id, int app_id);
+    // Maps the instruction file and binds the cached BO of the same content, or fills a new one
+    // straight from the mapping. Records the format, size and cache hit in reg.
+    void _load_instr_sequence(const accel_user_desc& user_desc, accel_hw_desc& hw_desc, accel_registration& reg);
+    // Returns the xclbin id, loading the xclbin on first use. The same xclbin with other QoS
+    // gets its own id and hardware context.
+    int _load_xclbin(const accel_user_desc& user_desc);
+    // Loads an xclbin and creates its context unless deferred, safe to run concurrently
+    accel_kernel_desc _prepare_xclbin(const accel_user_desc& user_desc);
+    int _add_xclbin(const accel_kernel_desc& kernel_desc);
+    // register_accel_app without the startup wall time
+    int _register_accel_app(const accel_user_desc& user_desc);
+    // Cached BO holding count words, empty if there is none
+    npu_bo _find_instr_bo(const uint32_t* words, size_t count, uint64_t hash, int group_id);
+    npu_bo create_buffer(size_t size, int group_id, int app_id);
+    // One BO of size bytes for an argument slot, split into sub-buffers by the arena
+    npu_bo_arena create_arena(size_t size, int group_id, int app_id);
 
     template<typename T>
     buffer<T> create_bo_buffer(size_t size, int group_id, int app_id);
+    // Host memory allocated with policy and imported as a user pointer BO, the default policy uses the pool
+    template<typename T>
+    buffer<T> create_bo_buffer(size_t size, int group_id, int app_id, const host_alloc_policy& policy);
+
+    // Zero-copy BOs over page aligned host memory, e.g. AlignedAllocator vectors.
+    // Release the returned BOs before freeing the memory; the pages stay pinned until then.
+    npu_bo import_buffer(void* ptr, size_t size, int group_id, int app_id);
+    template<typename T>
+    buffer<T> import_bo_buffer(T* data, size_t count, int group_id, int app_id);
+
+    // Variadic launches: args are bound after the instruction slots, any mix of npu_bo,
+    // buffer<T> and scalars, checked against the kernel signature (see npu_launch.hpp).
+    template<typename... Args>
+    npu_launch create_launch(int app_id, Args&&... args){
+        accel_hw_desc& hw_desc = this->get_hw_desc(app_id);
+        npu_launch launch(hw_desc.kernel_desc->kernel.create_run(), hw_desc.kernel_desc->kernel.name(), hw_desc.args, hw_desc.arg_count);
+        launch.bind_instr(hw_desc.bo_instr, hw_desc.instr_size);
+        launch.bind(std::forward<Args>(args)...);
+        return launch;
+    }
+
+    // The run is started without the launch, so every argument has to be bound here
+    template<typename... Args>
+    npu_run create_run(int app_id, Args&&... args){
+        npu_launch launch = this->create_launch(app_id, std::forward<Args>(args)...);
+        launch.check_complete();
+        return launch.get_run();
+    }
+
+    // Synchronous run of app_id. The launch lives for this call only, so no BO is held once
+    // it returns, and the caller may free imported memory right after.
+    template<typename... Args>
+    ert_cmd_state run(int app_id, Args&&... args){
+        npu_launch launch = this->create_launch(app_id, std::forward<Args>(args)...);
+        launch.start();
+        ert_cmd_state r = launch.wait();
+        LOG_VERBOSE(3, "Kernel run finished with status: " << r);
+        return r;
+    }
+
+    // Fixed arity forms of the above, with the app id last
+    ert_cmd_state run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id = 0);
+    ert_cmd_state run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id = 0);
+    ert_cmd_state run(npu_bo& In0, npu_bo& Out0, int app_id = 0);
+
+    // Asynchronous runs, the returned future is ready once the run finished and its callback returned
+    npu_future run_async(npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id = 0, npu_callback callback = nullptr);
+    npu_future run_async(npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id = 0, npu_callback callback = nullptr);
+    npu_future run_async(npu_bo& In0, npu_bo& Out0, int app_id = 0, npu_callback callback = nullptr);
+    // Starts an already created run, which must not be in flight
+    npu_future submit(npu_run run, npu_callback callback = nullptr);
+
+    npu_run create_run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id);
+    npu_run create_run(npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id);
+    npu_run create_run(npu_bo& In0, npu_bo& Out0, int app_id);
+
+    // The steps of create_run, kept apart so their cost can be measured
+    npu_run create_unbound_run(int app_id);
+    void bind_instr(npu_run& run, int app_id); // opcode, instruction BO and size
 
-    ert_cmd_state run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, xrt::bo& Out1, int app_id = 0);
-    ert_cmd_state run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, int app_id = 0);
-    ert_cmd_state run(xrt::bo& In0, xrt::bo& Out0, int app_id = 0);
+    npu_runlist create_runlist(int app_id);
 
-    xrt::run create_run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, xrt::bo& Out1, int app_id);
-    xrt::run create_run(xrt::bo& In0, xrt::bo& In1, xrt::bo& Out0, int app_id);
-    xrt::run create_run(xrt::bo& In0, xrt::bo& Out0, int app_id);
+    // count runs armed with the given BOs, in one persistent runlist
+    npu_run_pool create_run_pool(int count, npu_bo& In0, npu_bo& In1, npu_bo& Out0, npu_bo& Out1, int app_id);
+    npu_run_pool create_run_pool(int count, npu_bo& In0, npu_bo& In1, npu_bo& Out0, int app_id);
+    npu_run_pool create_run_pool(int count, npu_bo& In0, npu_bo& Out0, int app_id);
+    npu_run_pool _create_run_pool(int count, std::vector<npu_bo*> bos, int app_id);
 
-    xrt::runlist create_runlist(int app_id);
+    npu_device& get_device() { return *this->device; }
+    npu_backend get_backend() { return this->device->backend(); }
+    npu_bo_pool& get_bo_pool() { return *this->bo_pool; }
+    npu_userptr_cache& get_userptr_cache() { return *this->userptr_cache; }
+    // Footprint of the NPU visible memory, e.g. get_bo_registry().tag(T.bo(), "trace")
+    npu_bo_registry& get_bo_registry() { return this->bo_registry; }
     
     void list_kernels();
+    const std::vector<accel_registration>& get_registrations() { return this->registrations; }
+    instr_cache_stats get_instr_cache_stats() { return this->instr_stats; }
+    void print_registrations();
     void write_out_trace(char *traceOutPtr, size_t trace_size, std::string path);
     void print_npu_info();
     float get_npu_power(bool print = true);
+    npu_environment get_environment();
 
     void interperate_bd(int app_id);
+    // DDR traffic of one run, decoded from the instruction sequence
+    npu_ddr_traffic get_ddr_traffic(int app_id);
     std::vector<u_int64_t> read_mem(uint32_t col, uint32_t row, uint32_t addr, uint32_t size);
     uint32_t read_reg(uint32_t col, uint32_t row, uint32_t addr);
 };
@@ -0,0 +1,131 @@
+#ifndef __STREAM_PIPELINE_HPP__
+#define __STREAM_PIPELINE_HPP__
+
+#include <chrono>
+#include <functional>
+#include <vector>
+#include "npu_utils.hpp"
+
+// N-way buffered stream through one accelerator.
+// depth sets of input/output BOs rotate: item i uses set i % depth. Before a set is refilled,
+// the run of its previous item is waited for, synced back and drained. So while the NPU works
+// on set k, the host fills set k + 1 and drains set k + 1 - depth. depth = 1 runs every item
+// synchronously, 2 is double and 3 triple buffering.
+// The input is passed as In0 and the output as the next argument; an optional shared BO (e.g.
+// the trace buffer) follows them. All input sets are page aligned sub-buffers of one arena BO,
+// and so are the output sets.
+
+typedef struct {
+    size_t items;
+    int depth;
+    size_t bytes_in;   // host bytes filled
+    size_t bytes_out;  // host bytes drained
+    double elapsed;    // s, first fill to last drain
+    double fill_time;  // s, host fill callbacks
+    double drain_time; // s, host drain callbacks
+    double sync_time;  // s, sync to and from the device
+    double stall_time; // s, host blocked in run.wait()
+    double items_per_s;
+    double bandwidth;  // GiB/s, (bytes_in + bytes_out) / elapsed
+} stream_stats;
+
+template<typename Tin, typename Tout>
+class stream_pipeline{
+public:
+    typedef std::function<void(buffer<Tin>&, size_t)> fill_fn;   // (input set, item index)
+    typedef std::function<void(buffer<Tout>&, size_t)> drain_fn; // (output set, item index)
+
+    stream_pipeline(npu_app& npu_instance, int app_id, int depth, size_t in_count, size_t out_count,
+        npu_bo* shared = nullptr, int in_group = 3, int out_group = 4)
+        : depth(depth)
+    {
+        // before anything is sized by depth, a negative depth would be a huge size_t
+        if (depth < 1){
+            throw std::runtime_error("Pipeline depth must be at least 1");
+        }
+        in_flight.assign(depth, false);
+        item_of.assign(depth, 0);
+        const size_t page = 4096;
+        size_t in_stride = (in_count * sizeof(Tin) + page - 1) & ~(page - 1);
+        size_t out_stride = (out_count * sizeof(Tout) + page - 1) & ~(page - 1);
+        npu_bo_arena in_arena = npu_instance.create_arena(in_stride * depth, in_group, app_id);
+        npu_bo_arena out_arena = npu_instance.create_arena(out_stride * depth, out_group, app_id);
+        inputs.reserve(depth);
+        outputs.reserve(depth);
+        for (int k = 0; k < depth; k++){
+            inputs.push_back(in_arena.allocate_buffer<Tin>(in_count, page));
+            outputs.push_back(out_arena.allocate_buffer<Tout>(out_count, page));
+            if (shared != nullptr){
+                runs.push_back(npu_instance.create_run(app_id, inputs[k], outputs[k], *shared));
+            }
+            else{
+                runs.push_back(npu_instance.create_run(app_id, inputs[k], outputs[k]));
+            }
+        }
+    }
+
+    stream_stats run(size_t items, fill_fn fill, drain_fn drain){
+        typedef std::chrono::steady_clock clock;
+        auto seconds = [](clock::time_point a, clock::time_point b){
+            return std::chrono::duration<double>(b - a).count();
+        };
+        stream_stats stats = {};
+        stats.items = items;
+        stats.depth = depth;
+
+        auto retire = [&](int k){
+            clock::time_point t0 = clock::now();
+            runs[k].wait();
+            clock::time_point t1 = clock::now();
+            outputs[k].sync_from_device();
+            clock::time_point t2 = clock::now();
+            drain(outputs[k], item_of[k]);
+            clock::time_point t3 = clock::now();
+            stats.stall_time += seconds(t0, t1);
+            stats.sync_time += seconds(t1, t2);
+            stats.drain_time += seconds(t2, t3);
+            stats.bytes_out += outputs[k].size() * sizeof(Tout);
+            in_flight[k] = false;
+        };
+
+        clock::time_point start = clock::now();
+        for (size_t i = 0; i < items; i++){
+            int k = i % depth;
+            if (in_flight[k]){
+                retire(k);
+            }
+            clock::time_point t0 = clock::now();
+            fill(inputs[k], i);
+            clock::time_point t1 = clock::now();
+            inputs[k].sync_to_device();
+            clock::time_point t2 = clock::now();
+            runs[k].start();
+            stats.fill_time += seconds(t0, t1);
+            stats.sync_time += seconds(t1, t2);
+            stats.bytes_in += inputs[k].size() * sizeof(Tin);
+            item_of[k] = i;
+            in_flight[k] = true;
+        }
+        // Drain the remaining sets in submission order
+        for (int j = 0; j < depth; j++){
+            int k = (items + j) % depth;
+            if (in_flight[k]){
+                retire(k);
+            }
+        }
+        stats.elapsed = seconds(start, clock::now());
+        stats.items_per_s = items / stats.elapsed;
+        stats.bandwidth = (stats.bytes_in + stats.bytes_out) / stats.elapsed / 1024 / 1024 / 1024;
+        return stats;
+    }
+
+private:
+    int depth;
+    std::vector<buffer<Tin>> inputs;
+    std::vector<buffer<Tout>> outputs;
+    std::vector<npu_run> runs;
+    std::vector<bool> in_flight;
+    std::vector<size_t> item_of;
+};
+
+#endif
@@ -0,0 +1,381 @@
+#ifndef __VECTOR_VIEW_HPP__
+#define __VECTOR_VIEW_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "buffer.hpp"
+#include "buffer_ops.hpp"
+#include "data_pattern.hpp"
+#include "instr_utils/npu_cmd_write_dma.hpp"
+
+// N-dimensional strided views with the address generation of a DMA buffer descriptor.
+// Dimension 0 is the innermost. Element k of the view, in the order the DMA moves it, is at
+//   offset + i0 * stride0 + i1 * stride1 + ...    with k = i0 + size0 * (i1 + size1 * (...))
+// Sizes, strides and the offset are in elements. A shim BD has three dimensions plus the
+// iteration dimension, which repeats the whole pattern iter_size times, iter_stride apart.
+// A view does not copy: it addresses the buffer memory, so host code can fill or check exactly
+// the elements a BD reads or writes. gather() packs the viewed elements in BD order, e.g. tiles
+// a row-major matrix, and scatter() puts them back.
+
+const int bd_max_dims = 4;
+
+typedef struct {
+    int dims;
+    size_t size[bd_max_dims];
+    size_t stride[bd_max_dims];
+    size_t offset;
+} bd_dims;
+
+inline size_t bd_count(const bd_dims& d){
+    size_t count = 1;
+    for (int i = 0; i < d.dims; i++){
+        count *= d.size[i];
+    }
+    return count;
+}
+
+// One past the highest element index the pattern touches
+inline size_t bd_extent(const bd_dims& d){
+    size_t last = d.offset;
+    for (int i = 0; i < d.dims; i++){
+        if (d.size[i] == 0){
+            return d.offset;
+        }
+        last += (d.size[i] - 1) * d.stride[i];
+    }
+    return last + 1;
+}
+
+inline std::string bd_dims_str(const bd_dims& d){
+    std::string s = "[";
+    for (int i = d.dims - 1; i >= 0; i--){
+        s += std::to_string(d.size[i]) + ":" + std::to_string(d.stride[i]) + (i > 0 ? "," : "");
+    }
+    return s + "]+" + std::to_string(d.offset);
+}
+
+inline bd_dims linear_dims(size_t count, size_t offset = 0){
+    return bd_dims{1, {count}, {1}, offset};
+}
+
+// Row-major rows x cols matrix walked tile by tile, each tile row-major: d0 along a tile row,
+// d1 down the tile, d2 across the tiles of a row of tiles, d3 down the rows of tiles
+inline bd_dims tile_dims(size_t rows, size_t cols, size_t tile_rows, size_t tile_cols){
+    if (tile_rows == 0 || tile_cols == 0 || rows % tile_rows != 0 || cols % tile_cols != 0){
+        throw std::runtime_error("Tiles of " + std::to_string(tile_rows) + "x" + std::to_string(tile_cols)
+            + " do not divide a " + std::to_string(rows) + "x" + std::to_string(cols) + " matrix");
+    }
+    return bd_dims{4, {tile_cols, tile_rows, cols / tile_cols, rows / tile_rows},
+        {1, cols, tile_cols, tile_rows * cols}, 0};
+}
+
+// The pattern of a decoded shim BD for elements of elem_size bytes. The BD counts 32 bit words
+// and its offset is in bytes; sub-word elements need a contiguous dimension 0.
+inline bd_dims bd_dims_from_cmd(const npu_dma_block_cmd& bd, size_t elem_size){
+    if (elem_size == 0 || elem_size > 4 || 4 % elem_size != 0){
+        throw std::runtime_error("BD views need elements of 1, 2 or 4 bytes, not " + std::to_string(elem_size));
+    }
+    if (bd.buffer_offset % elem_size != 0){
+        throw std::runtime_error("BD offset " + std::to_string(bd.buffer_offset) + " is not element aligned");
+    }
+    size_t per_word = 4 / elem_size;
+    size_t offset = bd.buffer_offset / elem_size;
+    if (bd.is_linear){
+        return linear_dims((size_t)bd.buffer_length * per_word, offset);
+    }
+    if (per_word > 1 && bd.dim0_stride != 1){
+        throw std::runtime_error("Sub-word elements need a contiguous dimension 0");
+    }
+    bd_dims d = {3, {(size_t)bd.dim0_size * per_word, bd.dim1_size, bd.dim2_size},
+        {1, (size_t)bd.dim1_stride * per_word, (size_t)bd.dim2_stride * per_word}, offset};
+    if (per_word == 1){
+        d.stride[0] = bd.dim0_stride;
+    }
+    if (bd.iter_size > 1){
+        d.dims = 4;
+        d.size[3] = bd.iter_size;
+        d.stride[3] = (size_t)bd.iter_stride * per_word;
+    }
+    return d;
+}
+
+namespace vector_views {
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+inline void gather32_avx2(uint32_t* dst, const uint32_t* src, size_t count, size_t stride){
+    const __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32((int)stride));
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8){
+        __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src + k * stride), index, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k), v);
+    }
+    for (; k < count; k++){
+        dst[k] = src[k * stride];
+    }
+}
+
+__attribute__((target("avx512f")))
+inline void scatter32_avx512(uint32_t* dst, const uint32_t* src, size_t count, size_t stride){
+    const __m512i index = _mm512_mullo_epi32(
+        _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32((int)stride));
+    size_t k = 0;
+    for (; k + 16 <= count; k += 16){
+        __m512i v = _mm512_loadu_si512(src + k);
+        _mm512_i32scatter_epi32(dst + k * stride, index, v, 4);
+    }
+    for (; k < count; k++){
+        dst[k * stride] = src[k];
+    }
+}
+#endif
+
+// dst[k] = src[k * stride]
+template<typename T>
+inline void gather_row(simd_level level, T* dst, const T* src, size_t count, size_t stride){
+    if (stride == 1){
+        std::memcpy(dst, src, count * sizeof(T));
+        return;
+    }
+#if defined(__x86_64__)
+    // 32 bit gather indices
+    if (sizeof(T) == 4 && level >= simd_avx2 && stride * 8 < (1ULL << 31)){
+        gather32_avx2(reinterpret_cast<uint32_t*>(dst), reinterpret_cast<const uint32_t*>(src), count, stride);
+        return;
+    }
+#endif
+    for (size_t k = 0; k < count; k++){
+        dst[k] = src[k * stride];
+    }
+}
+
+// dst[k * stride] = src[k]
+template<typename T>
+inline void scatter_row(simd_level level, T* dst, const T* src, size_t count, size_t stride){
+    if (stride == 1){
+        std::memcpy(dst, src, count * sizeof(T));
+        return;
+    }
+#if defined(__x86_64__)
+    // AVX2 has no scatter
+    if (sizeof(T) == 4 && level >= simd_avx512 && stride * 16 < (1ULL << 31)){
+        scatter32_avx512(reinterpret_cast<uint32_t*>(dst), reinterpret_cast<const uint32_t*>(src), count, stride);
+        return;
+    }
+#endif
+    for (size_t k = 0; k < count; k++){
+        dst[k * stride] = src[k];
+    }
+}
+
+}
+
+template<typename T>
+class vector_view{
+public:
+    vector_view(T* data, size_t count, const bd_dims& dims, bytes* owner = nullptr)
+        : data_(data), dims_(dims), owner_(owner)
+    {
+        if (dims.dims < 1 || dims.dims > bd_max_dims){
+            throw std::runtime_error("A view has 1 to " + std::to_string(bd_max_dims) + " dimensions, not " + std::to_string(dims.dims));
+        }
+        for (int i = 0; i < dims.dims; i++){
+            if (dims.size[i] == 0){
+                throw std::runtime_error("View " + bd_dims_str(dims) + " has an empty dimension");
+            }
+        }
+        if (bd_extent(dims) > count){
+            throw std::runtime_error("View " + bd_dims_str(dims) + " reaches element " + std::to_string(bd_extent(dims))
+                + " of a " + std::to_string(count) + " element buffer");
+        }
+    }
+
+    vector_view(buffer<T>& buf, const bd_dims& dims) : vector_view(buf.data(), buf.size(), dims, &buf) {}
+
+    // The elements the BD moves out of or into buf
+    static vector_view from_bd(buffer<T>& buf, const npu_dma_block_cmd& bd){
+        return vector_view(buf, bd_dims_from_cmd(bd, sizeof(T)));
+    }
+
+    int dims() const { return dims_.dims; }
+    size_t size(int dim) const { return dims_.size[dim]; }
+    size_t stride(int dim) const { return dims_.stride[dim]; }
+    const bd_dims& shape() const { return dims_; }
+
+    // Number of elements in the view
+    size_t count() const { return bd_count(dims_); }
+
+    // Buffer index of element (i0, i1, ...), innermost first
+    template<typename... Idx>
+    size_t index(Idx... idx) const {
+        static_assert(sizeof...(Idx) <= bd_max_dims, "Too many indices");
+        const size_t list[] = {(size_t)idx...};
+        size_t offset = dims_.offset;
+        for (size_t i = 0; i < sizeof...(Idx); i++){
+            offset += list[i] * dims_.stride[i];
+        }
+        return offset;
+    }
+
+    template<typename... Idx>
+    T& operator()(Idx... idx) const {
+        return data_[index(idx...)];
+    }
+
+    // Buffer index of the k-th element in BD order
+    size_t index_at(size_t k) const {
+        size_t offset = dims_.offset;
+        for (int i = 0; i < dims_.dims; i++){
+            offset += (k % dims_.size[i]) * dims_.stride[i];
+            k /= dims_.size[i];
+        }
+        return offset;
+    }
+
+    T& operator[](size_t k) const {
+        return data_[index_at(k)];
+    }
+
+    // count elements of dimension dim from begin, the other dimensions unchanged
+    vector_view slice(int dim, size_t begin, size_t count) const {
+        if (dim < 0 || dim >= dims_.dims || begin + count > dims_.size[dim]){
+            throw std::runtime_error("Slice out of view " + bd_dims_str(dims_));
+        }
+        vector_view v = *this;
+        v.dims_.offset += begin * dims_.stride[dim];
+        v.dims_.size[dim] = count;
+        return v;
+    }
+
+    // Packs the viewed elements in BD order into dst, count() elements
+    void gather(T* dst, const buffer_ops_config& cfg = default_buffer_ops_config()) const {
+        for_rows(cfg, [&](size_t base, size_t k){
+            vector_views::gather_row(cfg.level, dst + k, data_ + base, dims_.size[0], dims_.stride[0]);
+        });
+    }
+
+    // Writes count() elements in BD order from src to the viewed elements
+    void scatter(const T* src, const buffer_ops_config& cfg = default_buffer_ops_config()){
+        for_rows(cfg, [&](size_t base, size_t k){
+            vector_views::scatter_row(cfg.level, data_ + base, src + k, dims_.size[0], dims_.stride[0]);
+        });
+        mark_dirty();
+    }
+
+    void fill(T value, const buffer_ops_config& cfg = default_buffer_ops_config()){
+        for_rows(cfg, [&](size_t base, size_t){
+            T* row = data_ + base;
+            for (size_t i = 0; i < dims_.size[0]; i++){
+                row[i * dims_.stride[0]] = value;
+            }
+        });
+        mark_dirty();
+    }
+
+    // Element k in BD order gets word k of the pattern, so a tile that lands in the wrong place
+    // on the NPU side does not verify
+    void fill(const data_pattern& p, const buffer_ops_config& cfg = default_buffer_ops_config()){
+        static_assert(sizeof(T) == sizeof(uint32_t), "Patterns are 32 bit words");
+        for_rows(cfg, [&](size_t base, size_t k){
+            if (dims_.stride[0] == 1){
+                data_patterns::generate(cfg.level, reinterpret_cast<uint32_t*>(data_ + base), dims_.size[0], p, k);
+                return;
+            }
+            std::vector<uint32_t> row(dims_.size[0]);
+            data_patterns::generate(cfg.level, row.data(), row.size(), p, k);
+            vector_views::scatter_row(cfg.level, reinterpret_cast<uint32_t*>(data_ + base), row.data(), row.size(), dims_.stride[0]);
+        });
+        mark_dirty();
+    }
+
+    // Checks the viewed elements against the pattern in BD order, burst_words per reported burst
+    integrity_report verify(const data_pattern& p, size_t burst_words, size_t max_records = 16,
+        const buffer_ops_config& cfg = default_buffer_ops_config()) const {
+        static_assert(sizeof(T) == sizeof(uint32_t), "Patterns are 32 bit words");
+        if (is_contiguous()){
+            return data_patterns::verify(reinterpret_cast<const uint32_t*>(data_ + dims_.offset), count(), p, burst_words, max_records, cfg);
+        }
+        std::vector<uint32_t> packed(count());
+        gather(reinterpret_cast<T*>(packed.data()), cfg);
+        return data_patterns::verify(packed.data(), packed.size(), p, burst_words, max_records, cfg);
+    }
+
+    // Compares the viewed elements in BD order with expected
+    mismatch_summary<T> compare(const T* expected, size_t max_records = 16,
+        const buffer_ops_config& cfg = default_buffer_ops_config()) const {
+        if (is_contiguous()){
+            return buffer_ops::compare(data_ + dims_.offset, expected, count(), max_records, cfg);
+        }
+        std::vector<T> packed(count());
+        gather(packed.data(), cfg);
+        return buffer_ops::compare(packed.data(), expected, packed.size(), max_records, cfg);
+    }
+
+    // The view walks the buffer linearly from its offset
+    bool is_contiguous() const {
+        size_t expected = 1;
+        for (int i = 0; i < dims_.dims; i++){
+            if (dims_.size[i] > 1 && dims_.stride[i] != expected){
+                return false;
+            }
+            expected *= dims_.size[i];
+        }
+        return true;
+    }
+
+private:
+    // Runs f(buffer index, BD index) on the first element of every dimension 0 row. Rows are
+    // split into contiguous ranges, one per worker of buffer_ops.
+    template<typename F>
+    void for_rows(const buffer_ops_config& cfg, F f) const {
+        size_t rows = count() / dims_.size[0];
+        size_t row_bytes = dims_.size[0] * sizeof(T);
+        size_t threads = std::max<size_t>(1, std::min({buffer_ops::thread_count(cfg), rows,
+            rows * row_bytes / std::max<size_t>(cfg.min_chunk, 4096)}));
+        size_t chunk = (rows + threads - 1) / threads;
+        auto work = [&](size_t t){
+            size_t begin = std::min(rows, t * chunk);
+            size_t end = std::min(rows, begin + chunk);
+            if (begin == end){
+                return;
+            }
+            // Index of row begin in dimensions 1 and up
+            size_t idx[bd_max_dims] = {0};
+            size_t base = dims_.offset;
+            size_t r = begin;
+            for (int i = 1; i < dims_.dims; i++){
+                idx[i] = r % dims_.size[i];
+                r /= dims_.size[i];
+                base += idx[i] * dims_.stride[i];
+            }
+            for (size_t row = begin; row < end; row++){
+                f(base, row * dims_.size[0]);
+                for (int i = 1; i < dims_.dims; i++){
+                    base += dims_.stride[i];
+                    if (++idx[i] < dims_.size[i]){
+                        break;
+                    }
+                    base -= idx[i] * dims_.stride[i];
+                    idx[i] = 0;
+                }
+            }
+        };
+        buffer_ops::workers().run(threads, work);
+    }
+
+    void mark_dirty(){
+        if (owner_ != nullptr){
+            owner_->mark_dirty(dims_.offset * sizeof(T), (bd_extent(dims_) - dims_.offset) * sizeof(T));
+        }
+    }
+
+    T* data_;
+    bd_dims dims_;
+    bytes* owner_;
+};
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef __ALLOCBENCH_HPP__
+#define __ALLOCBENCH_HPP__
+#include <algorithm>
+#include "typedef.hpp"
+#include "npu_utils.hpp"
+#include "utils.hpp"
+#include "bwbench.hpp"
+
+// Host allocation policy benchmark.
+// The input BO of the default bwbench point is allocated with every policy in turn, then the
+// cost of the allocation, of the first and of a warm host fill, of syncs in both directions and
+// the DMA bandwidth of kernel runs reading it are measured. The driver BO from the pool is the
+// baseline. Policies the system cannot provide, e.g. without reserved huge pages, are skipped.
+
+typedef struct {
+    std::string policy;
+    bool available;
+    std::string error;
+    double alloc_time;  // us, allocation, prefault and import
+    double first_fill;  // GiB/s, first write to the pages
+    double warm_fill;   // GiB/s
+    double sync_to;     // GiB/s, median
+    double sync_from;   // GiB/s, median
+    double dma;         // GiB/s, DDR reads of the kernel
+} alloc_result;
+
+namespace allocbench {
+
+typedef enum {
+    alloc_driver_bo, // driver BO from the pool
+    alloc_policy,    // host memory allocated with a policy and imported
+    alloc_import,    // a vector imported as a user pointer BO
+    alloc_reimport   // the same vector imported again while the first import is held
+} alloc_source;
+
+typedef struct {
+    std::string name;
+    alloc_source source;
+    host_alloc_policy policy;
+} alloc_case;
+
+inline std::vector<alloc_case> cases(int numa_node){
+    std::vector<alloc_case> list = {{"driver bo", alloc_driver_bo, default_host_alloc_policy}};
+    for (host_page_policy pages : {host_pages_default, host_pages_transparent, host_pages_huge}){
+        for (bool prefault : {false, true}){
+            host_alloc_policy policy = {pages, prefault, -1};
+            list.push_back({host_alloc_policy_name(policy), alloc_policy, policy});
+        }
+    }
+    if (numa_node >= 0){
+        for (host_page_policy pages : {host_pages_default, host_pages_huge}){
+            host_alloc_policy policy = {pages, true, numa_node};
+            list.push_back({host_alloc_policy_name(policy), alloc_policy, policy});
+        }
+    }
+    list.push_back({"userptr import", alloc_import, default_host_alloc_policy});
+    list.push_back({"userptr re-import", alloc_reimport, default_host_alloc_policy});
+    return list;
+}
+
+inline buffer<dtype> allocate(npu_app& npu_instance, int app_id, const alloc_case& c, size_t count, dtype* host){
+    switch (c.source){
+        case alloc_driver_bo:
+            return npu_instance.create_bo_buffer<dtype>(count, 3, app_id);
+        case alloc_policy:
+            return npu_instance.create_bo_buffer<dtype>(count, 3, app_id, c.policy);
+        default:
+            return npu_instance.import_bo_buffer<dtype>(host, count, 3, app_id);
+    }
+}
+
+inline double gibps(size_t bytes, uint64_t ns){
+    return ns > 0 ? (double)bytes / ns * 1e9 / 1024 / 1024 / 1024 : 0.0;
+}
+
+inline alloc_result run_case(npu_app& npu_instance, int app_id, const alloc_case& c, size_t count,
+    npu_bo& Out0, npu_bo& Out1, size_t read_bytes, int runs){
+    alloc_result result = {c.name, true, "", 0.0, 0.0, 0.0, 0.0, 0.0, 0.0};
+    const size_t bytes = count * sizeof(dtype);
+    const int syncs = 9;
+    try {
+        bool import = c.source == alloc_import || c.source == alloc_reimport;
+        std::vector<dtype, AlignedAllocator<dtype>> host(import ? count : 0);
+        // declared before A, so the first import outlives the repeated one
+        npu_bo held;
+        if (c.source == alloc_reimport){
+            held = npu_instance.import_buffer(host.data(), bytes, 3, app_id);
+        }
+        time_utils::time_point t0 = time_utils::now();
+        buffer<dtype> A = allocate(npu_instance, app_id, c, count, host.data());
+        time_utils::time_point t1 = time_utils::now();
+        A.memset(1);
+        time_utils::time_point t2 = time_utils::now();
+        A.memset(2);
+        time_utils::time_point t3 = time_utils::now();
+        result.alloc_time = time_utils::duration_ns(t0, t1) / 1e3;
+        result.first_fill = gibps(bytes, time_utils::duration_ns(t1, t2));
+        result.warm_fill = gibps(bytes, time_utils::duration_ns(t2, t3));
+
+        std::vector<uint64_t> to_ns, from_ns;
+        for (int i = 0; i < syncs; i++){
+            time_utils::time_point s0 = time_utils::now();
+            A.sync_to_device();
+            time_utils::time_point s1 = time_utils::now();
+            A.sync_from_device();
+            time_utils::time_point s2 = time_utils::now();
+            to_ns.push_back(time_utils::duration_ns(s0, s1));
+            from_ns.push_back(time_utils::duration_ns(s1, s2));
+        }
+        std::nth_element(to_ns.begin(), to_ns.begin() + syncs / 2, to_ns.end());
+        std::nth_element(from_ns.begin(), from_ns.begin() + syncs / 2, from_ns.end());
+        result.sync_to = gibps(bytes, to_ns[syncs / 2]);
+        result.sync_from = gibps(bytes, from_ns[syncs / 2]);
+
+        npu_run run = npu_instance.create_run(A.bo(), Out0, Out1, app_id);
+        run.start();
+        run.wait();
+        time_utils::time_point r0 = time_utils::now();
+        for (int i = 0; i < runs; i++){
+            run.start();
+            run.wait();
+        }
+        result.dma = gibps(read_bytes * runs, time_utils::duration_ns(r0, time_utils::now()));
+    } catch (const std::exception& e) {
+        result.available = false;
+        result.error = e.what();
+        header_print("warning", "Skipping " << c.name << ": " << e.what());
+    }
+    return result;
+}
+
+inline std::vector<alloc_result> run_suite(npu_app& npu_instance, int app_id, size_t count, npu_bo& Out0, npu_bo& Out1,
+    size_t read_bytes, int runs, int numa_node){
+    std::vector<alloc_result> results;
+    for (const alloc_case& c : cases(numa_node)){
+        results.push_back(run_case(npu_instance, app_id, c, count, Out0, Out1, read_bytes, runs));
+    }
+    return results;
+}
+
+inline void print_results(const std::vector<alloc_result>& results){
+    const int width = 100;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::left << std::setw(20) << "policy" << std::right << std::setw(12) << "alloc (us)"
+        << std::setw(13) << "first fill" << std::setw(13) << "warm fill" << std::setw(13) << "sync to"
+        << std::setw(13) << "sync from" << std::setw(13) << "dma");
+    MSG_BOX_LINE(width, std::left << std::setw(20) << "" << std::right << std::setw(12) << ""
+        << std::setw(13) << "(GiB/s)" << std::setw(13) << "(GiB/s)" << std::setw(13) << "(GiB/s)"
+        << std::setw(13) << "(GiB/s)" << std::setw(13) << "(GiB/s)");
+    MSG_BONDLINE(width);
+    for (const alloc_result& r : results){
+        if (!r.available){
+            MSG_BOX_LINE(width, std::left << std::setw(20) << r.policy << std::right << std::setw(12) << "n/a");
+            continue;
+        }
+        MSG_BOX_LINE(width, std::left << std::setw(20) << r.policy << std::right << std::fixed << std::setprecision(1)
+            << std::setw(12) << r.alloc_time << std::setprecision(2) << std::setw(13) << r.first_fill
+            << std::setw(13) << r.warm_fill << std::setw(13) << r.sync_to << std::setw(13) << r.sync_from
+            << std::setw(13) << r.dma);
+    }
+    MSG_BONDLINE(width);
+}
+
+}
+#endif
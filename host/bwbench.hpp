@@ -0,0 +1,344 @@
+#ifndef __BWBENCH_HPP__
+#define __BWBENCH_HPP__
+#include <filesystem>
+#include "typedef.hpp"
+#include "npu_utils.hpp"
+#include "npu_instr_utils.hpp"
+#include "latency_histogram.hpp"
+#include "adaptive_bench.hpp"
+#include "stream_pipeline.hpp"
+#include "data_pattern.hpp"
+
+// One design point of iron/bwbench.py.
+// Each column streams rounds * token_rate bursts on both input channels and writes one
+// burst of tokens per round.
+typedef struct {
+    int use_cols;
+    int burst_size; // words per burst
+    int token_rate; // input bursts per output token
+    int rounds;
+} bwbench_config;
+
+// Data integrity of a point. The kernel forwards tokens, not the input data, so the output is
+// checked for coverage: C is filled with a canary and every burst must have been overwritten.
+// The input must come back unchanged, a DMA writing to the wrong buffer shows up there.
+typedef struct {
+    bool enabled;
+    data_pattern pattern;
+    size_t burst_words;
+    integrity_report input;         // A after the runs
+    size_t output_bursts;
+    std::vector<size_t> unwritten;  // output bursts still holding the canary
+    bool output_checked;            // false on the simulated backend, which moves no data
+    bool ok;
+} bwbench_integrity;
+
+typedef struct {
+    bwbench_config config;
+    npu_ddr_traffic traffic; // decoded from the instruction sequence
+    float bare_time;         // us
+    float runlist_time;      // us, per run
+    float bandwidth;         // GiB/s, DDR reads
+    latency_histogram bare_latency;    // ns, every start/wait of a single run
+    latency_histogram runlist_latency; // ns, every runlist batch
+    latency_histogram bare_submit;     // ns, host side cost of start()
+    latency_histogram runlist_submit;  // ns, host side cost of execute()
+    float pool_setup_time;             // us, creating and arming the run pool once
+    adaptive_result bare_stats;        // ns
+    adaptive_result runlist_stats;     // GiB/s
+    std::vector<double> bandwidth_samples; // GiB/s, every measured runlist batch
+    stream_stats stream;               // buffered streaming run, depth 0 when not run
+    bwbench_integrity integrity;       // not enabled without a data pattern
+} bwbench_result;
+
+namespace bwbench {
+
+const bwbench_config default_config = {4, 1024, 32, 4};
+
+// Artifact name used by the Makefile sweep rules
+inline std::string name(const bwbench_config& cfg){
+    return "bwbench_c" + std::to_string(cfg.use_cols) + "_b" + std::to_string(cfg.burst_size)
+        + "_t" + std::to_string(cfg.token_rate) + "_r" + std::to_string(cfg.rounds);
+}
+
+// Buffer sizes in words, as declared by the runtime sequence
+inline size_t A_size(const bwbench_config& cfg){
+    return (size_t)cfg.use_cols * cfg.burst_size * cfg.token_rate * 2;
+}
+
+inline size_t C_size(const bwbench_config& cfg){
+    return (size_t)cfg.use_cols * cfg.burst_size;
+}
+
+inline bool is_default(const bwbench_config& cfg){
+    return cfg.use_cols == default_config.use_cols && cfg.burst_size == default_config.burst_size
+        && cfg.token_rate == default_config.token_rate && cfg.rounds == default_config.rounds;
+}
+
+// Parse "4", "1,2,4", "1:8" (doubling from 1 to 8) or "8:64:8" (from 8 to 64 in steps of 8).
+// Every value of a sweep is a count, so values below 1 are refused.
+inline std::vector<int> parse_range(const std::string& spec){
+    auto number = [&](const std::string& part){
+        size_t used = 0;
+        int value = 0;
+        try{
+            value = std::stoi(part, &used);
+        }
+        catch (const std::exception&){
+            used = 0;
+        }
+        if (part.empty() || used != part.size()){
+            throw std::runtime_error("Invalid number '" + part + "' in range: " + spec);
+        }
+        return value;
+    };
+    std::vector<int> values;
+    std::stringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ',')){
+        std::vector<int> fields;
+        std::stringstream parts(item);
+        std::string part;
+        while (std::getline(parts, part, ':')){
+            fields.push_back(number(part));
+        }
+        if (fields.size() == 1){
+            if (fields[0] <= 0){
+                throw std::runtime_error("Invalid value: " + item + ", it must be at least 1");
+            }
+            values.push_back(fields[0]);
+        }
+        else if (fields.size() == 2 || fields.size() == 3){
+            if (fields[0] <= 0 || fields[1] < fields[0] || (fields.size() == 3 && fields[2] <= 0)){
+                throw std::runtime_error("Invalid range: " + item);
+            }
+            for (int v = fields[0]; v <= fields[1]; v = (fields.size() == 2) ? v * 2 : v + fields[2]){
+                values.push_back(v);
+            }
+        }
+        else{
+            throw std::runtime_error("Invalid range: " + item);
+        }
+    }
+    if (values.empty()){
+        throw std::runtime_error("Empty range: " + spec);
+    }
+    return values;
+}
+
+// Columns of the array, iron/bwbench.py refuses designs wider than this
+inline int device_columns(const std::string& device){
+    return (device == "npu1") ? 4 : 8;
+}
+
+inline void check_columns(const std::vector<int>& cols, const std::string& device){
+    for (int c : cols){
+        if (c < 1 || c > device_columns(device)){
+            throw std::runtime_error("Invalid column count " + std::to_string(c) + " for " + device
+                + ", it has " + std::to_string(device_columns(device)) + " columns");
+        }
+    }
+}
+
+inline std::vector<bwbench_config> make_points(const std::vector<int>& cols, const std::vector<int>& bursts,
+    const std::vector<int>& token_rates, const std::vector<int>& rounds){
+    std::vector<bwbench_config> points;
+    for (int c : cols){
+        for (int b : bursts){
+            for (int t : token_rates){
+                for (int r : rounds){
+                    points.push_back({c, b, t, r});
+                }
+            }
+        }
+    }
+    return points;
+}
+
+// Host side copy of the runtime sequence of iron/bwbench.py, used to dry-run points on the
+// simulated backend before the bitstreams are built. Real hardware always uses the
+// instructions generated by aiecc, since the BD layout depends on the compiled design.
+// Sequence header with no operations. Header fields are informational only, the op count
+// and the byte size are filled in by the caller.
+inline std::vector<uint32_t> sequence_header(const std::string& device){
+    uint32_t dev_cols = device_columns(device);
+    return {
+        (1u << dev_minor_shift) | (3u << dev_gen_shift) | (6u << dev_n_row_shift),
+        (dev_cols << dev_num_cols_shift) | (1u << dev_mem_tile_rows_shift),
+        0,
+        4 * sizeof(uint32_t)
+    };
+}
+
+inline std::vector<uint32_t> generate_sequence(const bwbench_config& cfg, const std::string& device){
+    std::vector<uint32_t> seq = sequence_header(device);
+    uint32_t ops = 0;
+    auto push_task = [&](uint32_t col, uint32_t bd_id, uint32_t channel, bool mm2s, uint32_t length, uint32_t arg_idx, uint32_t arg_offset){
+        npu_dma_block_cmd bd = {};
+        bd.col = col;
+        bd.row = 0;
+        bd.bd_id = bd_id;
+        bd.op_size = 12;
+        bd.buffer_length = length;
+        bd.dim0_stride = bd.dim1_stride = bd.dim2_stride = 1;
+        bd.iter_size = bd.iter_stride = 1;
+        bd.valid_bd = 1;
+        bd.to_npu(seq);
+
+        npu_ddr_cmd patch = {};
+        patch.op_size = 48;
+        patch.col = col;
+        patch.row = 0;
+        patch.bd_id = bd_id;
+        patch.arg_idx = arg_idx;
+        patch.arg_offset = arg_offset;
+        patch.to_npu(seq);
+
+        npu_write_cmd push = {};
+        push.col = col;
+        push.row = 0;
+        push.reg_addr = 0x1D204 + (mm2s ? 0x10 : 0x0) + channel * 0x8;
+        push.value = bd_id;
+        push.op_size = 6;
+        push.to_npu(seq);
+        ops += 3;
+    };
+    auto wait_tokens = [&](){
+        for (int col = 0; col < cfg.use_cols; col++){
+            npu_wait_cmd wait = {};
+            wait.wait_col = col;
+            wait.wait_row = 0;
+            wait.wait_channel = 0;
+            wait.op_size = 16;
+            wait.to_npu(seq);
+            ops++;
+        }
+    };
+    const uint32_t input_length = cfg.token_rate * cfg.burst_size;
+    for (int r = 0; r < cfg.rounds; r++){
+        uint32_t bd_offset = (r % 2) * 8;
+        for (int col = 0; col < cfg.use_cols; col++){
+            push_task(col, 1 + bd_offset, 0, true, input_length, 3, 0);
+            push_task(col, 2 + bd_offset, 1, true, input_length, 3, 0);
+            push_task(col, 0 + bd_offset, 0, false, cfg.burst_size, 4, col * cfg.burst_size * sizeof(dtype));
+        }
+        if (r > 0){
+            wait_tokens();
+        }
+    }
+    wait_tokens();
+    seq[2] = ops;
+    seq[3] = seq.size() * sizeof(uint32_t);
+    return seq;
+}
+
+inline void write_sequence(const std::vector<uint32_t>& seq, const std::string& path){
+    std::ofstream file(path, std::ios::binary);
+    if (!file){
+        throw std::runtime_error("Unable to write instruction file: " + path);
+    }
+    file.write(reinterpret_cast<const char*>(seq.data()), seq.size() * sizeof(uint32_t));
+}
+
+inline bool file_exists(const std::string& path){
+    std::ifstream file(path);
+    return file.good();
+}
+
+// Pick the artifacts of a design point. Sweep variants are looked up first; the default point
+// also accepts the plain bwbench build. On the simulated backend a missing instruction file is
+// generated under build/sim/.
+inline accel_user_desc resolve_artifacts(const bwbench_config& cfg, const std::string& device, npu_backend backend){
+    accel_user_desc desc = {
+        .xclbin_name = "build/xclbins/" + name(cfg) + ".xclbin",
+        .instr_name = "build/insts/" + name(cfg) + ".txt",
+        .arg_count = 3, // A, C and the trace
+    };
+    if (is_default(cfg) && !file_exists(desc.instr_name) && file_exists("build/insts/bwbench.txt")){
+        desc.xclbin_name = "build/xclbins/bwbench.xclbin";
+        desc.instr_name = "build/insts/bwbench.txt";
+    }
+    if (file_exists(desc.instr_name)){
+        return desc;
+    }
+    if (backend != npu_backend_sim){
+        throw std::runtime_error("Missing " + desc.instr_name + ", build it with: make sweep SWEEP_COLS=" + std::to_string(cfg.use_cols)
+            + " SWEEP_BURSTS=" + std::to_string(cfg.burst_size) + " SWEEP_TOKEN_RATES=" + std::to_string(cfg.token_rate)
+            + " SWEEP_ROUNDS=" + std::to_string(cfg.rounds));
+    }
+    std::filesystem::create_directories("build/sim/insts");
+    desc.instr_name = "build/sim/insts/" + name(cfg) + ".txt";
+    write_sequence(generate_sequence(cfg, device), desc.instr_name);
+    header_print("info", "Generated " << desc.instr_name);
+    return desc;
+}
+
+// C is prefilled with the canary, output bursts are written per column at column * burst_size
+inline const data_pattern canary = {pattern_prbs, 0xC0FFEEu, 0};
+
+inline data_pattern input_pattern(const bwbench_config& cfg, pattern_kind kind){
+    return {kind, 0x5EEDu, (size_t)cfg.burst_size};
+}
+
+inline bwbench_integrity check_integrity(const bwbench_config& cfg, const data_pattern& pattern, buffer<dtype>& A, buffer<dtype>& C, npu_backend backend){
+    bwbench_integrity result = {};
+    result.enabled = true;
+    result.pattern = pattern;
+    result.burst_words = cfg.burst_size;
+    A.sync_from_device();
+    C.sync_from_device();
+    result.input = data_patterns::verify(A.data(), A.size(), pattern, cfg.burst_size);
+    result.output_bursts = C.size() / cfg.burst_size;
+    result.output_checked = backend != npu_backend_sim;
+    if (result.output_checked){
+        result.unwritten = data_patterns::intact_bursts(C.data(), C.size(), canary, cfg.burst_size);
+    }
+    result.ok = result.input.bad_words == 0 && result.unwritten.empty();
+    return result;
+}
+
+inline void print_integrity(const bwbench_integrity& r){
+    MSG_BONDLINE(40);
+    MSG_BOX_LINE(40, "Integrity, " << pattern_kind_name(r.pattern.kind) << " pattern: " << (r.ok ? "pass" : "FAIL"));
+    MSG_BOX_LINE(40, "input  : " << r.input.bad_words << " of " << r.input.words << " words bad");
+    if (r.output_checked){
+        MSG_BOX_LINE(40, "output : " << r.unwritten.size() << " of " << r.output_bursts << " bursts unwritten");
+    }
+    else{
+        MSG_BOX_LINE(40, "output : not modeled by the sim");
+    }
+    MSG_BONDLINE(40);
+    for (const corrupt_burst& b : r.input.bursts){
+        header_print("error", "Input burst " << b.burst << " at byte " << b.offset << ": " << b.bad_words << " bad words, 0x"
+            << std::hex << b.actual << " instead of 0x" << b.expected << std::dec
+            << (b.source >= 0 ? ", word of index " + std::to_string(b.source) : ""));
+    }
+    for (size_t k = 0; k < std::min<size_t>(r.unwritten.size(), 16); k++){
+        header_print("error", "Output burst " << r.unwritten[k] << " at byte " << r.unwritten[k] * r.burst_words * sizeof(dtype) << " was not written");
+    }
+}
+
+inline void print_results(const std::vector<bwbench_result>& results){
+    const int width = 148;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::setw(5) << "cols" << std::setw(8) << "burst" << std::setw(7) << "rate" << std::setw(8) << "rounds"
+        << std::setw(14) << "read (B)" << std::setw(14) << "write (B)" << std::setw(12) << "bare (us)"
+        << std::setw(12) << "p50 (us)" << std::setw(12) << "p99 (us)" << std::setw(12) << "list (us)" << std::setw(10) << "GiB/s"
+        << std::setw(10) << "+-(%)" << std::setw(10) << "samples" << std::setw(8) << "data");
+    MSG_BONDLINE(width);
+    for (const bwbench_result& r : results){
+        MSG_BOX_LINE(width, std::setw(5) << r.config.use_cols << std::setw(8) << r.config.burst_size << std::setw(7) << r.config.token_rate
+            << std::setw(8) << r.config.rounds << std::setw(14) << r.traffic.read_bytes << std::setw(14) << r.traffic.write_bytes
+            << std::setw(12) << std::fixed << std::setprecision(1) << r.bare_time
+            << std::setw(12) << r.bare_latency.percentile(50) / 1e3 << std::setw(12) << r.bare_latency.percentile(99) / 1e3
+            << std::setw(12) << r.runlist_time
+            << std::setw(10) << std::setprecision(2) << r.bandwidth
+            << std::setw(10) << (r.runlist_stats.mean > 0 ? 100.0 * r.runlist_stats.ci_half_width / r.runlist_stats.mean : 0.0)
+            << std::setw(10) << r.runlist_stats.samples
+            << std::setw(8) << (!r.integrity.enabled ? "-" : r.integrity.ok ? "ok" : "FAIL"));
+    }
+    MSG_BONDLINE(width);
+}
+
+}
+#endif
@@ -15,117 +15,387 @@
 #include "npu_utils.hpp"
 #include "vm_args.hpp"
 #include "utils.hpp"
+#include "bwbench.hpp"
+#include "launchbench.hpp"
+#include "allocbench.hpp"
+#include "opsbench.hpp"
+#include "relayoutbench.hpp"
+#include "instrbench.hpp"
+#include "qosbench.hpp"
+#include "result_writer.hpp"
+#ifdef __XRT__
 #include "experimental/xrt_kernel.h"
-#include "experimental/xrt_queue.h"
+#endif
 
 namespace po = boost::program_options;
 
-int main(int argc, const char *argv[]) {
-    // Fix the seed to ensure reproducibility in CI.
-    srand(0);
-    // Program arguments parsing
-    po::options_description desc("Allowed options");
-    po::variables_map vm;
-    arg_utils::add_default_options(desc);
+bwbench_result run_point(npu_app& npu_instance, const bwbench_config& cfg, const std::string& device, int Iterations, int TraceLength,
+    const adaptive_config& adaptive, int stream_depth, int stream_items, const std::string& pattern, const amdxdna_qos_info& qos){
+    accel_user_desc accel_desc = bwbench::resolve_artifacts(cfg, device, npu_instance.get_backend());
+    accel_desc.qos = qos;
+    header_print("info", "Point " << bwbench::name(cfg) << ": " << accel_desc.instr_name);
 
-    // Add custom options
-    desc.add_options()("I,i", po::value<int>()->default_value(0), "Iterations");
-    desc.add_options()("T,t", po::value<int>()->default_value(4), "Trace length");
-
-    arg_utils::parse_options(argc, argv, desc, vm);
-    
-    // User logic
-    int Iterations = vm["I"].as<int>();
-    int TraceLength = vm["T"].as<int>();
+    int app_id = npu_instance.register_accel_app(accel_desc);
+    // npu_instance.interperate_bd(app_id);
 
-    // NPU instance
-    npu_app npu_instance(1, 1, 0);
-    if (VERBOSE >= 1){
-        npu_instance.get_npu_power(true);
-        npu_instance.print_npu_info();
+    bwbench_result result = {cfg, npu_instance.get_ddr_traffic(app_id), 0.0, 0.0, 0.0};
+    // The moved bytes come from the instruction sequence, so they always match the design.
+    size_t expected_bytes = (size_t)cfg.rounds * cfg.token_rate * cfg.burst_size * 2 * cfg.use_cols * sizeof(dtype);
+    if (result.traffic.read_bytes != expected_bytes){
+        header_print("warning", "Instruction sequence reads " << result.traffic.read_bytes << " bytes, expected " << expected_bytes);
     }
 
-    accel_user_desc accel_desc = {
-        .xclbin_name = "build/xclbins/bwbench.xclbin",
-        .instr_name = "build/insts/bwbench.txt",
-    };
-
-    int app_id = npu_instance.register_accel_app(accel_desc);
-
-    npu_instance.print_npu_info();
-    npu_instance.list_kernels();
-    // npu_instance.interperate_bd(0);
-
-    const int use_cols = 4;
-    const int token_rate = 32;
-    const int burst_size = 1024;
-    const int rounds = 4;
-    const int A_size = use_cols * burst_size * token_rate * 2;
-    const int C_size = use_cols * burst_size;
+    const int A_size = bwbench::A_size(cfg);
+    const int C_size = bwbench::C_size(cfg);
     const int T_size = TraceLength / 4;
 
-    
-    buffer<uint32_t> A = npu_instance.create_bo_buffer<uint32_t>(A_size, 3, app_id);
-    buffer<uint32_t> C = npu_instance.create_bo_buffer<uint32_t>(C_size, 4, app_id);
-    buffer<uint32_t> T = npu_instance.create_bo_buffer<uint32_t>(T_size, 5, app_id);
+    buffer<dtype> A = npu_instance.create_bo_buffer<dtype>(A_size, 3, app_id);
+    buffer<dtype> C = npu_instance.create_bo_buffer<dtype>(C_size, 4, app_id);
+    buffer<dtype> T = npu_instance.create_bo_buffer<dtype>(T_size, 5, app_id);
+    npu_instance.get_bo_registry().tag(T.bo(), "trace");
 
-    A.memset(0);
-    C.memset(0);
+    // With a data pattern the input is patterned and the output holds a canary, else both are zeroed
+    data_pattern input_pattern = {};
+    if (!pattern.empty()){
+        input_pattern = bwbench::input_pattern(cfg, parse_pattern_kind(pattern));
+        data_patterns::fill(A.data(), A.size(), input_pattern);
+        data_patterns::fill(C.data(), C.size(), bwbench::canary);
+    }
+    else{
+        A.memset(0);
+        C.memset(0);
+    }
     T.memset(0);
 
     A.sync_to_device();
     C.sync_to_device();
     T.sync_to_device();
 
-	
     header_print("info", "Running runtime test.");
     header_print("info", "Running kernel with bare call.");
     time_utils::time_with_unit npu_time = {0.0, "us"};
-	
-    auto run = npu_instance.create_run(A.bo(), C.bo(), T.bo(), app_id);
-    time_utils::time_point start = time_utils::now();
-    run.start();
-    run.wait();
-    time_utils::time_point stop = time_utils::now();
-    npu_time.first += time_utils::duration_us(start, stop).first;
+
+    // Every completion is timestamped and recorded on its own, warm-up runs are discarded
+    auto run = npu_instance.create_run(app_id, A, C, T);
+    auto bare_call = [&](bool warmup){
+        time_utils::time_point start = time_utils::now();
+        run.start();
+        time_utils::time_point submitted = time_utils::now();
+        run.wait();
+        time_utils::time_point stop = time_utils::now();
+        uint64_t ns = time_utils::duration_ns(start, stop);
+        if (!warmup){
+            result.bare_latency.record(ns);
+            result.bare_submit.record(time_utils::duration_ns(start, submitted));
+        }
+        return (double)ns;
+    };
+    if (Iterations > 0){
+        result.bare_stats = run_adaptive(adaptive, bare_call);
+        utils::print_adaptive(result.bare_stats, "Bare call", "ns");
+    }
+    else{
+        bare_call(false);
+    }
+    npu_time.first = result.bare_latency.mean() / 1e3;
     header_print("info", "Finished running kernel");
     MSG_BONDLINE(40);
     MSG_BOX_LINE(40, "NPU time with bare call: " << npu_time.first << " us");
     MSG_BONDLINE(40);
+    result.bare_time = npu_time.first;
+    if (Iterations > 0){
+        utils::print_latency(result.bare_latency, "Bare call latency");
+        utils::print_latency(result.bare_submit, "Bare call submission");
+    }
 
 
     // run with runlist
     if (Iterations > 0){
         header_print("info", "Benchmarking!");
-        const int statistic_minimal = 512;
-        int current_iter = 0;
-        int total_iter = std::max(Iterations, statistic_minimal);
-        npu_time.first = 0;
-        while (current_iter < total_iter){
-            auto runlist = npu_instance.create_runlist(app_id);
-            for (int i = 0; i < Iterations; i++){
-                runlist.add(npu_instance.create_run(A.bo(), C.bo(), T.bo(), app_id));
-            }
+        // The runs are created and bound once, every batch resubmits the same runlist
+        time_utils::time_point setup_start = time_utils::now();
+        npu_run_pool pool = npu_instance.create_run_pool(Iterations, A.bo(), C.bo(), T.bo(), app_id);
+        result.pool_setup_time = time_utils::duration_ns(setup_start, time_utils::now()) / 1e3;
+        // One sample is the bandwidth of a batch of Iterations runs
+        auto runlist_batch = [&](bool warmup){
             time_utils::time_point start = time_utils::now();
-            runlist.execute();
-            runlist.wait();
+            pool.execute();
+            time_utils::time_point submitted = time_utils::now();
+            pool.wait();
             time_utils::time_point stop = time_utils::now();
-            npu_time.first += time_utils::duration_us(start, stop).first;
-            current_iter += Iterations;
-            utils::print_progress_bar(std::cout, current_iter / (float)total_iter, 40);
-        }
-        std::cout << std::endl;
-        npu_time.first /= current_iter;
-        float achieved_bandwidth = rounds * token_rate * burst_size * 2 * use_cols * 4; // total bytes read from DDR
-        achieved_bandwidth = achieved_bandwidth / (npu_time.first / 1e6); // bytes per second
-        achieved_bandwidth = achieved_bandwidth / 1024 / 1024 / 1024; // GiB/s
+            uint64_t ns = time_utils::duration_ns(start, stop);
+            double bandwidth = (double)result.traffic.read_bytes * Iterations / ns * 1e9 / 1024 / 1024 / 1024; // GiB/s
+            if (!warmup){
+                result.runlist_latency.record(ns);
+                result.runlist_submit.record(time_utils::duration_ns(start, submitted));
+                result.bandwidth_samples.push_back(bandwidth);
+            }
+            return bandwidth;
+        };
+        result.runlist_stats = run_adaptive(adaptive, runlist_batch);
+        utils::print_adaptive(result.runlist_stats, "Runlist bandwidth", "GiB/s");
+        npu_time.first = result.runlist_latency.mean() / 1e3 / Iterations;
+        float achieved_bandwidth = result.runlist_stats.mean;
         MSG_BONDLINE(40);
         MSG_BOX_LINE(40, "NPU time with runlist: " << npu_time.first << " us");
         MSG_BOX_LINE(40, "Achieved bandwidth   : " << achieved_bandwidth << " GiB/s");
+        MSG_BOX_LINE(40, "Submit per run       : " << result.runlist_submit.mean() / Iterations << " ns");
+        MSG_BOX_LINE(40, "Run pool setup       : " << result.pool_setup_time << " us");
         MSG_BONDLINE(40);
+        result.runlist_time = npu_time.first;
+        result.bandwidth = achieved_bandwidth;
+        utils::print_latency(result.runlist_latency, "Runlist batch of " + std::to_string(Iterations));
+        utils::print_latency(result.runlist_submit, "Runlist submission");
         C.sync_from_device();    
         T.sync_from_device();
     }
 
+    if (!pattern.empty()){
+        result.integrity = bwbench::check_integrity(cfg, input_pattern, A, C, npu_instance.get_backend());
+        bwbench::print_integrity(result.integrity);
+        if (!result.integrity.ok){
+            header_print("warning", "Data of " << bwbench::name(cfg) << " is corrupted, its bandwidth does not count");
+        }
+    }
+
+    // Sustained throughput with host copies, the inputs are refilled and the outputs drained for every run
+    if (stream_depth > 0){
+        header_print("info", "Streaming with " << stream_depth << " buffer sets.");
+        std::vector<dtype> host_in(A_size);
+        std::vector<dtype> host_out(C_size);
+        for (int i = 0; i < A_size; i++){
+            host_in[i] = i;
+        }
+        stream_pipeline<dtype, dtype> stream(npu_instance, app_id, stream_depth, A_size, C_size, &T.bo());
+        result.stream = stream.run(stream_items,
+            [&](buffer<dtype>& in, size_t item){ in.copy_from(host_in); },
+            [&](buffer<dtype>& out, size_t item){ std::memcpy(host_out.data(), out.data(), C_size * sizeof(dtype)); });
+        utils::print_stream(result.stream);
+    }
+
+    return result;
+}
+
+std::vector<result_writer> open_writers(po::variables_map& vm){
+    std::vector<result_writer> writers;
+    if (!vm["json"].as<std::string>().empty()){
+        writers.emplace_back(vm["json"].as<std::string>(), result_format_json);
+    }
+    if (!vm["csv"].as<std::string>().empty()){
+        writers.emplace_back(vm["csv"].as<std::string>(), result_format_csv);
+    }
+    return writers;
+}
+
+// Writes one record per result to every --json/--csv file
+template<typename R, typename F>
+void write_records(po::variables_map& vm, const std::vector<R>& results, F make_record){
+    std::vector<result_writer> writers = open_writers(vm);
+    for (const R& r : results){
+        result_record record = make_record(r);
+        for (result_writer& writer : writers){
+            writer.write(record);
+        }
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    // Fix the seed to ensure reproducibility in CI.
+    srand(0);
+    // Program arguments parsing
+    po::options_description desc("Allowed options");
+    po::variables_map vm;
+    arg_utils::add_default_options(desc);
+
+    // Add custom options
+    desc.add_options()("I,i", po::value<int>()->default_value(0), "Iterations");
+    desc.add_options()("T,t", po::value<int>()->default_value(4), "Trace length");
+    // Sweep ranges: "4", "1,2,4", "1:8" (doubling) or "8:64:8" (linear)
+    desc.add_options()("cols", po::value<std::string>()->default_value("4"), "Columns to sweep");
+    desc.add_options()("burst", po::value<std::string>()->default_value("1024"), "Burst sizes (words) to sweep");
+    desc.add_options()("token_rate", po::value<std::string>()->default_value("32"), "Token rates to sweep");
+    desc.add_options()("rounds", po::value<std::string>()->default_value("4"), "Rounds to sweep");
+    // Adaptive stopping, -i sets the runlist batch size
+    desc.add_options()("tolerance", po::value<double>()->default_value(default_adaptive_config.tolerance), "Relative 95% confidence interval to stop at");
+    desc.add_options()("budget", po::value<double>()->default_value(default_adaptive_config.time_budget), "Time budget per measurement (s)");
+    desc.add_options()("stream", po::value<int>()->default_value(0), "Buffer sets of the streaming run, 0 to skip it");
+    desc.add_options()("stream_items", po::value<int>()->default_value(256), "Items of the streaming run");
+    desc.add_options()("no_bo_pool", po::bool_switch()->default_value(false), "Allocate every BO directly instead of from the pool");
+    desc.add_options()("load_threads", po::value<int>()->default_value(0), "Threads loading the xclbins of the sweep at startup, 0 for up to 8");
+    desc.add_options()("defer_contexts", po::bool_switch()->default_value(false), "Create hardware contexts on the first run instead of at startup");
+    desc.add_options()("launch", po::bool_switch()->default_value(false), "Run the submission path microbenchmark instead of the sweep");
+    desc.add_options()("launch_samples", po::value<int>()->default_value(default_launch_config.samples), "Timed launches per submission path");
+    desc.add_options()("launch_warmup", po::value<int>()->default_value(default_launch_config.warmup), "Untimed launches before the samples of each submission path");
+    desc.add_options()("alloc", po::bool_switch()->default_value(false), "Run the host allocation policy benchmark instead of the sweep");
+    desc.add_options()("numa_node", po::value<int>()->default_value(-1), "NUMA node to also bind allocations to in the allocation benchmark");
+    desc.add_options()("ops", po::bool_switch()->default_value(false), "Run the host fill/copy/compare benchmark instead of the sweep");
+    desc.add_options()("ops_mb", po::value<int>()->default_value(256), "Buffer size of the host fill/copy/compare benchmark (MiB)");
+    desc.add_options()("relayout", po::bool_switch()->default_value(false), "Run the host relayout versus DMA striding benchmark instead of the sweep");
+    desc.add_options()("instr_load", po::bool_switch()->default_value(false), "Run the instruction loading cold start benchmark instead of the sweep");
+    desc.add_options()("qos", po::value<std::string>()->default_value("default"), "QoS of the sweep contexts, e.g. priority=low,gops=1000, default or none");
+    desc.add_options()("qos_sweep", po::bool_switch()->default_value(false), "Run the QoS impact benchmark instead of the sweep");
+    desc.add_options()("qos_settings", po::value<std::string>()->default_value(""), "';' separated QoS settings of the QoS benchmark, empty for the defaults");
+    desc.add_options()("qos_competitor", po::value<std::string>()->default_value(qosbench::default_competitor), "QoS of the competing context of the QoS benchmark");
+    desc.add_options()("qos_runs", po::value<int>()->default_value(500), "Timed runs per QoS setting and mode");
+    desc.add_options()("pattern", po::value<std::string>()->default_value(""), "Fill inputs with a data pattern (index, prbs or column) and verify the transfers");
+    desc.add_options()("json", po::value<std::string>()->default_value(""), "Append results as JSON lines to this file");
+    desc.add_options()("csv", po::value<std::string>()->default_value(""), "Append results as CSV rows to this file");
+    desc.add_options()("min_samples", po::value<int>()->default_value(default_adaptive_config.min_samples), "Minimal number of samples after warm-up");
+
+    arg_utils::parse_options(argc, argv, desc, vm);
+    
+    // User logic
+    int Iterations = vm["I"].as<int>();
+    int TraceLength = vm["T"].as<int>();
+    std::string device = vm["device"].as<std::string>();
+    adaptive_config adaptive = default_adaptive_config;
+    adaptive.tolerance = vm["tolerance"].as<double>();
+    adaptive.time_budget = vm["budget"].as<double>();
+    adaptive.min_samples = vm["min_samples"].as<int>();
+    std::vector<bwbench_config> points;
+    try {
+        std::vector<int> cols = bwbench::parse_range(vm["cols"].as<std::string>());
+        bwbench::check_columns(cols, device);
+        points = bwbench::make_points(cols,
+            bwbench::parse_range(vm["burst"].as<std::string>()),
+            bwbench::parse_range(vm["token_rate"].as<std::string>()),
+            bwbench::parse_range(vm["rounds"].as<std::string>())
+        );
+    } catch (const std::exception &ex) {
+        arg_utils::usage_error(desc, ex.what());
+    }
+
+    if (vm["launch"].as<bool>()){
+        launch_config launch = default_launch_config;
+        launch.samples = vm["launch_samples"].as<int>();
+        launch.warmup = vm["launch_warmup"].as<int>();
+        if (launch.samples < 1 || launch.warmup < 0){
+            arg_utils::usage_error(desc, "--launch_samples must be at least 1 and --launch_warmup at least 0");
+        }
+        npu_app npu_instance(1, 1, 0, parse_npu_backend(vm["backend"].as<std::string>()));
+        npu_instance.print_npu_info();
+        int app_id = launchbench::register_nop(npu_instance, device);
+        const bwbench_config& cfg = bwbench::default_config;
+        buffer<dtype> A = npu_instance.create_bo_buffer<dtype>(bwbench::A_size(cfg), 3, app_id);
+        buffer<dtype> C = npu_instance.create_bo_buffer<dtype>(bwbench::C_size(cfg), 4, app_id);
+        buffer<dtype> T = npu_instance.create_bo_buffer<dtype>(TraceLength / 4, 5, app_id);
+        header_print("info", "Running submission path microbenchmark.");
+        std::vector<launch_result> results = launchbench::run_suite(npu_instance, app_id, A.bo(), C.bo(), T.bo(), launch);
+        launchbench::print_results(results);
+        result_context context = {device, Iterations, TraceLength, adaptive, npu_instance.get_environment()};
+        write_records(vm, results, [&](const launch_result& r){ return make_launch_record(r, context); });
+        return 0;
+    }
+
+    if (vm["ops"].as<bool>()){
+        size_t bytes = (size_t)vm["ops_mb"].as<int>() << 20;
+        header_print("info", "Running host buffer ops benchmark with " << simd_level_name(detect_simd_level()) << ".");
+        std::vector<ops_result> results = opsbench::run_suite(bytes);
+        opsbench::print_results(results, bytes);
+        std::unique_ptr<npu_device> npu = create_npu_device(parse_npu_backend(vm["backend"].as<std::string>()));
+        result_context context = {device, Iterations, TraceLength, adaptive, query_npu_environment(*npu)};
+        write_records(vm, results, [&](const ops_result& r){ return make_ops_record(r, bytes, context); });
+        return 0;
+    }
+
+    if (vm["alloc"].as<bool>()){
+        if (vm["numa_node"].as<int>() >= 64){
+            arg_utils::usage_error(desc, "--numa_node must be below 64");
+        }
+        npu_app npu_instance(1, 1, 0, parse_npu_backend(vm["backend"].as<std::string>()));
+        npu_instance.print_npu_info();
+        const bwbench_config& cfg = bwbench::default_config;
+        accel_user_desc accel_desc = bwbench::resolve_artifacts(cfg, device, npu_instance.get_backend());
+        int app_id = npu_instance.register_accel_app(accel_desc);
+        buffer<dtype> C = npu_instance.create_bo_buffer<dtype>(bwbench::C_size(cfg), 4, app_id);
+        buffer<dtype> T = npu_instance.create_bo_buffer<dtype>(TraceLength / 4, 5, app_id);
+        header_print("info", "Running host allocation policy benchmark.");
+        std::vector<alloc_result> results = allocbench::run_suite(npu_instance, app_id, bwbench::A_size(cfg), C.bo(), T.bo(),
+            npu_instance.get_ddr_traffic(app_id).read_bytes, std::max(Iterations, 16), vm["numa_node"].as<int>());
+        allocbench::print_results(results);
+        result_context context = {device, Iterations, TraceLength, adaptive, npu_instance.get_environment()};
+        write_records(vm, results, [&](const alloc_result& r){ return make_alloc_record(r, context); });
+        return 0;
+    }
+
+    if (vm["relayout"].as<bool>()){
+        npu_app npu_instance(1, 1, 0, parse_npu_backend(vm["backend"].as<std::string>()));
+        npu_instance.print_npu_info();
+        const bwbench_config& cfg = bwbench::default_config;
+        accel_user_desc accel_desc = bwbench::resolve_artifacts(cfg, device, npu_instance.get_backend());
+        int app_id = npu_instance.register_accel_app(accel_desc);
+        buffer<dtype> C = npu_instance.create_bo_buffer<dtype>(bwbench::C_size(cfg), 4, app_id);
+        buffer<dtype> T = npu_instance.create_bo_buffer<dtype>(TraceLength / 4, 5, app_id);
+        header_print("info", "Running host relayout benchmark with " << simd_level_name(detect_simd_level()) << ".");
+        std::vector<relayout_result> results = relayoutbench::run_suite(npu_instance, app_id, bwbench::A_size(cfg), C.bo(), T.bo(),
+            npu_instance.get_ddr_traffic(app_id).read_bytes, std::max(Iterations, 16));
+        relayoutbench::print_results(results);
+        result_context context = {device, Iterations, TraceLength, adaptive, npu_instance.get_environment()};
+        write_records(vm, results, [&](const relayout_result& r){ return make_relayout_record(r, context); });
+        return 0;
+    }
+
+    if (vm["instr_load"].as<bool>()){
+        npu_backend backend = parse_npu_backend(vm["backend"].as<std::string>());
+        header_print("info", "Running instruction loading benchmark.");
+        std::vector<instr_load_result> results = instrbench::run_suite(backend, device);
+        instrbench::print_results(results);
+        std::unique_ptr<npu_device> npu = create_npu_device(backend);
+        result_context context = {device, Iterations, TraceLength, adaptive, query_npu_environment(*npu)};
+        write_records(vm, results, [&](const instr_load_result& r){ return make_instr_load_record(r, context); });
+        return 0;
+    }
+
+    if (vm["qos_sweep"].as<bool>()){
+        npu_app npu_instance(1, 1, 0, parse_npu_backend(vm["backend"].as<std::string>()));
+        npu_instance.print_npu_info();
+        header_print("info", "Running QoS impact benchmark.");
+        std::vector<qos_result> results = qosbench::run_suite(npu_instance, device, qosbench::parse_settings(vm["qos_settings"].as<std::string>()),
+            vm["qos_competitor"].as<std::string>(), TraceLength / 4, vm["qos_runs"].as<int>());
+        qosbench::print_results(results);
+        result_context context = {device, Iterations, TraceLength, adaptive, npu_instance.get_environment()};
+        write_records(vm, results, [&](const qos_result& r){ return make_qos_record(r, context); });
+        return 0;
+    }
+
+    // NPU instance, one xclbin and one instruction sequence per point
+    npu_app npu_instance(points.size(), points.size(), 0, parse_npu_backend(vm["backend"].as<std::string>()));
+    npu_instance.get_bo_pool().set_enabled(!vm["no_bo_pool"].as<bool>());
+    if (VERBOSE >= 1){
+        npu_instance.get_npu_power(true);
+        npu_instance.print_npu_info();
+    }
+    npu_instance.print_npu_info();
+
+    // All points are registered up front, their xclbins load concurrently
+    npu_instance.set_startup_config({vm["load_threads"].as<int>(), vm["defer_contexts"].as<bool>()});
+    amdxdna_qos_info qos = parse_npu_qos(vm["qos"].as<std::string>());
+    std::vector<accel_user_desc> descs;
+    for (const bwbench_config& cfg : points){
+        descs.push_back(bwbench::resolve_artifacts(cfg, device, npu_instance.get_backend()));
+        descs.back().qos = qos;
+    }
+    npu_instance.register_accel_apps(descs);
+
+    // Structured output, written as soon as a point finishes
+    result_context context = {device, Iterations, TraceLength, adaptive, npu_instance.get_environment()};
+    std::vector<result_writer> writers = open_writers(vm);
+
+    std::vector<bwbench_result> results;
+    for (const bwbench_config& cfg : points){
+        results.push_back(run_point(npu_instance, cfg, device, Iterations, TraceLength, adaptive,
+            vm["stream"].as<int>(), vm["stream_items"].as<int>(), vm["pattern"].as<std::string>(), qos));
+        result_record record = make_record(results.back(), context);
+        for (result_writer& writer : writers){
+            writer.write(record);
+        }
+    }
+    npu_instance.print_registrations();
+    utils::print_bo_pool(npu_instance.get_bo_pool().stats());
+    npu_instance.get_bo_registry().print_report(VERBOSE >= 1);
+    if (results.size() > 1){
+        bwbench::print_results(results);
+    }
+
     return 0;
 }
\ No newline at end of file
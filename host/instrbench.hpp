@@ -0,0 +1,154 @@
+#ifndef __INSTRBENCH_HPP__
+#define __INSTRBENCH_HPP__
+#include <algorithm>
+#include <filesystem>
+#include "typedef.hpp"
+#include "npu_utils.hpp"
+#include "utils.hpp"
+#include "bwbench.hpp"
+
+// Instruction loading cold start.
+// Large sequences are written as binary and as text files, then loaded three ways: the former
+// path that read the file into a vector (one getline and istringstream per text word) and
+// copied it, instr_file mapping the file and copying or parsing it straight into the
+// destination, and a complete registration on a fresh npu_app, which adds the BO allocation
+// and the sync. Each time is the median of reps loads. The files were just written, so they
+// are read from the page cache; a first start after boot adds the storage read on top. They
+// are written to a scratch directory, which is removed with them at the end.
+
+typedef struct {
+    std::string format;
+    size_t words;
+    size_t file_bytes;
+    double legacy_time;   // us, read into a vector, then copy
+    double mapped_time;   // us, map and copy or parse into the destination
+    double register_time; // us, instruction part of a cold registration
+    double speedup;       // legacy_time / mapped_time
+    double mapped_mbps;   // file MB/s of the mapped path
+} instr_load_result;
+
+namespace instrbench {
+
+const size_t default_sizes[] = {16 << 10, 256 << 10, 4 << 20, 16 << 20}; // sequence bytes
+
+// The default bwbench sequence repeated to words words, so the file holds real commands
+inline std::vector<uint32_t> make_sequence(const std::string& device, size_t words){
+    std::vector<uint32_t> body = bwbench::generate_sequence(bwbench::default_config, device);
+    size_t header = bwbench::sequence_header(device).size();
+    std::vector<uint32_t> seq(body.begin(), body.begin() + header);
+    while (seq.size() < words){
+        seq.insert(seq.end(), body.begin() + header, body.begin() + std::min(body.size(), header + words - seq.size()));
+    }
+    return seq;
+}
+
+inline void write_text(const std::vector<uint32_t>& seq, const std::string& path){
+    std::ofstream file(path);
+    if (!file){
+        throw std::runtime_error("Unable to write instruction file: " + path);
+    }
+    char line[10];
+    for (uint32_t word : seq){
+        snprintf(line, sizeof(line), "%08x\n", word);
+        file.write(line, 9);
+    }
+}
+
+// The former loader, kept as the baseline
+inline size_t legacy_load(const std::string& path, instr_format format, uint32_t* out){
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint32_t> instr_v;
+    if (format == instr_format_binary){
+        file.seekg(0, std::ios::end);
+        size_t size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        instr_v.resize(size / 4);
+        file.read(reinterpret_cast<char*>(instr_v.data()), size);
+    }
+    else{
+        std::string line;
+        while (std::getline(file, line)){
+            std::istringstream iss(line);
+            uint32_t a;
+            if (!(iss >> std::hex >> a)){
+                throw std::runtime_error("Unable to parse instruction file\n");
+            }
+            instr_v.push_back(a);
+        }
+    }
+    memcpy(out, instr_v.data(), instr_v.size() * sizeof(uint32_t));
+    return instr_v.size();
+}
+
+inline double median_us(int reps, const std::function<double()>& f){
+    std::vector<double> us;
+    for (int i = 0; i < reps; i++){
+        us.push_back(f());
+    }
+    std::nth_element(us.begin(), us.begin() + reps / 2, us.end());
+    return us[reps / 2];
+}
+
+inline std::vector<instr_load_result> run_suite(npu_backend backend, const std::string& device, int reps = 5){
+    const accel_user_desc base = bwbench::resolve_artifacts(bwbench::default_config, device, backend);
+    utils::temp_dir scratch("instrbench");
+    std::vector<instr_load_result> results;
+    for (size_t bytes : default_sizes){
+        std::vector<uint32_t> seq = make_sequence(device, bytes / sizeof(uint32_t));
+        std::string name = scratch.file("instr_load_" + std::to_string(bytes >> 10) + "k");
+        bwbench::write_sequence(seq, name + ".bin");
+        write_text(seq, name + ".hex");
+        std::vector<uint32_t> dest(seq.size(), 0);
+        for (instr_format format : {instr_format_binary, instr_format_text}){
+            std::string path = name + (format == instr_format_binary ? ".bin" : ".hex");
+            double legacy = median_us(reps, [&](){
+                time_utils::time_point start = time_utils::now();
+                legacy_load(path, format, dest.data());
+                return time_utils::duration_ns(start, time_utils::now()) / 1e3;
+            });
+            double mapped = median_us(reps, [&](){
+                time_utils::time_point start = time_utils::now();
+                instr_file file(path, format);
+                file.read(dest.data(), dest.size());
+                return time_utils::duration_ns(start, time_utils::now()) / 1e3;
+            });
+            if (!std::equal(seq.begin(), seq.end(), dest.begin())){
+                throw std::runtime_error("Loading " + path + " does not reproduce the sequence");
+            }
+            double registration = median_us(reps, [&](){
+                npu_app npu_instance(1, 1, 0, backend);
+                npu_instance.register_accel_app({base.xclbin_name, path, format});
+                return npu_instance.get_registrations().back().instr_time;
+            });
+            size_t file_bytes = std::filesystem::file_size(path);
+            results.push_back({instr_format_name(format), seq.size(), file_bytes, legacy, mapped, registration,
+                mapped > 0 ? legacy / mapped : 0.0, mapped > 0 ? file_bytes / mapped : 0.0});
+        }
+        // only one size is on disk at a time
+        std::filesystem::remove(name + ".bin");
+        std::filesystem::remove(name + ".hex");
+    }
+    return results;
+}
+
+inline void print_results(const std::vector<instr_load_result>& results){
+    const int width = 96;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::left << std::setw(8) << "format" << std::right << std::setw(10) << "words" << std::setw(12) << "file"
+        << std::setw(12) << "vector" << std::setw(12) << "mapped" << std::setw(10) << "speedup" << std::setw(12) << "mapped"
+        << std::setw(14) << "registration");
+    MSG_BOX_LINE(width, std::left << std::setw(8) << "" << std::right << std::setw(10) << "" << std::setw(12) << "(KiB)"
+        << std::setw(12) << "(us)" << std::setw(12) << "(us)" << std::setw(10) << "" << std::setw(12) << "(MB/s)"
+        << std::setw(14) << "(us)");
+    MSG_BONDLINE(width);
+    for (const instr_load_result& r : results){
+        MSG_BOX_LINE(width, std::left << std::setw(8) << r.format << std::right << std::setw(10) << r.words << std::fixed
+            << std::setprecision(1) << std::setw(12) << r.file_bytes / 1024.0 << std::setw(12) << r.legacy_time
+            << std::setw(12) << r.mapped_time << std::setprecision(2) << std::setw(10) << r.speedup << std::setprecision(0)
+            << std::setw(12) << r.mapped_mbps << std::setprecision(1) << std::setw(14) << r.register_time);
+    }
+    MSG_BONDLINE(width);
+}
+
+}
+#endif
@@ -0,0 +1,313 @@
+#ifndef __LAUNCHBENCH_HPP__
+#define __LAUNCHBENCH_HPP__
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include "typedef.hpp"
+#include "npu_utils.hpp"
+#include "utils.hpp"
+#include "bwbench.hpp"
+#ifdef __XRT__
+#include "experimental/xrt_queue.h"
+#endif
+
+// Submission path microbenchmark.
+// An instruction sequence without operations makes every run launch bound, so the measured
+// times are the cost of the launch path itself. All paths use the same methodology: warmup
+// launches are discarded, then samples launches are timed one by one and the phases of each
+// launch are recorded in ns per launch.
+
+typedef struct {
+    std::string path;
+    std::string phase;
+    int batch;                 // launches per submission
+    latency_histogram latency; // ns per launch
+    double throughput;         // launches per second, total phase only
+} launch_result;
+
+typedef struct {
+    int samples;
+    int warmup;
+    std::vector<int> runlist_sizes;
+} launch_config;
+
+const launch_config default_launch_config = {1000, 100, {1, 4, 16, 64}};
+
+#ifdef __XRT__
+typedef xrt::queue launch_queue;
+#else
+// In order host task queue with the enqueue()/wait() interface of xrt::queue
+class launch_queue{
+private:
+    std::mutex lock;
+    std::condition_variable cv;
+    std::deque<std::packaged_task<void()>> tasks;
+    bool stop;
+    std::thread worker;
+
+public:
+    launch_queue() : stop(false){
+        worker = std::thread([this](){
+            while (true){
+                std::packaged_task<void()> task;
+                {
+                    std::unique_lock<std::mutex> guard(lock);
+                    cv.wait(guard, [this](){ return stop || !tasks.empty(); });
+                    if (tasks.empty()){
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        });
+    }
+
+    ~launch_queue(){
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            stop = true;
+        }
+        cv.notify_one();
+        worker.join();
+    }
+
+    template<typename F>
+    std::shared_future<void> enqueue(F&& f){
+        std::packaged_task<void()> task(std::forward<F>(f));
+        std::shared_future<void> event = task.get_future().share();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            tasks.push_back(std::move(task));
+        }
+        cv.notify_one();
+        return event;
+    }
+};
+#endif
+
+namespace launchbench {
+
+// Registers the no-op sequence with the xclbin of the default bwbench point. The sequence is
+// copied into its BO on registration, so its file only lives in a scratch directory meanwhile.
+inline int register_nop(npu_app& npu_instance, const std::string& device){
+    accel_user_desc desc = bwbench::resolve_artifacts(bwbench::default_config, device, npu_instance.get_backend());
+    utils::temp_dir scratch("launchbench");
+    desc.instr_name = scratch.file("launch_nop.txt");
+    bwbench::write_sequence(bwbench::sequence_header(device), desc.instr_name);
+    return npu_instance.register_accel_app(desc);
+}
+
+inline launch_result make_result(const std::string& path, const std::string& phase, int batch){
+    return {path, phase, batch, latency_histogram(), 0.0};
+}
+
+inline double throughput(const latency_histogram& total){
+    return total.mean() > 0.0 ? 1e9 / total.mean() : 0.0;
+}
+
+inline std::vector<launch_result> run_suite(npu_app& npu_instance, int app_id, npu_bo& In0, npu_bo& In1, npu_bo& Out0, const launch_config& cfg){
+    std::vector<launch_result> results;
+    auto timed = [](auto&& f){
+        time_utils::time_point start = time_utils::now();
+        f();
+        return time_utils::duration_ns(start, time_utils::now());
+    };
+
+    // Blocking npu_app::run, a new run is bound for every call
+    {
+        launch_result total = make_result("blocking run", "total", 1);
+        for (int i = 0; i < cfg.warmup + cfg.samples; i++){
+            uint64_t ns = timed([&](){ npu_instance.run(In0, In1, Out0, app_id); });
+            if (i >= cfg.warmup){
+                total.latency.record(ns);
+            }
+        }
+        total.throughput = throughput(total.latency);
+        results.push_back(total);
+    }
+
+    // Async start/wait with a new run per launch, every phase apart
+    {
+        launch_result create = make_result("async new run", "create_run", 1);
+        launch_result set_arg = make_result("async new run", "set_arg", 1);
+        launch_result start = make_result("async new run", "start", 1);
+        launch_result wait = make_result("async new run", "wait", 1);
+        launch_result total = make_result("async new run", "total", 1);
+        for (int i = 0; i < cfg.warmup + cfg.samples; i++){
+            time_utils::time_point t0 = time_utils::now();
+            npu_run run = npu_instance.create_unbound_run(app_id);
+            time_utils::time_point t1 = time_utils::now();
+            npu_instance.bind_instr(run, app_id);
+            run.set_arg(3, In0);
+            run.set_arg(4, In1);
+            run.set_arg(5, Out0);
+            time_utils::time_point t2 = time_utils::now();
+            run.start();
+            time_utils::time_point t3 = time_utils::now();
+            run.wait();
+            time_utils::time_point t4 = time_utils::now();
+            if (i >= cfg.warmup){
+                create.latency.record(time_utils::duration_ns(t0, t1));
+                set_arg.latency.record(time_utils::duration_ns(t1, t2));
+                start.latency.record(time_utils::duration_ns(t2, t3));
+                wait.latency.record(time_utils::duration_ns(t3, t4));
+                total.latency.record(time_utils::duration_ns(t0, t4));
+            }
+        }
+        total.throughput = throughput(total.latency);
+        results.insert(results.end(), {create, set_arg, start, wait, total});
+    }
+
+    // Async start/wait on one pre-armed run
+    {
+        npu_run run = npu_instance.create_run(In0, In1, Out0, app_id);
+        launch_result start = make_result("async reused run", "start", 1);
+        launch_result wait = make_result("async reused run", "wait", 1);
+        launch_result total = make_result("async reused run", "total", 1);
+        for (int i = 0; i < cfg.warmup + cfg.samples; i++){
+            time_utils::time_point t0 = time_utils::now();
+            run.start();
+            time_utils::time_point t1 = time_utils::now();
+            run.wait();
+            time_utils::time_point t2 = time_utils::now();
+            if (i >= cfg.warmup){
+                start.latency.record(time_utils::duration_ns(t0, t1));
+                wait.latency.record(time_utils::duration_ns(t1, t2));
+                total.latency.record(time_utils::duration_ns(t0, t2));
+            }
+        }
+        total.throughput = throughput(total.latency);
+        results.insert(results.end(), {start, wait, total});
+    }
+
+    // Persistent runlists, the cost of a batch is spread over its runs
+    for (int size : cfg.runlist_sizes){
+        npu_run_pool pool = npu_instance.create_run_pool(size, In0, In1, Out0, app_id);
+        std::string path = "runlist x" + std::to_string(size);
+        launch_result execute = make_result(path, "execute", size);
+        launch_result wait = make_result(path, "wait", size);
+        launch_result total = make_result(path, "total", size);
+        int batches = std::max(1, cfg.samples / size);
+        int warmup_batches = std::max(1, cfg.warmup / size);
+        for (int i = 0; i < warmup_batches + batches; i++){
+            time_utils::time_point t0 = time_utils::now();
+            pool.execute();
+            time_utils::time_point t1 = time_utils::now();
+            pool.wait();
+            time_utils::time_point t2 = time_utils::now();
+            if (i >= warmup_batches){
+                execute.latency.record(time_utils::duration_ns(t0, t1) / size);
+                wait.latency.record(time_utils::duration_ns(t1, t2) / size);
+                total.latency.record(time_utils::duration_ns(t0, t2) / size);
+            }
+        }
+        total.throughput = throughput(total.latency);
+        results.insert(results.end(), {execute, wait, total});
+    }
+
+    // Futures, up to in_flight pre-armed runs are outstanding and reaped by npu_app's reaper thread
+    {
+        const int in_flight = 8;
+        std::vector<npu_run> runs;
+        std::vector<npu_future> futures(in_flight);
+        for (int i = 0; i < in_flight; i++){
+            runs.push_back(npu_instance.create_run(In0, In1, Out0, app_id));
+        }
+        launch_result submit = make_result("future x" + std::to_string(in_flight), "submit", 1);
+        launch_result total = make_result("future x" + std::to_string(in_flight), "total", 1);
+        time_utils::time_point start;
+        for (int i = 0; i < cfg.warmup + cfg.samples; i++){
+            if (i == cfg.warmup){
+                for (npu_future& f : futures){
+                    if (f.valid()){
+                        f.wait();
+                    }
+                }
+                start = time_utils::now();
+            }
+            npu_future& slot = futures[i % in_flight];
+            if (slot.valid()){
+                slot.wait();
+            }
+            time_utils::time_point t0 = time_utils::now();
+            slot = npu_instance.submit(runs[i % in_flight]);
+            if (i >= cfg.warmup){
+                submit.latency.record(time_utils::duration_ns(t0, time_utils::now()));
+            }
+        }
+        // fewer launches than slots leave some futures without a run
+        for (npu_future& f : futures){
+            if (f.valid()){
+                f.wait();
+            }
+        }
+        total.latency.record(time_utils::duration_ns(start, time_utils::now()) / cfg.samples);
+        total.throughput = throughput(total.latency);
+        results.insert(results.end(), {submit, total});
+    }
+
+    // Queue submission, the worker thread starts and waits on a pre-armed run
+    {
+        launch_queue queue;
+        npu_run run = npu_instance.create_run(In0, In1, Out0, app_id);
+        auto launch = [&run](){
+            run.start();
+            run.wait();
+        };
+        launch_result enqueue = make_result("queue", "enqueue", 1);
+        launch_result wait = make_result("queue", "wait", 1);
+        launch_result total = make_result("queue", "total", 1);
+        for (int i = 0; i < cfg.warmup + cfg.samples; i++){
+            time_utils::time_point t0 = time_utils::now();
+            auto event = queue.enqueue(launch);
+            time_utils::time_point t1 = time_utils::now();
+            event.wait();
+            time_utils::time_point t2 = time_utils::now();
+            if (i >= cfg.warmup){
+                enqueue.latency.record(time_utils::duration_ns(t0, t1));
+                wait.latency.record(time_utils::duration_ns(t1, t2));
+                total.latency.record(time_utils::duration_ns(t0, t2));
+            }
+        }
+        total.throughput = throughput(total.latency);
+        results.insert(results.end(), {enqueue, wait, total});
+
+        // Pipelined: all launches are queued before waiting for the last one
+        launch_result pipelined = make_result("queue pipelined", "enqueue", cfg.samples);
+        time_utils::time_point start = time_utils::now();
+        std::vector<decltype(queue.enqueue(launch))> events;
+        for (int i = 0; i < cfg.samples; i++){
+            pipelined.latency.record(timed([&](){ events.push_back(queue.enqueue(launch)); }));
+        }
+        events.back().wait();
+        pipelined.throughput = cfg.samples / (time_utils::duration_ns(start, time_utils::now()) / 1e9);
+        results.push_back(pipelined);
+    }
+    return results;
+}
+
+inline void print_results(const std::vector<launch_result>& results){
+    const int width = 100;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::left << std::setw(20) << "path" << std::setw(12) << "phase" << std::right << std::setw(7) << "batch"
+        << std::setw(12) << "mean (ns)" << std::setw(12) << "p50 (ns)" << std::setw(12) << "p99 (ns)" << std::setw(16) << "launches/s");
+    MSG_BONDLINE(width);
+    for (const launch_result& r : results){
+        std::ostringstream rate;
+        if (r.throughput > 0.0){
+            rate << std::fixed << std::setprecision(0) << r.throughput;
+        }
+        MSG_BOX_LINE(width, std::left << std::setw(20) << r.path << std::setw(12) << r.phase << std::right << std::setw(7) << r.batch
+            << std::setw(12) << std::fixed << std::setprecision(0) << r.latency.mean() << std::setw(12) << r.latency.percentile(50)
+            << std::setw(12) << r.latency.percentile(99) << std::setw(16) << rate.str());
+    }
+    MSG_BONDLINE(width);
+}
+
+}
+#endif
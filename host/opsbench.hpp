@@ -0,0 +1,148 @@
+#ifndef __OPSBENCH_HPP__
+#define __OPSBENCH_HPP__
+#include <algorithm>
+#include "typedef.hpp"
+#include "npu_utils.hpp"
+#include "utils.hpp"
+
+// Host data preparation benchmark.
+// Fill, copy and compare of two host buffers of the same size, with every SIMD level the CPU
+// supports, on one thread and on all of them, with and without non-temporal stores. The
+// plain element loop and memcpy are the baselines. float32 <-> bfloat16 conversion of the same
+// number of elements runs with every conversion kernel, the scalar one is its baseline. The
+// median of reps repetitions is reported. The threads are persistent, so the timed runs do
+// not include creating them.
+
+typedef struct {
+    std::string op;
+    std::string kernel;
+    int threads;
+    bool non_temporal;
+    double bandwidth; // GB/s of the destination, of both inputs for compare, of the float32 side for conversions
+} ops_result;
+
+namespace opsbench {
+
+inline double median_gbps(size_t bytes, int reps, const std::function<void()>& f){
+    std::vector<uint64_t> ns;
+    f(); // first touch, also starts the worker threads of buffer_ops
+    for (int i = 0; i < reps; i++){
+        time_utils::time_point start = time_utils::now();
+        f();
+        ns.push_back(time_utils::duration_ns(start, time_utils::now()));
+    }
+    std::nth_element(ns.begin(), ns.begin() + reps / 2, ns.end());
+    return ns[reps / 2] > 0 ? (double)bytes / ns[reps / 2] : 0.0;
+}
+
+inline std::vector<ops_result> run_suite(size_t bytes, int reps = 5){
+    typedef uint32_t elem;
+    size_t count = bytes / sizeof(elem);
+    bytes = count * sizeof(elem);
+    buffer<elem> a(count, default_host_alloc_policy);
+    buffer<elem> b(count, default_host_alloc_policy);
+    std::vector<ops_result> results;
+    int all = std::max(1u, std::thread::hardware_concurrency());
+
+    // Baselines
+    results.push_back({"fill", "loop", 1, false, median_gbps(bytes, reps, [&](){
+        elem* p = a.data();
+        for (size_t i = 0; i < count; i++){
+            p[i] = 7;
+        }
+    })});
+    results.push_back({"copy", "memcpy", 1, false, median_gbps(bytes, reps, [&](){
+        std::memcpy(b.data(), a.data(), bytes);
+    })});
+    results.push_back({"compare", "loop", 1, false, median_gbps(2 * bytes, reps, [&](){
+        size_t errors = 0;
+        for (size_t i = 0; i < count; i++){
+            errors += a[i] != b[i];
+        }
+        if (errors != 0){
+            throw std::runtime_error("Compare baseline found mismatches");
+        }
+    })});
+
+    std::vector<simd_level> levels = {simd_scalar};
+    simd_level best = detect_simd_level();
+    if (best >= simd_avx2){
+        levels.push_back(simd_avx2);
+    }
+    if (best >= simd_avx512){
+        levels.push_back(simd_avx512);
+    }
+    for (simd_level level : levels){
+        for (int threads : all > 1 ? std::vector<int>{1, all} : std::vector<int>{1}){
+            for (bool nt : {false, true}){
+                if (nt && level == simd_scalar){
+                    continue;
+                }
+                buffer_ops_config cfg = {level, threads, 1ULL << 20, nt ? nt_always : nt_never};
+                results.push_back({"fill", simd_level_name(level), threads, nt, median_gbps(bytes, reps, [&](){
+                    buffer_ops::fill<elem>(a.data(), count, 7, cfg);
+                })});
+                results.push_back({"copy", simd_level_name(level), threads, nt, median_gbps(bytes, reps, [&](){
+                    buffer_ops::copy(b.bdata(), a.bdata(), bytes, cfg);
+                })});
+                if (!nt){
+                    results.push_back({"compare", simd_level_name(level), threads, false, median_gbps(2 * bytes, reps, [&](){
+                        if (buffer_ops::compare(a.data(), b.data(), count, 16, cfg).count != 0){
+                            throw std::runtime_error("Compare found mismatches");
+                        }
+                    })});
+                }
+            }
+        }
+    }
+
+    // Conversions, count elements from and to float32
+    std::vector<std::bfloat16_t> half(count);
+    float* values = reinterpret_cast<float*>(a.data());
+    for (size_t i = 0; i < count; i++){
+        values[i] = (float)(i % 4096) * 0.37f - 700.0f;
+    }
+    std::vector<bf16_kernel> kernels = {bf16_kernel_scalar};
+    if (best >= simd_avx2){
+        kernels.push_back(bf16_kernel_avx2);
+    }
+    if (best >= simd_avx512){
+        kernels.push_back(bf16_kernel_avx512);
+        if (has_avx512_bf16()){
+            kernels.push_back(bf16_kernel_avx512_bf16);
+        }
+    }
+    for (bf16_kernel kernel : kernels){
+        for (int threads : all > 1 ? std::vector<int>{1, all} : std::vector<int>{1}){
+            buffer_ops_config cfg = {best, threads, 1ULL << 20, nt_never};
+            results.push_back({"to_bf16", bf16_kernel_name(kernel), threads, false, median_gbps(bytes, reps, [&](){
+                bf16_ops::to_bf16(kernel, half.data(), values, count, bf16_round_nearest_even, cfg);
+            })});
+            results.push_back({"to_fp32", bf16_kernel_name(kernel), threads, false, median_gbps(bytes, reps, [&](){
+                bf16_ops::to_float(kernel, reinterpret_cast<float*>(b.data()), half.data(), count, cfg);
+            })});
+        }
+    }
+
+    std::stable_sort(results.begin(), results.end(), [](const ops_result& x, const ops_result& y){
+        return x.op < y.op;
+    });
+    return results;
+}
+
+inline void print_results(const std::vector<ops_result>& results, size_t bytes){
+    const int width = 62;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, "Host buffer ops, " << bytes / 1024 / 1024 << " MiB, LLC " << llc_size() / 1024 / 1024 << " MiB");
+    MSG_BOX_LINE(width, std::left << std::setw(10) << "op" << std::setw(12) << "kernel" << std::right << std::setw(9) << "threads"
+        << std::setw(8) << "nt" << std::setw(15) << "GB/s");
+    MSG_BONDLINE(width);
+    for (const ops_result& r : results){
+        MSG_BOX_LINE(width, std::left << std::setw(10) << r.op << std::setw(12) << r.kernel << std::right << std::setw(9) << r.threads
+            << std::setw(8) << (r.non_temporal ? "yes" : "no") << std::setw(15) << std::fixed << std::setprecision(2) << r.bandwidth);
+    }
+    MSG_BONDLINE(width);
+}
+
+}
+#endif
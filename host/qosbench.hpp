@@ -0,0 +1,215 @@
+#ifndef __QOSBENCH_HPP__
+#define __QOSBENCH_HPP__
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+#include "typedef.hpp"
+#include "npu_utils.hpp"
+#include "utils.hpp"
+#include "bwbench.hpp"
+
+// QoS impact.
+// The default bwbench point runs on a hardware context created with each QoS setting, first
+// alone and then while a second context with the competitor setting runs the same design in
+// a loop on another thread. For every setting the bandwidth, the p50 and p99 latency, the
+// jitter (p99 - p50) and the slowdown under contention are reported. The spread of p50 across
+// the settings tells whether the driver acts on the hints at all. The simulated backend does
+// not model QoS, so its spread is noise.
+// Each setting is measured on an npu_app of its own, which releases its context before the next
+// setting, so the suite holds two hardware contexts at a time however many settings it runs.
+
+typedef struct {
+    std::string qos;
+    std::string competitor;      // QoS of the competing context, empty when alone
+    uint64_t runs;
+    double bandwidth;            // GiB/s, DDR reads over the mean latency
+    double p50;                  // us
+    double p99;                  // us
+    double jitter;               // us, p99 - p50
+    double competitor_bandwidth; // GiB/s, 0 when alone
+    double slowdown;             // p50 over the p50 alone with the same setting
+} qos_result;
+
+namespace qosbench {
+
+const std::vector<std::string> default_settings = {
+    "none",
+    "default",
+    "priority=realtime",
+    "priority=normal",
+    "priority=low",
+    "gops=1000,priority=normal",
+    "dma_bandwidth=10,priority=low",
+    "fps=30,latency=33,frame_exec_time=10",
+};
+
+const std::string default_competitor = "default";
+
+// ';' separated settings, empty for the defaults
+inline std::vector<std::string> parse_settings(const std::string& list){
+    if (list.empty()){
+        return default_settings;
+    }
+    std::vector<std::string> settings;
+    size_t begin = 0;
+    while (begin <= list.size()){
+        size_t end = list.find(';', begin);
+        end = end == std::string::npos ? list.size() : end;
+        settings.push_back(npu_qos_str(parse_npu_qos(list.substr(begin, end - begin))));
+        begin = end + 1;
+    }
+    return settings;
+}
+
+// One hardware context with its buffers and an armed run
+struct qos_context{
+    int app_id;
+    buffer<dtype> A;
+    buffer<dtype> C;
+    buffer<dtype> T;
+    npu_run run;
+    size_t read_bytes;
+
+    qos_context(npu_app& npu_instance, const accel_user_desc& desc, size_t trace_words)
+        : app_id(npu_instance.register_accel_app(desc)),
+          A(npu_instance.create_bo_buffer<dtype>(bwbench::A_size(bwbench::default_config), 3, app_id)),
+          C(npu_instance.create_bo_buffer<dtype>(bwbench::C_size(bwbench::default_config), 4, app_id)),
+          T(npu_instance.create_bo_buffer<dtype>(trace_words, 5, app_id)){
+        A.memset(0);
+        C.memset(0);
+        T.memset(0);
+        A.sync_to_device();
+        C.sync_to_device();
+        T.sync_to_device();
+        run = npu_instance.create_run(app_id, A, C, T);
+        read_bytes = npu_instance.get_ddr_traffic(app_id).read_bytes;
+    }
+
+    latency_histogram measure(int runs, int warmup){
+        latency_histogram latency;
+        for (int i = 0; i < warmup + runs; i++){
+            time_utils::time_point start = time_utils::now();
+            run.start();
+            run.wait();
+            if (i >= warmup){
+                latency.record(time_utils::duration_ns(start, time_utils::now()));
+            }
+        }
+        return latency;
+    }
+};
+
+inline double gibps(size_t bytes, double ns){
+    return ns > 0 ? bytes / ns * 1e9 / 1024 / 1024 / 1024 : 0.0;
+}
+
+inline qos_result make_result(const std::string& qos, const std::string& competitor, const latency_histogram& latency, size_t bytes){
+    double p50 = latency.percentile(50) / 1e3;
+    double p99 = latency.percentile(99) / 1e3;
+    return {qos, competitor, latency.count(), gibps(bytes, latency.mean()), p50, p99, p99 - p50, 0.0, 1.0};
+}
+
+inline std::vector<qos_result> run_suite(npu_app& npu_instance, const std::string& device, const std::vector<std::string>& settings,
+    const std::string& competitor, size_t trace_words, int runs, int warmup = 20){
+    accel_user_desc base = bwbench::resolve_artifacts(bwbench::default_config, device, npu_instance.get_backend());
+    // The tag gives the competitor a context of its own, also when the caller registered the
+    // same xclbin with the same QoS
+    accel_user_desc other = base;
+    other.qos = parse_npu_qos(competitor);
+    other.context_tag = "qos competitor";
+    qos_context rival(npu_instance, other, trace_words);
+
+    std::vector<qos_result> results;
+    for (const std::string& setting : settings){
+        accel_user_desc desc = base;
+        desc.qos = parse_npu_qos(setting);
+        // destroyed after tested, which releases the context of the setting
+        npu_app tested_app(1, 1, 0, npu_instance.get_backend());
+        qos_context tested(tested_app, desc, trace_words);
+        std::string name = npu_qos_str(desc.qos);
+        header_print("info", "QoS " << name);
+
+        qos_result alone = make_result(name, "", tested.measure(runs, warmup), tested.read_bytes);
+        results.push_back(alone);
+
+        // The competitor runs back to back until the tested context is done. A failed run stops
+        // it, and its error is rethrown once the thread is joined.
+        std::atomic<bool> stop(false);
+        std::exception_ptr rival_error;
+        uint64_t rival_runs = 0;
+        time_utils::time_point rival_start = time_utils::now();
+        std::thread worker([&](){
+            try{
+                while (!stop.load(std::memory_order_relaxed)){
+                    rival.run.start();
+                    rival.run.wait();
+                    rival_runs++;
+                }
+            }
+            catch (...){
+                rival_error = std::current_exception();
+            }
+        });
+        latency_histogram latency;
+        try{
+            latency = tested.measure(runs, warmup);
+        }
+        catch (...){
+            stop = true;
+            worker.join();
+            throw;
+        }
+        stop = true;
+        worker.join();
+        if (rival_error){
+            std::rethrow_exception(rival_error);
+        }
+        uint64_t rival_ns = time_utils::duration_ns(rival_start, time_utils::now());
+        qos_result contended = make_result(name, npu_qos_str(other.qos), latency, tested.read_bytes);
+        contended.competitor_bandwidth = rival_runs > 0 ? gibps(rival.read_bytes * rival_runs, rival_ns) : 0.0;
+        contended.slowdown = alone.p50 > 0 ? contended.p50 / alone.p50 : 0.0;
+        results.push_back(contended);
+    }
+    return results;
+}
+
+// (max - min) / min of p50 over the settings, alone or contended
+inline double p50_spread(const std::vector<qos_result>& results, bool contended){
+    double lo = 0.0, hi = 0.0;
+    for (const qos_result& r : results){
+        if (r.competitor.empty() == contended){
+            continue;
+        }
+        lo = lo == 0.0 ? r.p50 : std::min(lo, r.p50);
+        hi = std::max(hi, r.p50);
+    }
+    return lo > 0 ? (hi - lo) / lo : 0.0;
+}
+
+inline void print_results(const std::vector<qos_result>& results){
+    const int width = 124;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, "Competitor QoS: " << (results.empty() ? "" : results.back().competitor));
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::left << std::setw(44) << "QoS" << std::setw(10) << "mode" << std::right << std::setw(8) << "runs"
+        << std::setw(9) << "GiB/s" << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "jitter"
+        << std::setw(11) << "other" << std::setw(10) << "slowdown");
+    MSG_BOX_LINE(width, std::left << std::setw(44) << "" << std::setw(10) << "" << std::right << std::setw(8) << ""
+        << std::setw(9) << "" << std::setw(10) << "(us)" << std::setw(10) << "(us)" << std::setw(10) << "(us)"
+        << std::setw(11) << "(GiB/s)" << std::setw(10) << "");
+    MSG_BONDLINE(width);
+    for (const qos_result& r : results){
+        MSG_BOX_LINE(width, std::left << std::setw(44) << r.qos << std::setw(10) << (r.competitor.empty() ? "alone" : "contended")
+            << std::right << std::setw(8) << r.runs << std::fixed << std::setprecision(2) << std::setw(9) << r.bandwidth
+            << std::setprecision(1) << std::setw(10) << r.p50 << std::setw(10) << r.p99 << std::setw(10) << r.jitter
+            << std::setprecision(2) << std::setw(11) << r.competitor_bandwidth << std::setw(10) << r.slowdown);
+    }
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::fixed << std::setprecision(1) << "p50 spread across settings: " << p50_spread(results, false) * 100
+        << " % alone, " << p50_spread(results, true) * 100 << " % contended");
+    MSG_BONDLINE(width);
+}
+
+}
+#endif
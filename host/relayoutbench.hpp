@@ -0,0 +1,125 @@
+#ifndef __RELAYOUTBENCH_HPP__
+#define __RELAYOUTBENCH_HPP__
+#include <algorithm>
+#include "typedef.hpp"
+#include "npu_utils.hpp"
+#include "utils.hpp"
+#include "opsbench.hpp"
+
+// Host relayout versus DMA striding.
+// The input of the default bwbench point is viewed as a row-major matrix and relaid into the
+// order of several BD patterns: square and flat tiles, and a transpose, whose dimension 0 is a
+// column. Tiling (gather) and untiling (scatter) are timed on one thread and on all of them,
+// and compared with the time the kernel takes to read the same bytes with a linear BD. A ratio
+// above 1 means the host relayout costs more than the transfer itself, so the pattern is
+// better left to the DMA. The DMA moves d0 bytes per contiguous run of a strided pattern;
+// runs shorter than a burst are what makes striding on the NPU side slower.
+
+typedef struct {
+    std::string shape;
+    std::string dims;   // BD dimensions, outermost first, size:stride
+    size_t d0_bytes;    // contiguous bytes per dimension 0 row
+    int threads;
+    double tile;        // GB/s, row-major to BD order
+    double untile;      // GB/s, BD order to row-major
+    double tile_time;   // us per matrix
+    double dma_time;    // us per matrix, kernel reads with a linear BD
+    double ratio;       // tile_time / dma_time
+} relayout_result;
+
+namespace relayoutbench {
+
+typedef struct {
+    std::string name;
+    bd_dims dims;
+} relayout_case;
+
+inline std::vector<relayout_case> cases(size_t rows, size_t cols){
+    std::vector<relayout_case> list;
+    const size_t shapes[][2] = {{32, 32}, {64, 64}, {8, 128}, {128, 8}, {4, 4}};
+    for (const size_t* s : shapes){
+        if (rows % s[0] == 0 && cols % s[1] == 0){
+            list.push_back({"tile " + std::to_string(s[0]) + "x" + std::to_string(s[1]), tile_dims(rows, cols, s[0], s[1])});
+        }
+    }
+    list.push_back({"transpose", bd_dims{2, {rows, cols}, {cols, 1}, 0}});
+    return list;
+}
+
+// GB/s of the kernel reading its input, runs after a warm-up run
+inline double dma_gbps(npu_app& npu_instance, int app_id, npu_bo& In, npu_bo& Out0, npu_bo& Out1, size_t read_bytes, int runs){
+    npu_run run = npu_instance.create_run(In, Out0, Out1, app_id);
+    run.start();
+    run.wait();
+    time_utils::time_point start = time_utils::now();
+    for (int i = 0; i < runs; i++){
+        run.start();
+        run.wait();
+    }
+    uint64_t ns = time_utils::duration_ns(start, time_utils::now());
+    return ns > 0 ? (double)read_bytes * runs / ns : 0.0;
+}
+
+inline std::vector<relayout_result> run_suite(npu_app& npu_instance, int app_id, size_t count, npu_bo& Out0, npu_bo& Out1,
+    size_t read_bytes, int runs, int reps = 5){
+    size_t cols = 1;
+    while (cols * cols < count){
+        cols *= 2;
+    }
+    size_t rows = count / cols;
+    const size_t bytes = rows * cols * sizeof(dtype);
+    buffer<dtype> A = npu_instance.create_bo_buffer<dtype>(count, 3, app_id);
+    for (size_t i = 0; i < A.size(); i++){
+        A[i] = i;
+    }
+    A.sync_to_device();
+    double dma = dma_gbps(npu_instance, app_id, A.bo(), Out0, Out1, read_bytes, runs);
+    double dma_time = dma > 0 ? bytes / dma / 1e3 : 0.0;
+
+    std::vector<dtype> packed(rows * cols);
+    std::vector<relayout_result> results;
+    int all = std::max(1u, std::thread::hardware_concurrency());
+    for (const relayout_case& c : cases(rows, cols)){
+        vector_view<dtype> view(A, c.dims);
+        for (int threads : all > 1 ? std::vector<int>{1, all} : std::vector<int>{1}){
+            buffer_ops_config cfg = default_buffer_ops_config();
+            cfg.threads = threads;
+            cfg.min_chunk = 64 << 10;
+            double tile = opsbench::median_gbps(bytes, reps, [&](){
+                view.gather(packed.data(), cfg);
+            });
+            double untile = opsbench::median_gbps(bytes, reps, [&](){
+                view.scatter(packed.data(), cfg);
+            });
+            if (view.compare(packed.data(), 16, cfg).count != 0){
+                throw std::runtime_error("Relayout of " + c.name + " does not round trip");
+            }
+            double tile_time = tile > 0 ? bytes / tile / 1e3 : 0.0;
+            results.push_back({c.name, bd_dims_str(c.dims), view.stride(0) == 1 ? view.size(0) * sizeof(dtype) : sizeof(dtype),
+                threads, tile, untile, tile_time, dma_time, dma_time > 0 ? tile_time / dma_time : 0.0});
+        }
+    }
+    return results;
+}
+
+inline void print_results(const std::vector<relayout_result>& results){
+    const int width = 100;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::left << std::setw(14) << "shape" << std::right << std::setw(10) << "d0 bytes" << std::setw(9) << "threads"
+        << std::setw(13) << "tile" << std::setw(13) << "untile" << std::setw(13) << "tile" << std::setw(13) << "dma"
+        << std::setw(10) << "ratio");
+    MSG_BOX_LINE(width, std::left << std::setw(14) << "" << std::right << std::setw(10) << "" << std::setw(9) << ""
+        << std::setw(13) << "(GB/s)" << std::setw(13) << "(GB/s)" << std::setw(13) << "(us)" << std::setw(13) << "(us)"
+        << std::setw(10) << "");
+    MSG_BONDLINE(width);
+    for (const relayout_result& r : results){
+        MSG_BOX_LINE(width, std::left << std::setw(14) << r.shape << std::right << std::setw(10) << r.d0_bytes
+            << std::setw(9) << r.threads << std::fixed << std::setprecision(2) << std::setw(13) << r.tile
+            << std::setw(13) << r.untile << std::setprecision(1) << std::setw(13) << r.tile_time
+            << std::setw(13) << r.dma_time << std::setprecision(2) << std::setw(10) << r.ratio);
+    }
+    MSG_BONDLINE(width);
+}
+
+}
+#endif
@@ -0,0 +1,396 @@
+#ifndef __RESULT_WRITER_HPP__
+#define __RESULT_WRITER_HPP__
+#include <ctime>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include "npu_utils.hpp"
+#include "bwbench.hpp"
+#include "launchbench.hpp"
+#include "allocbench.hpp"
+#include "opsbench.hpp"
+#include "relayoutbench.hpp"
+#include "instrbench.hpp"
+#include "qosbench.hpp"
+
+// Machine readable results.
+// Every point becomes one flat record: the configuration, the decoded traffic, all timing
+// statistics and the device environment. Records are appended as JSON lines or as CSV rows
+// with a header, so the files of many runs can be concatenated and ingested directly.
+
+typedef enum{
+    result_format_json,
+    result_format_csv
+} result_format;
+
+// Ordered list of fields, numbers are stored unquoted
+class result_record{
+public:
+    void add(const std::string& key, const std::string& value){
+        fields.push_back({key, value, field_string});
+    }
+
+    void add(const std::string& key, const char* value){
+        add(key, std::string(value));
+    }
+
+    void add(const std::string& key, bool value){
+        fields.push_back({key, value ? "true" : "false", field_number});
+    }
+
+    template<typename T>
+    void add(const std::string& key, T value){
+        std::ostringstream os;
+        if (std::isfinite((double)value)){
+            os << std::setprecision(9) << value;
+        }
+        else{
+            os << "null";
+        }
+        fields.push_back({key, os.str(), field_number});
+    }
+
+    // Per-run samples, a JSON array or a ';' separated CSV cell
+    void add(const std::string& key, const std::vector<double>& values){
+        std::ostringstream os;
+        os << std::setprecision(9);
+        for (size_t i = 0; i < values.size(); i++){
+            os << (i > 0 ? ";" : "") << values[i];
+        }
+        fields.push_back({key, os.str(), field_array});
+    }
+
+    std::string to_json() const {
+        std::string line = "{";
+        for (size_t i = 0; i < fields.size(); i++){
+            line += (i > 0 ? "," : "") + json_string(fields[i].key) + ":";
+            if (fields[i].type == field_string){
+                line += json_string(fields[i].value);
+            }
+            else if (fields[i].type == field_array){
+                std::string items = fields[i].value;
+                std::replace(items.begin(), items.end(), ';', ',');
+                line += "[" + items + "]";
+            }
+            else{
+                line += fields[i].value;
+            }
+        }
+        return line + "}";
+    }
+
+    std::string csv_header() const {
+        std::string line;
+        for (size_t i = 0; i < fields.size(); i++){
+            line += (i > 0 ? "," : "") + csv_string(fields[i].key);
+        }
+        return line;
+    }
+
+    std::string to_csv() const {
+        std::string line;
+        for (size_t i = 0; i < fields.size(); i++){
+            line += (i > 0 ? "," : "") + (fields[i].value == "null" && fields[i].type == field_number ? std::string() : csv_string(fields[i].value));
+        }
+        return line;
+    }
+
+private:
+    typedef enum{
+        field_number,
+        field_string,
+        field_array
+    } field_type;
+    typedef struct {
+        std::string key;
+        std::string value;
+        field_type type;
+    } field;
+    std::vector<field> fields;
+
+    static std::string json_string(const std::string& s){
+        std::string out = "\"";
+        for (char c : s){
+            switch (c){
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if ((unsigned char)c < 0x20){
+                        char buf[8];
+                        snprintf(buf, sizeof(buf), "\\u%04x", c);
+                        out += buf;
+                    }
+                    else{
+                        out += c;
+                    }
+            }
+        }
+        return out + "\"";
+    }
+
+    static std::string csv_string(const std::string& s){
+        if (s.find_first_of(",\"\r\n") == std::string::npos){
+            return s;
+        }
+        std::string out = "\"";
+        for (char c : s){
+            out += (c == '"') ? std::string("\"\"") : std::string(1, c);
+        }
+        return out + "\"";
+    }
+};
+
+// Run wide context, shared by all points of one invocation
+typedef struct {
+    std::string device;
+    int iterations;
+    int trace_length;
+    adaptive_config adaptive;
+    npu_environment env;
+} result_context;
+
+inline std::string utc_timestamp(){
+    char buf[32];
+    std::time_t t = std::time(nullptr);
+    std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&t));
+    return buf;
+}
+
+inline void add_environment(result_record& record, const npu_environment& env){
+    char hostname[256] = {};
+    gethostname(hostname, sizeof(hostname) - 1);
+    struct utsname uts;
+    uname(&uts);
+    record.add("host", std::string(hostname));
+    record.add("kernel", std::string(uts.release));
+    record.add("backend", npu_backend_name(env.backend));
+    if (env.firmware_valid){
+        record.add("fw_version", std::to_string(env.firmware.major) + "." + std::to_string(env.firmware.minor) + "."
+            + std::to_string(env.firmware.patch) + "." + std::to_string(env.firmware.build));
+    }
+    else{
+        record.add("fw_version", "");
+    }
+    record.add("mp_npu_clock_mhz", env.clock_valid ? (int)env.clock.mp_npu_clock.freq_mhz : -1);
+    record.add("h_clock_mhz", env.clock_valid ? (int)env.clock.h_clock.freq_mhz : -1);
+    record.add("aie_version", env.aie_valid ? std::to_string(env.aie.version.major) + "." + std::to_string(env.aie.version.minor) : "");
+    record.add("aie_cols", env.aie_valid ? (int)env.aie.cols : -1);
+    record.add("aie_rows", env.aie_valid ? (int)env.aie.rows : -1);
+    record.add("aie_core_rows", env.aie_valid ? (int)env.aie.core.row_count : -1);
+    record.add("aie_mem_rows", env.aie_valid ? (int)env.aie.mem.row_count : -1);
+    record.add("aie_shim_dma_channels", env.aie_valid ? (int)env.aie.shim.dma_channel_count : -1);
+    record.add("power_mode", env.power_mode_valid ? npu_power_mode_name(env.power_mode.power_mode) : "");
+    record.add("power_w", env.power);
+}
+
+inline void add_latency(result_record& record, const std::string& prefix, const latency_histogram& hist){
+    record.add(prefix + "_count", hist.count());
+    record.add(prefix + "_min_ns", hist.min());
+    record.add(prefix + "_p50_ns", hist.percentile(50));
+    record.add(prefix + "_p90_ns", hist.percentile(90));
+    record.add(prefix + "_p99_ns", hist.percentile(99));
+    record.add(prefix + "_p999_ns", hist.percentile(99.9));
+    record.add(prefix + "_max_ns", hist.max());
+    record.add(prefix + "_mean_ns", hist.mean());
+    record.add(prefix + "_stddev_ns", hist.stddev());
+}
+
+inline void add_adaptive(result_record& record, const std::string& prefix, const adaptive_result& stats){
+    record.add(prefix + "_warmup_samples", stats.warmup_samples);
+    record.add(prefix + "_samples", stats.samples);
+    record.add(prefix + "_mean", stats.mean);
+    record.add(prefix + "_stddev", stats.stddev);
+    record.add(prefix + "_ci95", stats.ci_half_width);
+    record.add(prefix + "_converged", stats.converged);
+    record.add(prefix + "_elapsed_s", stats.elapsed);
+}
+
+inline result_record make_record(const bwbench_result& r, const result_context& ctx){
+    result_record record;
+    record.add("timestamp", utc_timestamp());
+    record.add("name", bwbench::name(r.config));
+    record.add("device", ctx.device);
+    record.add("use_cols", r.config.use_cols);
+    record.add("burst_size", r.config.burst_size);
+    record.add("token_rate", r.config.token_rate);
+    record.add("rounds", r.config.rounds);
+    record.add("iterations", ctx.iterations);
+    record.add("trace_length", ctx.trace_length);
+    record.add("tolerance", ctx.adaptive.tolerance);
+    record.add("time_budget_s", ctx.adaptive.time_budget);
+    record.add("min_samples", ctx.adaptive.min_samples);
+    record.add("read_bytes", r.traffic.read_bytes);
+    record.add("write_bytes", r.traffic.write_bytes);
+    record.add("tasks", r.traffic.tasks);
+    record.add("bare_time_us", r.bare_time);
+    record.add("runlist_time_us", r.runlist_time);
+    record.add("bandwidth_gibps", r.bandwidth);
+    add_latency(record, "bare", r.bare_latency);
+    add_latency(record, "runlist_batch", r.runlist_latency);
+    add_latency(record, "bare_submit", r.bare_submit);
+    add_latency(record, "runlist_submit", r.runlist_submit);
+    record.add("pool_setup_us", r.pool_setup_time);
+    record.add("stream_depth", r.stream.depth);
+    record.add("stream_items", r.stream.items);
+    record.add("stream_items_per_s", r.stream.items_per_s);
+    record.add("stream_gibps", r.stream.bandwidth);
+    record.add("stream_fill_s", r.stream.fill_time);
+    record.add("stream_drain_s", r.stream.drain_time);
+    record.add("stream_sync_s", r.stream.sync_time);
+    record.add("stream_stall_s", r.stream.stall_time);
+    record.add("integrity", !r.integrity.enabled ? "off" : r.integrity.ok ? "pass" : "fail");
+    record.add("pattern", r.integrity.enabled ? pattern_kind_name(r.integrity.pattern.kind) : "");
+    record.add("input_bad_words", r.integrity.input.bad_words);
+    record.add("input_bad_bursts", r.integrity.input.bad_bursts);
+    record.add("output_unwritten_bursts", r.integrity.unwritten.size());
+    record.add("output_checked", r.integrity.output_checked);
+    add_adaptive(record, "bare_ns", r.bare_stats);
+    add_adaptive(record, "runlist_gibps", r.runlist_stats);
+    add_environment(record, ctx.env);
+    record.add("bandwidth_samples_gibps", r.bandwidth_samples);
+    return record;
+}
+
+inline result_record make_launch_record(const launch_result& r, const result_context& ctx){
+    result_record record;
+    record.add("timestamp", utc_timestamp());
+    record.add("name", "launch/" + r.path + "/" + r.phase);
+    record.add("device", ctx.device);
+    record.add("path", r.path);
+    record.add("phase", r.phase);
+    record.add("batch", r.batch);
+    add_latency(record, "launch", r.latency);
+    record.add("launches_per_s", r.throughput);
+    add_environment(record, ctx.env);
+    return record;
+}
+
+inline result_record make_alloc_record(const alloc_result& r, const result_context& ctx){
+    result_record record;
+    record.add("timestamp", utc_timestamp());
+    record.add("name", "alloc/" + r.policy);
+    record.add("device", ctx.device);
+    record.add("policy", r.policy);
+    record.add("available", r.available);
+    record.add("error", r.error);
+    record.add("alloc_us", r.alloc_time);
+    record.add("first_fill_gibps", r.first_fill);
+    record.add("warm_fill_gibps", r.warm_fill);
+    record.add("sync_to_gibps", r.sync_to);
+    record.add("sync_from_gibps", r.sync_from);
+    record.add("dma_gibps", r.dma);
+    add_environment(record, ctx.env);
+    return record;
+}
+
+inline result_record make_ops_record(const ops_result& r, size_t bytes, const result_context& ctx){
+    result_record record;
+    record.add("timestamp", utc_timestamp());
+    record.add("name", "ops/" + r.op + "/" + r.kernel + "/t" + std::to_string(r.threads) + (r.non_temporal ? "/nt" : ""));
+    record.add("device", ctx.device);
+    record.add("op", r.op);
+    record.add("op_kernel", r.kernel); // "kernel" is the OS release of the environment
+    record.add("threads", r.threads);
+    record.add("non_temporal", r.non_temporal);
+    record.add("bytes", bytes);
+    record.add("gbps", r.bandwidth);
+    add_environment(record, ctx.env);
+    return record;
+}
+
+inline result_record make_relayout_record(const relayout_result& r, const result_context& ctx){
+    result_record record;
+    record.add("timestamp", utc_timestamp());
+    record.add("name", "relayout/" + r.shape + "/t" + std::to_string(r.threads));
+    record.add("device", ctx.device);
+    record.add("shape", r.shape);
+    record.add("dims", r.dims);
+    record.add("d0_bytes", r.d0_bytes);
+    record.add("threads", r.threads);
+    record.add("tile_gbps", r.tile);
+    record.add("untile_gbps", r.untile);
+    record.add("tile_us", r.tile_time);
+    record.add("dma_us", r.dma_time);
+    record.add("ratio", r.ratio);
+    add_environment(record, ctx.env);
+    return record;
+}
+
+inline result_record make_instr_load_record(const instr_load_result& r, const result_context& ctx){
+    result_record record;
+    record.add("timestamp", utc_timestamp());
+    record.add("name", "instr_load/" + r.format + "/" + std::to_string(r.words * sizeof(uint32_t) >> 10) + "k");
+    record.add("device", ctx.device);
+    record.add("format", r.format);
+    record.add("words", r.words);
+    record.add("file_bytes", r.file_bytes);
+    record.add("vector_us", r.legacy_time);
+    record.add("mapped_us", r.mapped_time);
+    record.add("register_us", r.register_time);
+    record.add("speedup", r.speedup);
+    record.add("mapped_mbps", r.mapped_mbps);
+    add_environment(record, ctx.env);
+    return record;
+}
+
+inline result_record make_qos_record(const qos_result& r, const result_context& ctx){
+    result_record record;
+    record.add("timestamp", utc_timestamp());
+    record.add("name", "qos/" + r.qos + "/" + (r.competitor.empty() ? "alone" : "contended"));
+    record.add("device", ctx.device);
+    record.add("qos", r.qos);
+    record.add("competitor", r.competitor);
+    record.add("runs", r.runs);
+    record.add("bandwidth_gibps", r.bandwidth);
+    record.add("p50_us", r.p50);
+    record.add("p99_us", r.p99);
+    record.add("jitter_us", r.jitter);
+    record.add("competitor_gibps", r.competitor_bandwidth);
+    record.add("slowdown", r.slowdown);
+    add_environment(record, ctx.env);
+    return record;
+}
+
+// Appends records to a file. A CSV file holds one kind of record: its header is written with
+// the first record, and records with other columns, e.g. of another benchmark or of an older
+// version, are refused instead of being appended under the wrong header.
+class result_writer{
+public:
+    result_writer(const std::string& path, result_format format) : path(path), format(format){
+        if (format == result_format_csv){
+            std::ifstream existing(path);
+            std::getline(existing, header);
+        }
+        file.open(path, std::ios::app);
+        if (!file){
+            throw std::runtime_error("Unable to open result file: " + path);
+        }
+    }
+
+    void write(const result_record& record){
+        if (format == result_format_csv){
+            std::string columns = record.csv_header();
+            if (header.empty()){
+                file << columns << "\n";
+                header = columns;
+            }
+            else if (columns != header){
+                throw std::runtime_error("CSV file " + path + " holds records with other columns, write these to another file");
+            }
+            file << record.to_csv() << "\n";
+        }
+        else{
+            file << record.to_json() << "\n";
+        }
+        file.flush();
+    }
+
+private:
+    std::string path;
+    result_format format;
+    std::string header; // columns of the CSV file, empty until the first record
+    std::ofstream file;
+};
+
+#endif
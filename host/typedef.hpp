@@ -12,9 +12,6 @@
 #include <sstream>
 #include <stdfloat>
 
-#include "xrt/xrt_bo.h"
-#include "xrt/xrt_device.h"
-#include "xrt/xrt_kernel.h"
 #include "buffer.hpp"
 
 typedef uint32_t dtype;
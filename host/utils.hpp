@@ -2,15 +2,25 @@
 #define __UTILS_HPP__
 #include "typedef.hpp"
 #include "debug_utils.hpp"
+#include "latency_histogram.hpp"
+#include "adaptive_bench.hpp"
+#include "stream_pipeline.hpp"
 #include <chrono>
+#include <cstdlib>
+#include <filesystem>
 
 namespace time_utils {
 
-typedef std::chrono::high_resolution_clock::time_point time_point;
+// steady_clock is monotonic, so samples are not disturbed by clock adjustments
+typedef std::chrono::steady_clock::time_point time_point;
 typedef std::pair<float, std::string> time_with_unit;
 
 time_point now(){
-    return std::chrono::high_resolution_clock::now();
+    return std::chrono::steady_clock::now();
+}
+
+uint64_t duration_ns(time_point start, time_point stop){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count();
 }
 
 time_with_unit duration_us(time_point start, time_point stop){
@@ -104,6 +114,31 @@ void print_progress_bar(std::ostream &os, double progress, int len = 75) {
         << "\r";
 }
 
+// Scratch directory under the system temporary directory, removed with its files on destruction
+class temp_dir{
+public:
+    explicit temp_dir(const std::string& prefix){
+        std::string pattern = (std::filesystem::temp_directory_path() / (prefix + "_XXXXXX")).string();
+        if (mkdtemp(pattern.data()) == nullptr){
+            throw std::runtime_error("Unable to create a temporary directory " + pattern);
+        }
+        dir = pattern;
+    }
+
+    ~temp_dir(){
+        std::error_code ec;
+        std::filesystem::remove_all(dir, ec);
+    }
+
+    temp_dir(const temp_dir&) = delete;
+    temp_dir& operator=(const temp_dir&) = delete;
+
+    std::string file(const std::string& name) const { return (dir / name).string(); }
+
+private:
+    std::filesystem::path dir;
+};
+
 void check_arg_file_exists(std::string name) {
     // Attempt to open the file
     std::ifstream file(name);
@@ -117,18 +152,72 @@ void check_arg_file_exists(std::string name) {
     file.close();
 }
 
+template <typename T>
+mismatch_summary<T> compare_buffers(buffer<T>& y, buffer<T>& y_ref, size_t max_records = 16){
+    if (y.size() != y_ref.size()){
+        throw std::runtime_error("Size mismatch in compare_buffers");
+    }
+    return buffer_ops::compare(y.data(), y_ref.data(), y.size(), max_records);
+}
+
 template <typename T>
 int compare_vectors(buffer<T>& y, buffer<T>& y_ref, int print_errors = 16){
-    int total_errors = 0;
-    for (int i = 0; i < y.size(); i++){
-        if (y[i] != y_ref[i]){
-            if (total_errors < print_errors){
-                std::cout << "Error: y[" << i << "] = " << y[i] << " != y_ref[" << i << "] = " << y_ref[i] << std::endl;
-            }
-            total_errors++;
-        }
+    mismatch_summary<T> summary = compare_buffers(y, y_ref, print_errors);
+    for (size_t k = 0; k < summary.indices.size(); k++){
+        size_t i = summary.indices[k];
+        std::cout << "Error: y[" << i << "] = " << summary.values[k] << " != y_ref[" << i << "] = " << summary.expected[k] << std::endl;
     }
-    return total_errors;
+    return summary.count;
+}
+
+void print_latency(const latency_histogram& hist, std::string title){
+    MSG_BONDLINE(40);
+    MSG_BOX_LINE(40, title << " (" << hist.count() << " samples)");
+    MSG_BOX_LINE(40, "min    : " << hist.min() / 1e3 << " us");
+    MSG_BOX_LINE(40, "p50    : " << hist.percentile(50) / 1e3 << " us");
+    MSG_BOX_LINE(40, "p90    : " << hist.percentile(90) / 1e3 << " us");
+    MSG_BOX_LINE(40, "p99    : " << hist.percentile(99) / 1e3 << " us");
+    MSG_BOX_LINE(40, "p99.9  : " << hist.percentile(99.9) / 1e3 << " us");
+    MSG_BOX_LINE(40, "max    : " << hist.max() / 1e3 << " us");
+    MSG_BOX_LINE(40, "mean   : " << hist.mean() / 1e3 << " us");
+    MSG_BOX_LINE(40, "stddev : " << hist.stddev() / 1e3 << " us");
+    MSG_BONDLINE(40);
+}
+
+void print_adaptive(const adaptive_result& stats, std::string title, std::string unit){
+    MSG_BONDLINE(40);
+    MSG_BOX_LINE(40, title << (stats.converged ? " (converged)" : " (budget hit)"));
+    MSG_BOX_LINE(40, "warm-up : " << stats.warmup_samples << " samples");
+    MSG_BOX_LINE(40, "samples : " << stats.samples);
+    MSG_BOX_LINE(40, "mean    : " << stats.mean << " " << unit);
+    MSG_BOX_LINE(40, "95% CI  : +-" << stats.ci_half_width << " " << unit);
+    MSG_BOX_LINE(40, "elapsed : " << stats.elapsed << " s");
+    MSG_BONDLINE(40);
+}
+
+void print_stream(const stream_stats& stats){
+    MSG_BONDLINE(40);
+    MSG_BOX_LINE(40, "Stream, depth " << stats.depth << ", " << stats.items << " items");
+    MSG_BOX_LINE(40, "throughput : " << stats.items_per_s << " items/s");
+    MSG_BOX_LINE(40, "bandwidth  : " << stats.bandwidth << " GiB/s");
+    MSG_BOX_LINE(40, "host fill  : " << stats.fill_time * 1e3 << " ms");
+    MSG_BOX_LINE(40, "host drain : " << stats.drain_time * 1e3 << " ms");
+    MSG_BOX_LINE(40, "sync       : " << stats.sync_time * 1e3 << " ms");
+    MSG_BOX_LINE(40, "stall      : " << stats.stall_time * 1e3 << " ms");
+    MSG_BOX_LINE(40, "elapsed    : " << stats.elapsed * 1e3 << " ms");
+    MSG_BONDLINE(40);
+}
+
+void print_bo_pool(const npu_bo_pool_stats& stats){
+    MSG_BONDLINE(40);
+    MSG_BOX_LINE(40, "BO pool");
+    MSG_BOX_LINE(40, "requests   : " << stats.requests);
+    MSG_BOX_LINE(40, "hit rate   : " << (stats.requests ? 100.0 * stats.hits / stats.requests : 0.0) << " %");
+    MSG_BOX_LINE(40, "live       : " << stats.live << " BOs, " << stats.live_bytes / 1024 << " KiB");
+    MSG_BOX_LINE(40, "cached     : " << stats.cached << " BOs, " << stats.cached_bytes / 1024 << " KiB");
+    MSG_BOX_LINE(40, "high water : " << stats.high_water_bytes / 1024 << " KiB");
+    MSG_BOX_LINE(40, "live peak  : " << stats.live_high_water_bytes / 1024 << " KiB");
+    MSG_BONDLINE(40);
 }
 
 void print_npu_profile(time_utils::time_with_unit npu_time, float op, int n_iter = 1){
@@ -18,6 +18,7 @@
 #include <bits/stdc++.h>
 #include <boost/program_options.hpp>
 #include "debug_utils.hpp"
+#include "npu_device.hpp"
 
 namespace arg_utils {
 
@@ -26,6 +27,7 @@ namespace po = boost::program_options;
 void add_default_options(po::options_description &desc) {
     desc.add_options()("help,h", "produce help message");
     desc.add_options()("device,d", po::value<std::string>()->default_value("npu1"), "Device type, npu1 or npu2");
+    desc.add_options()("backend,b", po::value<std::string>()->default_value(npu_backend_name(NPU_DEFAULT_BACKEND)), "Device backend, xrt or sim (NPU_SIM_* environment variables tune the sim model)");
 }
 
 void parse_options(int argc, const char *argv[], po::options_description &desc,
@@ -45,6 +47,13 @@ void parse_options(int argc, const char *argv[], po::options_description &desc,
     }
 }
 
+// Reports an option value that parsed but is out of range, the same way as parse errors
+[[noreturn]] void usage_error(const po::options_description &desc, const std::string &message) {
+    std::cerr << message << "\n\n";
+    std::cerr << "Usage:\n" << desc << "\n";
+    std::exit(1);
+}
+
 
 }
 #endif
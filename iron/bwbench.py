@@ -1,3 +1,4 @@
+import argparse
 import numpy as np
 import sys
 
@@ -8,22 +9,24 @@ from aie.dialects.aiex import *
 from aie.helpers.dialects.ext.scf import _for as range_
 
 
-def my_matmul(arch: str = "npu2"):
+# The host derives buffer sizes from the same parameters (host/bwbench.hpp, bwbench_config)
+# and the moved bytes from the generated instruction sequence.
+def my_matmul(arch: str = "npu2", use_cols: int = 4, burst_size: int = 1024, token_rate: int = 32, rounds: int = 4):
 
     if arch == "npu1":
         dev = AIEDevice.npu1_4col
         total_cols = 4
         total_rows = 4
-        use_cols = 4
         use_rows = 1
     elif arch == "npu2":
         dev = AIEDevice.npu2
         total_cols = 8
         total_rows = 4
-        use_cols = 4
         use_rows = 1
     else:
         raise ValueError(f"Invalid device: {arch}")
+    if use_cols < 1 or use_cols > total_cols:
+        raise ValueError(f"Invalid column count {use_cols} for {arch}")
 
 
     dtype = np.dtype[np.uint32]
@@ -44,8 +47,6 @@ def my_matmul(arch: str = "npu2"):
 
                 cores.append(ComputeTilesRow)
 
-            token_rate = 32
-            burst_size = 1024
             data_slice_ty = np.ndarray[(burst_size // use_rows, 1), dtype] # 1KB
             data_ty = np.ndarray[(burst_size, ), dtype] # 1KB
 
@@ -113,42 +114,48 @@ def my_matmul(arch: str = "npu2"):
                 np.ndarray[(16384 // 4,), dtype]
             )
             def sequence(A, C, T):
-                rounds = 4
-                for r in range(rounds // 2):
-                    for pp in range(2):
-                        bd_offset = pp * 8
-                        abs_rr = r * 2 + pp
-                        for i in range(use_cols):
-                            col_offset =  0# i * burst_size * token_rate // use_cols
-                            npu_dma_memcpy_nd(
-                                metadata=channel_0_it_fifos[i],
-                                bd_id=1 + bd_offset,
-                                mem=A,
-                                offsets=[0, 0, 0, col_offset],
-                                sizes=[1, 1, 1, token_rate * burst_size],
-                                strides=[0, 0, 0, 1],
-                            )
-                            npu_dma_memcpy_nd(
-                                metadata=channel_1_it_fifos[i],
-                                bd_id=2 + bd_offset,
-                                mem=A,
-                                offsets=[0, 0, 0, col_offset + 0 * token_rate * burst_size * 2],
-                                sizes=[1, 1, 1, token_rate * burst_size],
-                                strides=[0, 0, 0, 1],
-                            )
-                            npu_dma_memcpy_nd(
-                                metadata=token_out_fifos[i],
-                                bd_id=0 + bd_offset,
-                                mem=C,
-                                offsets=[0, 0, 0, i * burst_size],
-                                sizes = [1, 1, 1, burst_size],
-                                strides = [0, 0, 0, 1]
-                            )
-                        if abs_rr > 0:
-                            dma_wait(*token_out_fifos)
+                for abs_rr in range(rounds):
+                    # ping-pong between two BD sets so the next round is queued while one runs
+                    bd_offset = (abs_rr % 2) * 8
+                    for i in range(use_cols):
+                        col_offset =  0# i * burst_size * token_rate // use_cols
+                        npu_dma_memcpy_nd(
+                            metadata=channel_0_it_fifos[i],
+                            bd_id=1 + bd_offset,
+                            mem=A,
+                            offsets=[0, 0, 0, col_offset],
+                            sizes=[1, 1, 1, token_rate * burst_size],
+                            strides=[0, 0, 0, 1],
+                        )
+                        npu_dma_memcpy_nd(
+                            metadata=channel_1_it_fifos[i],
+                            bd_id=2 + bd_offset,
+                            mem=A,
+                            offsets=[0, 0, 0, col_offset + 0 * token_rate * burst_size * 2],
+                            sizes=[1, 1, 1, token_rate * burst_size],
+                            strides=[0, 0, 0, 1],
+                        )
+                        npu_dma_memcpy_nd(
+                            metadata=token_out_fifos[i],
+                            bd_id=0 + bd_offset,
+                            mem=C,
+                            offsets=[0, 0, 0, i * burst_size],
+                            sizes = [1, 1, 1, burst_size],
+                            strides = [0, 0, 0, 1]
+                        )
+                    if abs_rr > 0:
+                        dma_wait(*token_out_fifos)
                 dma_wait(*token_out_fifos)
 
     print(ctx.module)
 
 
-my_matmul(sys.argv[1])
+parser = argparse.ArgumentParser()
+parser.add_argument("device", nargs="?", default="npu2")
+parser.add_argument("--cols", type=int, default=4)
+parser.add_argument("--burst-size", type=int, default=1024)
+parser.add_argument("--token-rate", type=int, default=32)
+parser.add_argument("--rounds", type=int, default=4)
+args = parser.parse_args()
+
+my_matmul(args.device, args.cols, args.burst_size, args.token_rate, args.rounds)
@@ -8,18 +8,33 @@ HOST_SRCS = $(wildcard ${HOST_SRCDIR}/*.cpp)
 
 NPU_UTILS_SRCS = ${HOME_DIR}/common/npu_utils.cpp
 NPU_INSTR_UTILS_SRCS = ${HOME_DIR}/common/npu_instr_utils.cpp
+NPU_DEVICE_SRCS = ${HOME_DIR}/common/npu_device_xrt.cpp ${HOME_DIR}/common/npu_device_sim.cpp
 NPU_UTILS_HEADERS = ${HOME_DIR}/common/npu_utils.hpp
 NPU_UTILS_HEADERS += ${HOME_DIR}/common/vector_view.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/npu_device.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/npu_reaper.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/npu_bo_pool.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/npu_bo_arena.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/npu_bo_registry.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/npu_launch.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/instr_file.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/npu_userptr_cache.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/host_alloc.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/buffer_ops.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/data_pattern.hpp
+NPU_UTILS_HEADERS += ${HOME_DIR}/common/bf16_convert.hpp
 NPU_INSTR_UTILS_HEADERS += ${HOME_DIR}/common/debug_utils.hpp
 NPU_INSTR_UTILS_HEADERS += ${HOME_DIR}/common/npu_instr_utils.hpp
 NPU_INSTR_UTILS_HEADERS += ${wildcard ${HOME_DIR}/common/instr_utils/*.hpp}
 NPU_UTILS_OBJS = ${HOST_O_DIR}/npu_utils.o
 NPU_INSTR_UTILS_OBJS = ${HOST_O_DIR}/npu_instr_utils.o
+NPU_DEVICE_OBJS = $(patsubst ${HOME_DIR}/common/%.cpp,${HOST_O_DIR}/%.o,${NPU_DEVICE_SRCS})
 HOST_OBJS = $(patsubst $(HOST_SRCDIR)/%.cpp,$(HOST_O_DIR)/%.o,$(HOST_SRCS))
 
 HOST_DEPS = $(HOST_OBJS:.o=.d)
 NPU_UTILS_DEPS = $(NPU_UTILS_OBJS:.o=.d)
 NPU_INSTR_UTILS_DEPS = $(NPU_INSTR_UTILS_OBJS:.o=.d)
+NPU_DEVICE_DEPS = $(NPU_DEVICE_OBJS:.o=.d)
 VERBOSE := 0
 
 CXX := g++-13
@@ -56,9 +71,18 @@ else ifeq ($(DEVICE),npu2)
 	LDFLAGS += -lboost_program_options -lboost_filesystem
 endif
 
+# NO_XRT=1 builds the host with the simulated device backend only,
+# so it runs on machines without XRT or an NPU.
+NO_XRT ?= 0
+ifeq ($(NO_XRT),1)
+	CXXFLAGS += -DNPU_NO_XRT
+	LDFLAGS := $(filter-out -lxrt_coreutil,$(LDFLAGS))
+endif
+# The simulated device, the completion reaper and the host task queues use std::thread
+LDFLAGS += -pthread
 
 
-${HOST_C_TARGET}: ${HOST_OBJS} ${NPU_UTILS_OBJS} ${NPU_INSTR_UTILS_OBJS}
+${HOST_C_TARGET}: ${HOST_OBJS} ${NPU_UTILS_OBJS} ${NPU_INSTR_UTILS_OBJS} ${NPU_DEVICE_OBJS}
 	mkdir -p ${HOST_O_DIR}
 	echo ${HOST_OBJS}
 	$(CXX) -o "$@" $(+) $(LDFLAGS)
@@ -75,5 +99,10 @@ $(HOST_O_DIR)/npu_instr_utils.o: $(NPU_INSTR_UTILS_SRCS) $(NPU_INSTR_UTILS_HEADE
 	-@mkdir -p $(@D)
 	$(CXX) $(CXXFLAGS) -o "$@" "$<"
 
+$(HOST_O_DIR)/npu_device_%.o: ${HOME_DIR}/common/npu_device_%.cpp
+	-@mkdir -p $(@D)
+	$(CXX) $(CXXFLAGS) -o "$@" "$<"
+
 -include $(HOST_DEPS)
--include $(NPU_UTILS_DEPS)
\ No newline at end of file
+-include $(NPU_UTILS_DEPS)
+-include $(NPU_DEVICE_DEPS)
\ No newline at end of file
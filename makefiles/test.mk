@@ -0,0 +1,27 @@
+# Tests of the host library, they run on the simulated backend and need no NPU
+# make test NO_XRT=1 builds every tests/test_*.cpp into build/tests and runs them in order.
+TEST_SRCDIR := ${HOME_DIR}/tests
+TEST_O_DIR := build/tests
+
+TEST_SRCS = $(wildcard ${TEST_SRCDIR}/test_*.cpp)
+TEST_OBJS = $(patsubst $(TEST_SRCDIR)/%.cpp,$(TEST_O_DIR)/%.o,$(TEST_SRCS))
+TEST_TARGETS = $(TEST_OBJS:.o=.exe)
+TEST_DEPS = $(TEST_OBJS:.o=.d)
+
+$(TEST_O_DIR)/%.exe: $(TEST_O_DIR)/%.o ${NPU_UTILS_OBJS} ${NPU_INSTR_UTILS_OBJS} ${NPU_DEVICE_OBJS}
+	$(CXX) -o "$@" $(+) $(LDFLAGS)
+
+$(TEST_O_DIR)/%.o: $(TEST_SRCDIR)/%.cpp
+	-@mkdir -p $(@D)
+	$(CXX) $(CXXFLAGS) -I${TEST_SRCDIR} -o "$@" "$<"
+
+.PRECIOUS: $(TEST_OBJS)
+
+# test_results checks the records compare.exe writes back
+test: ${TEST_TARGETS} ${COMPARE_C_TARGET}
+	@for t in ${TEST_TARGETS}; do \
+		echo "$$t"; \
+		NPU_SIM_XCLBIN_US=0 NPU_SIM_CONTEXT_US=0 NPU_TEST_COMPARE=$(abspath ${COMPARE_C_TARGET}) ./$$t || exit 1; \
+	done
+
+-include $(TEST_DEPS)
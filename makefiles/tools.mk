@@ -0,0 +1,20 @@
+# Offline tools, they only read result files and need neither XRT nor an NPU
+TOOLS_SRCDIR := ${HOME_DIR}/tools
+TOOLS_O_DIR := build/tools
+COMPARE_C_TARGET := compare.exe
+
+COMPARE_SRCS = ${TOOLS_SRCDIR}/bwcompare.cpp
+COMPARE_OBJS = $(patsubst $(TOOLS_SRCDIR)/%.cpp,$(TOOLS_O_DIR)/%.o,$(COMPARE_SRCS))
+COMPARE_DEPS = $(COMPARE_OBJS:.o=.d)
+
+TOOLS_CXXFLAGS = -c -std=c++23 -O2 -MMD -MP -I/usr/include/boost -I${HOME_DIR}/common
+TOOLS_LDFLAGS = -lm -lboost_program_options
+
+${COMPARE_C_TARGET}: ${COMPARE_OBJS}
+	$(CXX) -o "$@" $(+) $(TOOLS_LDFLAGS)
+
+$(TOOLS_O_DIR)/%.o: $(TOOLS_SRCDIR)/%.cpp
+	-@mkdir -p $(@D)
+	$(CXX) $(TOOLS_CXXFLAGS) -o "$@" "$<"
+
+-include $(COMPARE_DEPS)
@@ -0,0 +1,93 @@
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <thread>
+#include "adaptive_bench.hpp"
+#include "test_utils.hpp"
+
+// Warm-up and stopping rules of run_adaptive
+
+static adaptive_config make_config(double tolerance, double time_budget, int max_samples){
+    adaptive_config config = default_adaptive_config;
+    config.tolerance = tolerance;
+    config.time_budget = time_budget;
+    config.max_samples = max_samples;
+    return config;
+}
+
+static void test_constant(){
+    int calls = 0;
+    adaptive_result result = run_adaptive(make_config(0.01, 10.0, 1000), [&](bool){ calls++; return 5.0; });
+    // two agreeing windows, then min_samples with no spread
+    CHECK_EQ(result.warmup_samples, 16);
+    CHECK_EQ(result.samples, 10);
+    CHECK_EQ(calls, 26);
+    CHECK(result.converged);
+    CHECK_EQ(result.mean, 5.0);
+    CHECK_EQ(result.stddev, 0.0);
+    CHECK_EQ(result.ci_half_width, 0.0);
+}
+
+static void test_warmup(){
+    // settles after 40 samples: the windows agree once both are past it
+    int warmup_calls = 0;
+    adaptive_result settled = run_adaptive(make_config(0.01, 10.0, 1000), [&](bool warmup){
+        if (warmup){
+            warmup_calls++;
+        }
+        return warmup && warmup_calls <= 40 ? 1000.0 - warmup_calls * 20 : 100.0;
+    });
+    CHECK_EQ(settled.warmup_samples, 56);
+    CHECK_EQ(settled.mean, 100.0);
+
+    // never settles: stops at max_warmup
+    int count = 0;
+    adaptive_result drifting = run_adaptive(make_config(0.01, 10.0, 1000), [&](bool){ return (double)++count; });
+    CHECK_EQ(drifting.warmup_samples, default_adaptive_config.max_warmup);
+}
+
+static void test_tolerance(){
+    std::mt19937 rng(1);
+    std::normal_distribution<double> dist(100.0, 10.0);
+    adaptive_result result = run_adaptive(make_config(0.01, 10.0, 100000), [&](bool){ return dist(rng); });
+    CHECK(result.converged);
+    CHECK(result.samples > default_adaptive_config.min_samples);
+    CHECK(result.ci_half_width <= 0.01 * result.mean);
+    CHECK(std::fabs(result.mean - 100.0) < 2.0);
+}
+
+static void test_budgets(){
+    // tolerance 0 is never met: stops at max_samples
+    int i = 0;
+    adaptive_result capped = run_adaptive(make_config(0.0, 10.0, 500), [&](bool){ return (i++ % 2) ? 1.0 : 100.0; });
+    CHECK(!capped.converged);
+    CHECK_EQ(capped.samples, 500);
+    CHECK(std::fabs(capped.mean - 50.5) < 1e-9);
+
+    // or when the time budget expires, warm-up included
+    adaptive_result timed = run_adaptive(make_config(0.0, 0.05, 100000), [&](bool){
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return (i++ % 2) ? 1.0 : 100.0;
+    });
+    CHECK(!timed.converged);
+    CHECK(timed.elapsed >= 0.05);
+    CHECK(timed.elapsed < 1.0);
+    CHECK(timed.samples >= 2);
+    CHECK(timed.warmup_samples + timed.samples < 100);
+}
+
+static void test_t_quantile(){
+    CHECK_EQ(t_quantile_95(1), 12.706);
+    CHECK_EQ(t_quantile_95(30), 2.042);
+    CHECK_EQ(t_quantile_95(1000), 1.960);
+    CHECK(std::isinf(t_quantile_95(0)));
+}
+
+int main(){
+    test_utils::run("adaptive constant samples", test_constant);
+    test_utils::run("adaptive warm-up", test_warmup);
+    test_utils::run("adaptive tolerance", test_tolerance);
+    test_utils::run("adaptive budgets", test_budgets);
+    test_utils::run("t quantiles", test_t_quantile);
+    return test_utils::failures();
+}
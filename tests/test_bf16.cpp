@@ -0,0 +1,139 @@
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+#include "bf16_convert.hpp"
+#include "test_utils.hpp"
+
+// bf16 rounding, and every kernel of this CPU against the scalar reference
+
+static float from_bits(uint32_t bits){
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+static uint32_t to_bits(float f){
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+    return bits;
+}
+
+static void test_rounding(){
+    typedef struct {
+        uint32_t input;
+        uint16_t nearest_even;
+        uint16_t toward_zero;
+    } rounding_case;
+    const std::vector<rounding_case> cases = {
+        {0x3f800000, 0x3f80, 0x3f80}, // 1.0, exact
+        {0x3f807fff, 0x3f80, 0x3f80}, // below the tie
+        {0x3f808000, 0x3f80, 0x3f80}, // tie, even stays
+        {0x3f808001, 0x3f81, 0x3f80}, // above the tie
+        {0x3f818000, 0x3f82, 0x3f81}, // tie, odd rounds up to even
+        {0xbf818000, 0xbf82, 0xbf81}, // negative tie
+        {0x7f7fffff, 0x7f80, 0x7f7f}, // largest float rounds to infinity
+        {0x7f800000, 0x7f80, 0x7f80}, // infinity
+        {0xff800000, 0xff80, 0xff80}, // -infinity
+        {0x00000000, 0x0000, 0x0000},
+        {0x80000000, 0x8000, 0x8000}, // -0.0
+        {0x00018000, 0x0002, 0x0001}, // denormal tie
+        {0x7f800001, 0x7fc0, 0x7fc0}, // signaling NaN is quieted, not turned into infinity
+        {0xffc00001, 0xffc0, 0xffc0}, // NaN keeps its sign
+    };
+    for (const rounding_case& c : cases){
+        CHECK_EQ(bf16_ops::narrow(from_bits(c.input), bf16_round_nearest_even), c.nearest_even);
+        CHECK_EQ(bf16_ops::narrow(from_bits(c.input), bf16_round_toward_zero), c.toward_zero);
+    }
+    CHECK_EQ(to_bits(bf16_ops::widen(0x3f81)), 0x3f810000u);
+    CHECK_EQ(to_bits(bf16_ops::widen(0x8000)), 0x80000000u);
+}
+
+static std::vector<bf16_kernel> cpu_kernels(){
+    std::vector<bf16_kernel> kernels = {bf16_kernel_scalar};
+    simd_level level = detect_simd_level();
+    if (level >= simd_avx2){
+        kernels.push_back(bf16_kernel_avx2);
+    }
+    if (level >= simd_avx512){
+        kernels.push_back(bf16_kernel_avx512);
+        if (has_avx512_bf16()){
+            kernels.push_back(bf16_kernel_avx512_bf16);
+        }
+    }
+    return kernels;
+}
+
+// Random bit patterns, so ties, NaNs and infinities show up, plus the tail of a vector
+static std::vector<float> random_floats(size_t count, bool denormals){
+    std::mt19937 gen(1234);
+    std::vector<float> values(count);
+    for (size_t i = 0; i < count; i++){
+        uint32_t bits = gen();
+        if (i % 7 == 0){
+            bits = (bits & 0xffff0000u) | 0x8000u;
+        }
+        if (!denormals && (bits & 0x7f800000u) == 0){
+            bits |= 0x00800000u;
+        }
+        values[i] = from_bits(bits);
+    }
+    return values;
+}
+
+static void test_kernels(){
+    buffer_ops_config cfg = default_buffer_ops_config();
+    for (bf16_kernel kernel : cpu_kernels()){
+        for (bf16_rounding rounding : {bf16_round_nearest_even, bf16_round_toward_zero}){
+            // the native instructions flush denormals to zero
+            std::vector<float> src = random_floats(4099, kernel != bf16_kernel_avx512_bf16);
+            std::vector<std::bfloat16_t> dst(src.size());
+            bf16_ops::to_bf16(kernel, dst.data(), src.data(), src.size(), rounding, cfg);
+            for (size_t i = 0; i < src.size(); i++){
+                uint16_t got;
+                std::memcpy(&got, &dst[i], sizeof(got));
+                uint16_t expected = bf16_ops::narrow(src[i], rounding);
+                if (got != expected){
+                    throw test_utils::check_failed(std::string(bf16_kernel_name(kernel)) + " narrows element " + std::to_string(i)
+                        + " to " + std::to_string(got) + ", expected " + std::to_string(expected));
+                }
+            }
+            std::vector<float> back(src.size());
+            bf16_ops::to_float(kernel, back.data(), dst.data(), dst.size(), cfg);
+            for (size_t i = 0; i < src.size(); i++){
+                uint16_t bits;
+                std::memcpy(&bits, &dst[i], sizeof(bits));
+                CHECK_EQ(to_bits(back[i]), (uint32_t)bits << 16);
+            }
+        }
+    }
+}
+
+static void test_buffer_store(){
+    std::unique_ptr<npu_device> device = create_npu_device(npu_backend_sim);
+    buffer<std::bfloat16_t> b(device->create_bo(100 * sizeof(std::bfloat16_t), npu_bo_host_only, 0));
+    std::vector<float> values(100);
+    for (size_t i = 0; i < values.size(); i++){
+        values[i] = 1.0f + i / 256.0f;
+    }
+    b.track_dirty(true);
+    b.sync_to_device();
+    // elements 40 to 49 are bytes 80 to 99
+    bf16_ops::store(b, values.data(), 10, 40);
+    CHECK((b.dirty_ranges() == std::vector<std::pair<size_t, size_t>>({{64, 128}})));
+    bf16_ops::store(b, values);
+    std::vector<float> back = bf16_ops::load(b);
+    for (size_t i = 0; i < values.size(); i++){
+        // 1 + i/256 needs 8 fraction bits and bf16 has 7, so odd i are ties
+        CHECK_EQ(back[i], bf16_ops::widen(bf16_ops::narrow(values[i], bf16_round_nearest_even)));
+    }
+    CHECK_THROWS(bf16_ops::store(b, values.data(), 2, 99), "out of the buffer");
+    CHECK_THROWS(bf16_ops::store(b, std::vector<float>(3)), "Size mismatch");
+}
+
+int main(){
+    test_utils::run("bf16 rounding", test_rounding);
+    test_utils::run("bf16 kernels", test_kernels);
+    test_utils::run("bf16 buffer store", test_buffer_store);
+    return test_utils::failures();
+}
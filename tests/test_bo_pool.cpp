@@ -0,0 +1,63 @@
+#include <memory>
+#include "npu_device.hpp"
+#include "npu_bo_pool.hpp"
+#include "test_utils.hpp"
+
+// Size classes and reuse of the BO pool
+
+static void test_pool_size_classes(){
+    const size_t page = 4096;
+    CHECK_EQ(npu_bo_pool::size_class(0), page);
+    CHECK_EQ(npu_bo_pool::size_class(1), page);
+    CHECK_EQ(npu_bo_pool::size_class(page), page);
+    CHECK_EQ(npu_bo_pool::size_class(page + 1), 2 * page);
+    CHECK_EQ(npu_bo_pool::size_class(4 * page), 4 * page);
+    // 4 steps between powers of two: 5, 6, 7, 8, then 10, 12, 14, 16 pages
+    CHECK_EQ(npu_bo_pool::size_class(4 * page + 1), 5 * page);
+    CHECK_EQ(npu_bo_pool::size_class(8 * page + 1), 10 * page);
+    CHECK_EQ(npu_bo_pool::size_class(15 * page), 16 * page);
+    CHECK_EQ(npu_bo_pool::size_class(1000 * page), 1024 * page);
+    // the class never wastes more than a quarter of the request
+    for (size_t size = 1; size < (64ul << 20); size = size * 3 / 2 + 1){
+        size_t c = npu_bo_pool::size_class(size);
+        CHECK(c >= size);
+        CHECK(c % page == 0);
+        CHECK(size <= 4 * page || c - size <= size / 4 + page);
+    }
+}
+
+static void test_pool_reuse(){
+    std::unique_ptr<npu_device> device = create_npu_device(npu_backend_sim);
+    npu_bo_pool pool(*device);
+    {
+        npu_bo a = pool.acquire(5 * 4096 - 100, npu_bo_host_only, 3);
+        CHECK_EQ(a.size(), 5ul * 4096 - 100);
+    }
+    npu_bo_pool_stats stats = pool.stats();
+    CHECK_EQ(stats.misses, 1ul);
+    CHECK_EQ(stats.cached, 1ul);
+    {
+        // same class, group and type
+        npu_bo b = pool.acquire(5 * 4096, npu_bo_host_only, 3);
+        // other group, other type, other class
+        npu_bo c = pool.acquire(5 * 4096, npu_bo_host_only, 4);
+        npu_bo d = pool.acquire(5 * 4096, npu_bo_cacheable, 3);
+        npu_bo e = pool.acquire(6 * 4096, npu_bo_host_only, 3);
+    }
+    stats = pool.stats();
+    CHECK_EQ(stats.hits, 1ul);
+    CHECK_EQ(stats.misses, 4ul);
+    CHECK_EQ(stats.live, 0ul);
+    CHECK_EQ(stats.cached, 4ul);
+    pool.set_enabled(false);
+    {
+        npu_bo f = pool.acquire(5 * 4096, npu_bo_host_only, 3);
+    }
+    CHECK_EQ(pool.stats().hits, 1ul);
+}
+
+int main(){
+    test_utils::run("BO pool size classes", test_pool_size_classes);
+    test_utils::run("BO pool reuse", test_pool_reuse);
+    return test_utils::failures();
+}
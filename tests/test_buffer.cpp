@@ -0,0 +1,75 @@
+#include <memory>
+#include <utility>
+#include <vector>
+#include "npu_device.hpp"
+#include "buffer.hpp"
+#include "test_utils.hpp"
+
+// Dirty range tracking of buffer<T>
+
+typedef std::vector<std::pair<size_t, size_t>> ranges;
+
+static void test_dirty_merge(){
+    // without tracking every sync flushes the whole buffer
+    buffer<uint8_t> b(4096);
+    b.mark_dirty(0, 64);
+    CHECK_EQ(b.dirty_bytes(), 4096ul);
+    CHECK(b.dirty_ranges().empty());
+    // turning tracking on marks everything
+    b.track_dirty(true);
+    CHECK(b.dirty_ranges() == ranges({{0, 4096}}));
+    b.track_dirty(false);
+    b.track_dirty(true);
+    CHECK_EQ(b.dirty_bytes(), 4096ul);
+
+    std::unique_ptr<npu_device> device = create_npu_device(npu_backend_sim);
+    buffer<uint8_t> bo_buffer(device->create_bo(4096, npu_bo_host_only, 0));
+    bo_buffer.track_dirty(true);
+    bo_buffer.sync_to_device();
+    CHECK(bo_buffer.dirty_ranges().empty());
+    CHECK_EQ(bo_buffer.dirty_bytes(), 0ul);
+
+    // rounded out to cache lines
+    bo_buffer.mark_dirty(70, 10);
+    CHECK(bo_buffer.dirty_ranges() == ranges({{64, 128}}));
+    // disjoint ranges stay sorted
+    bo_buffer.mark_dirty(1024, 64);
+    bo_buffer.mark_dirty(256, 1);
+    CHECK(bo_buffer.dirty_ranges() == ranges({{64, 128}, {256, 320}, {1024, 1088}}));
+    // adjacent ranges merge
+    bo_buffer.mark_dirty(128, 64);
+    CHECK(bo_buffer.dirty_ranges() == ranges({{64, 192}, {256, 320}, {1024, 1088}}));
+    // a range over several merges them all
+    bo_buffer.mark_dirty(100, 1000);
+    CHECK(bo_buffer.dirty_ranges() == ranges({{64, 1152}}));
+    // the end is clamped to the buffer
+    bo_buffer.mark_dirty(4090, 6);
+    CHECK(bo_buffer.dirty_ranges() == ranges({{64, 1152}, {4032, 4096}}));
+    CHECK_EQ(bo_buffer.dirty_bytes(), 1088ul + 64ul);
+    CHECK_THROWS(bo_buffer.mark_dirty(4090, 7), "out of the buffer");
+
+    bo_buffer.sync_to_device();
+    CHECK(bo_buffer.dirty_ranges().empty());
+}
+
+static void test_dirty_collapse(){
+    std::unique_ptr<npu_device> device = create_npu_device(npu_backend_sim);
+    buffer<uint8_t> bo_buffer(device->create_bo(64 * 1024, npu_bo_host_only, 0));
+    bo_buffer.track_dirty(true);
+    bo_buffer.sync_to_device();
+    // every other cache line, up to the limit
+    for (size_t i = 0; i < bytes::max_dirty_ranges; i++){
+        bo_buffer.mark_dirty(i * 256, 64);
+    }
+    CHECK_EQ(bo_buffer.dirty_ranges().size(), bytes::max_dirty_ranges);
+    CHECK_EQ(bo_buffer.dirty_bytes(), bytes::max_dirty_ranges * 64);
+    // one more collapses them into their bounds
+    bo_buffer.mark_dirty(bytes::max_dirty_ranges * 256, 64);
+    CHECK(bo_buffer.dirty_ranges() == ranges({{0, bytes::max_dirty_ranges * 256 + 64}}));
+}
+
+int main(){
+    test_utils::run("dirty range merging", test_dirty_merge);
+    test_utils::run("dirty range collapse", test_dirty_collapse);
+    return test_utils::failures();
+}
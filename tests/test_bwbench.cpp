@@ -0,0 +1,41 @@
+#include <vector>
+#include "bwbench.hpp"
+#include "test_utils.hpp"
+
+// Sweep ranges of the bandwidth benchmark
+
+static void test_ranges(){
+    CHECK(bwbench::parse_range("4") == std::vector<int>({4}));
+    CHECK(bwbench::parse_range("1,2,4") == std::vector<int>({1, 2, 4}));
+    CHECK(bwbench::parse_range("1:8") == std::vector<int>({1, 2, 4, 8}));
+    CHECK(bwbench::parse_range("3:10") == std::vector<int>({3, 6}));
+    CHECK(bwbench::parse_range("8:32:8,64") == std::vector<int>({8, 16, 24, 32, 64}));
+}
+
+static void test_invalid_ranges(){
+    CHECK_THROWS(bwbench::parse_range("1:x"), "Invalid number 'x' in range: 1:x");
+    CHECK_THROWS(bwbench::parse_range("4x"), "Invalid number '4x'");
+    CHECK_THROWS(bwbench::parse_range("1,,2"), "Invalid range");
+    CHECK_THROWS(bwbench::parse_range("99999999999"), "Invalid number");
+    CHECK_THROWS(bwbench::parse_range("0"), "it must be at least 1");
+    CHECK_THROWS(bwbench::parse_range("-4"), "it must be at least 1");
+    CHECK_THROWS(bwbench::parse_range("0:4"), "Invalid range: 0:4");
+    CHECK_THROWS(bwbench::parse_range("8:4"), "Invalid range");
+    CHECK_THROWS(bwbench::parse_range("1:8:0"), "Invalid range");
+    CHECK_THROWS(bwbench::parse_range("1:2:3:4"), "Invalid range");
+    CHECK_THROWS(bwbench::parse_range(""), "Empty range");
+}
+
+static void test_columns(){
+    bwbench::check_columns({1, 4}, "npu1");
+    bwbench::check_columns({8}, "npu2");
+    CHECK_THROWS(bwbench::check_columns({8}, "npu1"), "Invalid column count 8 for npu1, it has 4 columns");
+    CHECK_THROWS(bwbench::check_columns({16}, "npu2"), "it has 8 columns");
+}
+
+int main(){
+    test_utils::run("sweep ranges", test_ranges);
+    test_utils::run("invalid sweep ranges", test_invalid_ranges);
+    test_utils::run("column counts", test_columns);
+    return test_utils::failures();
+}
@@ -0,0 +1,68 @@
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "result_writer.hpp"
+#include "utils.hpp"
+#include "test_utils.hpp"
+
+// The records compare.exe --update writes back into the baseline, keys sorted.
+// make test passes the path of compare.exe in NPU_TEST_COMPARE.
+
+static std::string read_file(const std::string& path){
+    std::ifstream file(path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+static std::string update(const utils::temp_dir& scratch, const std::string& current_name){
+    const char* compare = std::getenv("NPU_TEST_COMPARE");
+    if (compare == nullptr){
+        throw std::runtime_error("NPU_TEST_COMPARE is not set to the path of compare.exe");
+    }
+    std::string baseline = scratch.file("baseline.jsonl");
+    std::remove(baseline.c_str());
+    std::string command = std::string(compare) + " --baseline " + baseline + " --current " + scratch.file(current_name)
+        + " --update > " + scratch.file("compare.log");
+    CHECK_EQ(std::system(command.c_str()), 0);
+    return read_file(baseline);
+}
+
+// JSON lines come back as they were, strings quoted and numbers not
+static void test_json_round_trip(){
+    utils::temp_dir scratch("test_compare");
+    std::string json = "{\"aie_version\":\"2.0\",\"backend\":\"sim\",\"bandwidth_samples_gibps\":[1.25,1.5,1.75],"
+        "\"device\":\"npu2\",\"integrity\":\"pass\",\"iterations\":32,\"latency_ns\":null,"
+        "\"name\":\"quote \\\" back\\\\slash \\n\\t\\r\\b\\f \\u0001\",\"passed\":true}\n";
+    std::ofstream(scratch.file("current.jsonl")) << json;
+    CHECK_EQ(update(scratch, "current.jsonl"), json);
+}
+
+// CSV cells are typed by the columns of result_writer: its string columns stay strings
+// whatever they read as, and an empty cell of a number column is null
+static void test_csv_round_trip(){
+    utils::temp_dir scratch("test_compare");
+    result_record record;
+    record.add("name", "a, b");
+    record.add("device", "npu2");
+    record.add("backend", "sim");
+    record.add("iterations", 32);
+    record.add("aie_version", "2.0");
+    record.add("fw_version", "");
+    record.add("latency_ns", std::numeric_limits<double>::quiet_NaN());
+    record.add("passed", false);
+    record.add("bandwidth_samples_gibps", std::vector<double>{2, 3});
+    {
+        result_writer writer(scratch.file("current.csv"), result_format_csv);
+        writer.write(record);
+    }
+    CHECK_EQ(update(scratch, "current.csv"), std::string("{\"aie_version\":\"2.0\",\"backend\":\"sim\",\"bandwidth_samples_gibps\":[2,3],")
+        + "\"device\":\"npu2\",\"fw_version\":\"\",\"iterations\":32,\"latency_ns\":null,\"name\":\"a, b\",\"passed\":false}\n");
+}
+
+int main(){
+    test_utils::run("compare.exe JSON round trip", test_json_round_trip);
+    test_utils::run("compare.exe CSV round trip", test_csv_round_trip);
+    return test_utils::failures();
+}
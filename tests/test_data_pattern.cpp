@@ -0,0 +1,118 @@
+#include <cstdint>
+#include <vector>
+#include "data_pattern.hpp"
+#include "test_utils.hpp"
+
+// Generation and verification of the integrity data patterns
+
+static std::vector<buffer_ops_config> configs(){
+    std::vector<buffer_ops_config> cfgs;
+    std::vector<simd_level> levels = {simd_scalar};
+    if (detect_simd_level() >= simd_avx2){
+        levels.push_back(simd_avx2);
+    }
+    for (simd_level level : levels){
+        for (int threads : {1, 4}){
+            // small chunks, so the test sizes are split across the threads
+            cfgs.push_back({level, threads, 4096, nt_never});
+        }
+    }
+    return cfgs;
+}
+
+static const std::vector<data_pattern> patterns = {
+    {pattern_index, 0x100u, 0},
+    {pattern_prbs, 0x5EEDu, 0},
+    {pattern_column, 0x5EEDu, 1000},
+};
+
+static void test_fill(){
+    for (const buffer_ops_config& cfg : configs()){
+        for (const data_pattern& p : patterns){
+            std::vector<uint32_t> data(10007);
+            data_patterns::fill(data.data(), data.size(), p, 333, cfg);
+            for (size_t i = 0; i < data.size(); i++){
+                CHECK_EQ(data[i], data_patterns::value(p, 333 + i));
+            }
+        }
+    }
+    CHECK_THROWS(data_patterns::fill(nullptr, 16, data_pattern{pattern_column, 1, 0}), "needs a region size");
+    CHECK_EQ(parse_pattern_kind("column"), pattern_column);
+    CHECK_THROWS(parse_pattern_kind("zeros"), "Unknown data pattern: zeros");
+}
+
+static void test_verify(){
+    const size_t burst = 1024;
+    for (const buffer_ops_config& cfg : configs()){
+        for (const data_pattern& p : patterns){
+            std::vector<uint32_t> data(8 * burst + 100);
+            data_patterns::fill(data.data(), data.size(), p, 0, cfg);
+            integrity_report clean = data_patterns::verify(data.data(), data.size(), p, burst, 16, cfg);
+            CHECK_EQ(clean.words, data.size());
+            CHECK_EQ(clean.bad_words, 0ul);
+            CHECK(clean.bursts.empty());
+
+            // one word of burst 0, two of burst 3 and one of the partial last burst
+            data[5] = data_patterns::value(p, 77);
+            data[3 * burst + 10] ^= 1;
+            data[3 * burst + 900] = 0;
+            data[8 * burst + 99] += 1;
+            integrity_report report = data_patterns::verify(data.data(), data.size(), p, burst, 16, cfg);
+            CHECK_EQ(report.bad_words, 4ul);
+            CHECK_EQ(report.bad_bursts, 3ul);
+            CHECK_EQ(report.bursts.size(), 3ul);
+            CHECK_EQ(report.bursts[0].burst, 0ul);
+            CHECK_EQ(report.bursts[0].offset, 5 * sizeof(uint32_t));
+            CHECK_EQ(report.bursts[0].expected, data_patterns::value(p, 5));
+            CHECK_EQ(report.bursts[0].actual, data_patterns::value(p, 77));
+            // only the index pattern tells where a word came from
+            CHECK_EQ(report.bursts[0].source, p.kind == pattern_index ? 77 : -1);
+            CHECK_EQ(report.bursts[1].burst, 3ul);
+            CHECK_EQ(report.bursts[1].offset, (3 * burst + 10) * sizeof(uint32_t));
+            CHECK_EQ(report.bursts[1].bad_words, 2ul);
+            CHECK_EQ(report.bursts[2].burst, 8ul);
+
+            // the counts cover every burst, the records only the lowest ones
+            integrity_report limited = data_patterns::verify(data.data(), data.size(), p, burst, 2, cfg);
+            CHECK_EQ(limited.bad_bursts, 3ul);
+            CHECK_EQ(limited.bursts.size(), 2ul);
+            CHECK_EQ(limited.bursts[1].burst, 3ul);
+        }
+    }
+    std::vector<uint32_t> data(16);
+    CHECK_THROWS(data_patterns::verify(data.data(), data.size(), patterns[0], 0), "Burst size must not be 0");
+}
+
+// data of the right pattern in the wrong place does not verify
+static void test_misplaced(){
+    const data_pattern p = patterns[2];
+    std::vector<uint32_t> data(4 * p.region_words);
+    data_patterns::fill(data.data(), p.region_words, p, p.region_words);
+    data_patterns::fill(data.data() + p.region_words, 3 * p.region_words, p, p.region_words);
+    integrity_report report = data_patterns::verify(data.data(), data.size(), p, p.region_words);
+    CHECK_EQ(report.bad_bursts, 1ul);
+    CHECK_EQ(report.bursts[0].burst, 0ul);
+    CHECK_EQ(report.bad_words, p.region_words);
+}
+
+static void test_intact_bursts(){
+    const size_t burst = 256;
+    const data_pattern p = patterns[1];
+    std::vector<uint32_t> data(6 * burst + 10);
+    data_patterns::fill(data.data(), data.size(), p);
+    CHECK((data_patterns::intact_bursts(data.data(), data.size(), p, burst) == std::vector<size_t>{0, 1, 2, 3, 4, 5, 6}));
+    // bursts 1 and 4 written, so they no longer hold the pattern
+    data[burst] = 0;
+    data[5 * burst - 1] = 0;
+    CHECK((data_patterns::intact_bursts(data.data(), data.size(), p, burst) == std::vector<size_t>{0, 2, 3, 5, 6}));
+    data[6 * burst + 9] = 0;
+    CHECK((data_patterns::intact_bursts(data.data(), data.size(), p, burst) == std::vector<size_t>{0, 2, 3, 5}));
+}
+
+int main(){
+    test_utils::run("pattern fill", test_fill);
+    test_utils::run("pattern verify", test_verify);
+    test_utils::run("misplaced pattern", test_misplaced);
+    test_utils::run("intact bursts", test_intact_bursts);
+    return test_utils::failures();
+}
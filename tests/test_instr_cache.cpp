@@ -0,0 +1,58 @@
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "npu_utils.hpp"
+#include "bwbench.hpp"
+#include "instrbench.hpp"
+#include "utils.hpp"
+#include "test_utils.hpp"
+
+// Instruction BOs shared by content between registrations, on the simulated backend
+
+static int register_sequence(npu_app& npu_instance, const std::string& path){
+    accel_user_desc desc = bwbench::resolve_artifacts(bwbench::default_config, "npu2", npu_instance.get_backend());
+    desc.instr_name = path;
+    return npu_instance.register_accel_app(desc);
+}
+
+static void test_shared_by_content(){
+    npu_app npu_instance(1, 1, 0, npu_backend_sim);
+    utils::temp_dir scratch("test_instr_cache");
+    std::vector<uint32_t> seq = instrbench::make_sequence("npu2", 256);
+    std::vector<uint32_t> other = instrbench::make_sequence("npu2", 512);
+    bwbench::write_sequence(seq, scratch.file("a.bin"));
+    bwbench::write_sequence(seq, scratch.file("b.bin"));
+    instrbench::write_text(seq, scratch.file("c.hex"));
+    bwbench::write_sequence(other, scratch.file("d.bin"));
+
+    int a = register_sequence(npu_instance, scratch.file("a.bin"));
+    int b = register_sequence(npu_instance, scratch.file("b.bin"));
+    int c = register_sequence(npu_instance, scratch.file("c.hex"));
+    int d = register_sequence(npu_instance, scratch.file("d.bin"));
+    const std::vector<accel_registration>& regs = npu_instance.get_registrations();
+    CHECK_EQ(regs.size(), 4ul);
+    CHECK(!regs[0].instr_cached);
+    // the same words from another file, binary or text, share the BO
+    CHECK(regs[1].instr_cached);
+    CHECK(regs[2].instr_cached);
+    CHECK(!regs[3].instr_cached);
+    CHECK_EQ(regs[2].format, instr_format_text);
+
+    // every app runs, on its own BO or the shared one
+    npu_bo A = npu_instance.create_buffer(4096, 3, a);
+    npu_bo C = npu_instance.create_buffer(4096, 4, a);
+    npu_bo T = npu_instance.create_buffer(4096, 5, a);
+    for (int app_id : {a, b, c, d}){
+        CHECK_EQ(npu_instance.run(app_id, A, C, T), ERT_CMD_STATE_COMPLETED);
+    }
+    instr_cache_stats stats = npu_instance.get_instr_cache_stats();
+    CHECK_EQ(stats.lookups, 4ul);
+    CHECK_EQ(stats.hits, 2ul);
+    CHECK_EQ(stats.bytes, (seq.size() + other.size()) * sizeof(uint32_t));
+    CHECK_EQ(stats.saved_bytes, 2 * seq.size() * sizeof(uint32_t));
+}
+
+int main(){
+    test_utils::run("instruction BOs shared by content", test_shared_by_content);
+    return test_utils::failures();
+}
@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "instr_file.hpp"
+#include "utils.hpp"
+#include "test_utils.hpp"
+
+// Text parsing and format detection of instruction files
+
+static std::vector<uint32_t> parse(const std::string& text, size_t max_words = 64){
+    std::vector<uint32_t> out(max_words);
+    size_t n = instr_text::parse(text.data(), text.data() + text.size(), out.data(), max_words);
+    CHECK_EQ(n, instr_text::count_words(text.data(), text.data() + text.size()));
+    out.resize(n);
+    return out;
+}
+
+static void test_parse(){
+    CHECK((parse("00000001\n0000FFFF\nDEADbeef\n") == std::vector<uint32_t>{1, 0xFFFF, 0xDEADBEEF}));
+    // the last word without a newline, CRLF, tabs, 0x prefixes and short words
+    CHECK((parse("0x12345678\r\n\tabc  0XF\n\n7") == std::vector<uint32_t>{0x12345678, 0xABC, 0xF, 7}));
+    CHECK((parse("ffffffff") == std::vector<uint32_t>{0xFFFFFFFF}));
+    CHECK(parse("").empty());
+    CHECK(parse(" \n\r\n\t").empty());
+}
+
+static void test_parse_errors(){
+    CHECK_THROWS(parse("123456789\n"), "at word 0");
+    CHECK_THROWS(parse("00000001\n0000g000\n"), "at word 1");
+    CHECK_THROWS(parse("00000001 12 x\n"), "at word 2");
+    // a lone 0x is not a prefix
+    CHECK_THROWS(parse("0 0x"), "at word 1");
+    CHECK_THROWS(parse("1 2 3 4", 3), "more than 3 words");
+    CHECK((parse("1 2 3", 3) == std::vector<uint32_t>{1, 2, 3}));
+}
+
+static void test_files(){
+    utils::temp_dir scratch("test_instr_file");
+    std::vector<uint32_t> words = {0x06030100, 0x00000105, 0x00000000, 0x00000010, 0xDEADBEEF};
+    std::ofstream(scratch.file("seq.bin"), std::ios::binary).write(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint32_t));
+    std::ofstream(scratch.file("seq.txt")) << "06030100\n00000105\n00000000\n00000010\ndeadbeef\n";
+    for (const char* name : {"seq.bin", "seq.txt"}){
+        instr_file file(scratch.file(name));
+        CHECK_EQ(file.format(), std::string(name) == "seq.bin" ? instr_format_binary : instr_format_text);
+        CHECK_EQ(file.words(), words.size());
+        std::vector<uint32_t> out(file.words());
+        CHECK_EQ(file.read(out.data(), out.size()), words.size());
+        CHECK(out == words);
+        CHECK_THROWS(file.read(out.data(), 4), "more than 4 words");
+    }
+    // a forced format overrides the detection
+    std::ofstream(scratch.file("four.txt")) << "00000001\n00000002\n00000003\n00000004\n";
+    instr_file forced(scratch.file("four.txt"), instr_format_binary);
+    CHECK_EQ(forced.format(), instr_format_binary);
+    CHECK_EQ(forced.words(), 9ul);
+
+    std::ofstream(scratch.file("empty.txt"));
+    CHECK_THROWS(instr_file(scratch.file("empty.txt")), "is empty");
+    std::ofstream(scratch.file("odd.bin"), std::ios::binary).write("\x01\x02\x03\x04\x05", 5);
+    CHECK_THROWS(instr_file(scratch.file("odd.bin")), "not a whole number of words");
+    CHECK_THROWS(instr_file(scratch.file("missing.txt")), "Failed to open");
+}
+
+int main(){
+    test_utils::run("instruction text parsing", test_parse);
+    test_utils::run("instruction text errors", test_parse_errors);
+    test_utils::run("instruction files", test_files);
+    return test_utils::failures();
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "latency_histogram.hpp"
+#include "test_utils.hpp"
+
+// Percentiles of latency_histogram against the sorted samples
+
+static uint64_t exact_percentile(std::vector<uint64_t> values, double p){
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+    return values[std::max<size_t>(rank, 1) - 1];
+}
+
+static void test_exact_range(){
+    latency_histogram hist;
+    CHECK_EQ(hist.percentile(50), 0ul);
+    CHECK_EQ(hist.min(), 0ul);
+    // below 2^sub_bucket_bits every value has its own bucket
+    for (uint64_t v = 1; v <= 100; v++){
+        hist.record(v);
+    }
+    CHECK_EQ(hist.count(), 100ul);
+    CHECK_EQ(hist.min(), 1ul);
+    CHECK_EQ(hist.max(), 100ul);
+    CHECK_EQ(hist.percentile(0), 1ul);
+    CHECK_EQ(hist.percentile(50), 50ul);
+    CHECK_EQ(hist.percentile(99), 99ul);
+    CHECK_EQ(hist.percentile(99.9), 100ul);
+    CHECK_EQ(hist.percentile(100), 100ul);
+    CHECK(std::abs(hist.mean() - 50.5) < 1e-9);
+    CHECK(std::abs(hist.stddev() - std::sqrt(841.6666666666666)) < 1e-6);
+    hist.reset();
+    CHECK_EQ(hist.count(), 0ul);
+    CHECK_EQ(hist.max(), 0ul);
+}
+
+// above that a percentile is the upper bound of its bucket, within 2^-(sub_bucket_bits - 1)
+static void test_relative_error(){
+    for (int bits : {3, 7, 10}){
+        std::mt19937_64 rng(bits);
+        std::lognormal_distribution<double> dist(10.0, 2.0);
+        latency_histogram hist(bits);
+        std::vector<uint64_t> values;
+        for (int i = 0; i < 20000; i++){
+            uint64_t v = (uint64_t)dist(rng);
+            values.push_back(v);
+            hist.record(v);
+        }
+        double error = std::ldexp(1.0, -(bits - 1));
+        for (double p : {1.0, 10.0, 50.0, 90.0, 99.0, 99.9, 100.0}){
+            uint64_t exact = exact_percentile(values, p);
+            uint64_t got = hist.percentile(p);
+            CHECK(got >= exact);
+            CHECK(got <= exact + exact * error);
+        }
+        CHECK_EQ(hist.percentile(100), *std::max_element(values.begin(), values.end()));
+        CHECK_EQ(hist.percentile(0), *std::min_element(values.begin(), values.end()));
+    }
+    latency_histogram hist;
+    hist.record(UINT64_MAX);
+    CHECK_EQ(hist.percentile(50), UINT64_MAX);
+}
+
+static void test_merge(){
+    latency_histogram a;
+    latency_histogram b;
+    latency_histogram all;
+    for (uint64_t i = 0; i < 1000; i++){
+        uint64_t v = i * i * 37 + 5;
+        (i % 3 ? a : b).record(v);
+        all.record(v);
+    }
+    a.merge(b);
+    CHECK_EQ(a.count(), all.count());
+    CHECK_EQ(a.min(), all.min());
+    CHECK_EQ(a.max(), all.max());
+    for (double p : {25.0, 50.0, 75.0, 99.0}){
+        CHECK_EQ(a.percentile(p), all.percentile(p));
+    }
+    CHECK_THROWS(a.merge(latency_histogram(5)), "different precision");
+    CHECK_THROWS(latency_histogram(0), "sub_bucket_bits must be in [1, 16]");
+    CHECK_THROWS(latency_histogram(17), "sub_bucket_bits must be in [1, 16]");
+}
+
+int main(){
+    test_utils::run("histogram exact range", test_exact_range);
+    test_utils::run("histogram relative error", test_relative_error);
+    test_utils::run("histogram merge", test_merge);
+    return test_utils::failures();
+}
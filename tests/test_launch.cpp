@@ -0,0 +1,128 @@
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "npu_utils.hpp"
+#include "launchbench.hpp"
+#include "test_utils.hpp"
+
+// Argument checks of npu_launch against the kernel signature of the simulated backend:
+// opcode, instr, ninstr and 5 BO slots, like the MLIR_AIE kernels aiecc generates.
+
+typedef struct {
+    std::unique_ptr<npu_device> device;
+    npu_kernel kernel;
+    npu_bo instr;
+    npu_bo A;
+    npu_bo C;
+    npu_bo T;
+} launch_fixture;
+
+static launch_fixture make_fixture(){
+    launch_fixture f;
+    f.device = create_npu_device(npu_backend_sim);
+    f.kernel = f.device->load_xclbin("test.xclbin", default_npu_qos);
+    f.instr = f.device->create_bo(64, npu_bo_cacheable, 1);
+    std::memset(f.instr.map<uint8_t*>(), 0, 64);
+    f.A = f.device->create_bo(4096, npu_bo_host_only, 3);
+    f.C = f.device->create_bo(4096, npu_bo_host_only, 4);
+    f.T = f.device->create_bo(4096, npu_bo_host_only, 5);
+    return f;
+}
+
+static npu_launch make_launch(launch_fixture& f, int arg_count){
+    npu_launch launch(f.kernel.create_run(), f.kernel.name(), f.kernel.args(), arg_count);
+    launch.bind_instr(f.instr, 0);
+    return launch;
+}
+
+static void test_arity(){
+    launch_fixture f = make_fixture();
+    CHECK_THROWS(make_launch(f, 6), "the design declares 6");
+    npu_launch launch = make_launch(f, 3);
+    launch.bind(f.A, f.C);
+    CHECK_THROWS(launch.check_complete(), "Argument 5 (bo2) of kernel");
+    CHECK_THROWS(launch.start(), "is not bound");
+    CHECK_THROWS(launch.bind(f.A, f.C, f.T, f.T), "takes 3 arguments after the instructions, got more");
+    launch.bind(f.A, f.C, f.T);
+    launch.check_complete();
+    launch.start();
+    CHECK_EQ(launch.wait(), ERT_CMD_STATE_COMPLETED);
+
+    // every slot of the signature by default
+    npu_launch all = make_launch(f, -1);
+    all.bind(f.A, f.C, f.T);
+    CHECK_THROWS(all.check_complete(), "the design takes 5 arguments");
+}
+
+static void test_kinds_and_sizes(){
+    launch_fixture f = make_fixture();
+    npu_launch launch = make_launch(f, 3);
+    CHECK_THROWS(launch.bind(f.A, 16u), "Argument 4 (bo1) of kernel " + f.kernel.name() + " is a BO, got a scalar");
+    CHECK_THROWS(launch.bind(f.A, f.C, npu_bo()), "is an empty BO");
+
+    // a design with a 4 byte scalar after the instructions
+    std::vector<npu_kernel_arg> signature = f.kernel.args();
+    signature[3] = {"size", npu_arg_scalar, 4};
+    npu_launch scalar_launch(f.kernel.create_run(), f.kernel.name(), signature, 2);
+    scalar_launch.bind_instr(f.instr, 0);
+    CHECK_THROWS(scalar_launch.bind((uint64_t)16, f.C), "Argument 3 (size) of kernel " + f.kernel.name() + " has 4 bytes, got 8");
+    CHECK_THROWS(scalar_launch.bind((uint16_t)16, f.C), "has 4 bytes, got 2");
+    CHECK_THROWS(scalar_launch.bind(f.A, f.C), "is a scalar, got a BO");
+    scalar_launch.bind(16u, f.C);
+    scalar_launch.check_complete();
+}
+
+static void test_rebinding(){
+    launch_fixture f = make_fixture();
+    npu_launch launch = make_launch(f, 3);
+    CHECK_EQ(launch.set_args(), 3ul);
+    launch.bind(f.A, f.C, f.T);
+    CHECK_EQ(launch.set_args(), 6ul);
+    // the same BOs do not touch the run
+    launch.bind(f.A, f.C, f.T);
+    CHECK_EQ(launch.set_args(), 6ul);
+    // a copy of a handle is the same BO
+    npu_bo same = f.C;
+    launch.bind(f.A, same);
+    CHECK_EQ(launch.set_args(), 6ul);
+    launch.bind(f.C, f.A);
+    CHECK_EQ(launch.set_args(), 8ul);
+    launch.bind_instr(f.instr, 0);
+    CHECK_EQ(launch.set_args(), 8ul);
+}
+
+// npu_app::run must not hold the BOs of a call, or imported memory stays pinned after the
+// caller freed it, and a new allocation at the same address gets the stale BO
+static void test_run_releases_bos(){
+    npu_app npu_instance(1, 1, 0, npu_backend_sim);
+    int app_id = launchbench::register_nop(npu_instance, "npu2");
+    npu_bo C = npu_instance.create_buffer(4096, 4, app_id);
+    npu_bo T = npu_instance.create_buffer(4096, 5, app_id);
+    void* memory = std::aligned_alloc(4096, 4096);
+    {
+        npu_bo A = npu_instance.import_buffer(memory, 4096, 3, app_id);
+        CHECK_EQ(npu_instance.run(app_id, A, C, T), ERT_CMD_STATE_COMPLETED);
+        CHECK_EQ(npu_instance.run(A, C, T, app_id), ERT_CMD_STATE_COMPLETED);
+    }
+    npu_userptr_stats stats = npu_instance.get_userptr_cache().stats();
+    CHECK_EQ(stats.entries, 0ul);
+    CHECK_EQ(stats.releases, 1ul);
+    std::free(memory);
+
+    memory = std::aligned_alloc(4096, 4096);
+    npu_bo A = npu_instance.import_buffer(memory, 4096, 3, app_id);
+    stats = npu_instance.get_userptr_cache().stats();
+    CHECK_EQ(stats.hits, 0ul);
+    CHECK_EQ(stats.misses, 2ul);
+    A = npu_bo();
+    std::free(memory);
+}
+
+int main(){
+    test_utils::run("launch arity", test_arity);
+    test_utils::run("launch kinds and scalar sizes", test_kinds_and_sizes);
+    test_utils::run("launch rebinding", test_rebinding);
+    test_utils::run("run releases its BOs", test_run_releases_bos);
+    return test_utils::failures();
+}
@@ -0,0 +1,62 @@
+#include <vector>
+#include "npu_device.hpp"
+#include "test_utils.hpp"
+
+// parse_npu_qos and npu_qos_str
+
+static bool same_qos(const amdxdna_qos_info& a, const amdxdna_qos_info& b){
+    for (const auto& field : npu_qos_fields()){
+        if (a.*field.second != b.*field.second){
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_round_trip(){
+    std::vector<amdxdna_qos_info> cases = {default_npu_qos, no_npu_qos};
+    amdxdna_qos_info all = {};
+    all.gops = 1000;
+    all.fps = 30;
+    all.dma_bandwidth = 10;
+    all.latency = 33;
+    all.frame_exec_time = 10;
+    all.priority = AMDXDNA_QOS_LOW_PRIORITY;
+    cases.push_back(all);
+    for (uint32_t p : std::vector<uint32_t>{AMDXDNA_QOS_REALTIME_PRIORITY, AMDXDNA_QOS_HIGH_PRIORITY, AMDXDNA_QOS_NORMAL_PRIORITY, 0x123}){
+        amdxdna_qos_info qos = {};
+        qos.priority = p;
+        cases.push_back(qos);
+    }
+    for (const amdxdna_qos_info& qos : cases){
+        std::string str = npu_qos_str(qos);
+        CHECK(same_qos(parse_npu_qos(str), qos));
+        CHECK_EQ(npu_qos_str(parse_npu_qos(str)), str);
+    }
+}
+
+static void test_strings(){
+    CHECK_EQ(npu_qos_str(default_npu_qos), std::string("dma_bandwidth=180,gops=100000,priority=high"));
+    CHECK_EQ(npu_qos_str(no_npu_qos), std::string("none"));
+    CHECK(same_qos(parse_npu_qos("default"), default_npu_qos));
+    CHECK(same_qos(parse_npu_qos(""), no_npu_qos));
+    CHECK(same_qos(parse_npu_qos("none"), no_npu_qos));
+    // numeric priorities and any field order
+    CHECK_EQ(npu_qos_str(parse_npu_qos("priority=0x200,gops=5")), std::string("gops=5,priority=normal"));
+    // zero fields are left to the driver
+    CHECK_EQ(npu_qos_str(parse_npu_qos("fps=0,latency=4")), std::string("latency=4"));
+}
+
+static void test_invalid(){
+    CHECK_THROWS(parse_npu_qos("gops=fast"), "Invalid QoS value");
+    CHECK_THROWS(parse_npu_qos("gops=12x"), "Invalid QoS value");
+    CHECK_THROWS(parse_npu_qos("priority=urgent"), "Invalid QoS value");
+    CHECK_THROWS(parse_npu_qos("speed=1"), "Unknown QoS field");
+}
+
+int main(){
+    test_utils::run("qos round trip", test_round_trip);
+    test_utils::run("qos strings", test_strings);
+    test_utils::run("qos invalid", test_invalid);
+    return test_utils::failures();
+}
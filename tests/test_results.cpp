@@ -0,0 +1,77 @@
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include "result_writer.hpp"
+#include "utils.hpp"
+#include "test_utils.hpp"
+
+// The JSON and CSV result writers
+
+static std::string read_file(const std::string& path){
+    std::ifstream file(path);
+    std::stringstream ss;
+    ss << file.rdbuf();
+    return ss.str();
+}
+
+static result_record sample_record(const std::string& name){
+    result_record record;
+    record.add("name", name);
+    record.add("iterations", 32);
+    record.add("bandwidth_gibps", 1.5);
+    record.add("latency_ns", std::numeric_limits<double>::quiet_NaN());
+    record.add("passed", true);
+    record.add("bandwidth_samples_gibps", std::vector<double>{1.25, 1.5, 1.75});
+    return record;
+}
+
+static void test_json(){
+    result_record record = sample_record("a \"quoted\", comma\\path\n\ttab\x01");
+    CHECK_EQ(record.to_json(), std::string("{\"name\":\"a \\\"quoted\\\", comma\\\\path\\n\\ttab\\u0001\",\"iterations\":32,")
+        + "\"bandwidth_gibps\":1.5,\"latency_ns\":null,\"passed\":true,\"bandwidth_samples_gibps\":[1.25,1.5,1.75]}");
+}
+
+static void test_csv(){
+    result_record record = sample_record("a \"quoted\", comma");
+    CHECK_EQ(record.csv_header(), std::string("name,iterations,bandwidth_gibps,latency_ns,passed,bandwidth_samples_gibps"));
+    CHECK_EQ(record.to_csv(), std::string("\"a \"\"quoted\"\", comma\",32,1.5,,true,1.25;1.5;1.75"));
+    // a bare carriage return would end the row for most CSV readers
+    CHECK_EQ(sample_record("line\rbreak").to_csv(), std::string("\"line\rbreak\",32,1.5,,true,1.25;1.5;1.75"));
+    CHECK_EQ(sample_record("line\nbreak").to_csv(), std::string("\"line\nbreak\",32,1.5,,true,1.25;1.5;1.75"));
+}
+
+static void test_csv_header(){
+    utils::temp_dir scratch("test_results");
+    std::string path = scratch.file("results.csv");
+    {
+        result_writer writer(path, result_format_csv);
+        writer.write(sample_record("first"));
+    }
+    {
+        // appending keeps the header of the file
+        result_writer writer(path, result_format_csv);
+        writer.write(sample_record("second"));
+        result_record other;
+        other.add("name", "other benchmark");
+        CHECK_THROWS(writer.write(other), "holds records with other columns");
+    }
+    CHECK_EQ(read_file(path), sample_record("").csv_header() + "\nfirst,32,1.5,,true,1.25;1.5;1.75\nsecond,32,1.5,,true,1.25;1.5;1.75\n");
+}
+
+// every kind of record carries the device, compare.exe matches records by it
+static void test_record_device(){
+    result_context context = {"npu2", 32, 8192, default_adaptive_config, npu_environment()};
+    ops_result ops = {"copy", "avx2", 4, false, 12.5};
+    std::string header = make_ops_record(ops, 4096, context).csv_header();
+    CHECK(header.find(",device,") != std::string::npos);
+    CHECK(make_ops_record(ops, 4096, context).to_json().find("\"device\":\"npu2\"") != std::string::npos);
+}
+
+int main(){
+    test_utils::run("JSON records", test_json);
+    test_utils::run("CSV records", test_csv);
+    test_utils::run("CSV header", test_csv_header);
+    test_utils::run("record device", test_record_device);
+    return test_utils::failures();
+}
@@ -0,0 +1,49 @@
+#include <cstdint>
+#include <vector>
+#include "stream_pipeline.hpp"
+#include "launchbench.hpp"
+#include "test_utils.hpp"
+
+// stream_pipeline on the simulated backend, with the no-operation sequence of launchbench
+
+static void test_depth(){
+    npu_app npu_instance(1, 1, 0, npu_backend_sim);
+    int app_id = launchbench::register_nop(npu_instance, "npu2");
+    npu_bo T = npu_instance.create_buffer(4096, 5, app_id);
+    CHECK_THROWS((stream_pipeline<uint32_t, uint32_t>(npu_instance, app_id, 0, 1024, 1024, &T)), "depth must be at least 1");
+    CHECK_THROWS((stream_pipeline<uint32_t, uint32_t>(npu_instance, app_id, -1, 1024, 1024, &T)), "depth must be at least 1");
+}
+
+// every item is filled once and drained once, in submission order, from the set it was filled in
+static void test_order(){
+    npu_app npu_instance(1, 1, 0, npu_backend_sim);
+    int app_id = launchbench::register_nop(npu_instance, "npu2");
+    npu_bo T = npu_instance.create_buffer(4096, 5, app_id);
+    for (int depth : {1, 2, 3}){
+        stream_pipeline<uint32_t, uint32_t> stream(npu_instance, app_id, depth, 1024, 1024, &T);
+        std::vector<size_t> filled;
+        std::vector<size_t> drained;
+        std::vector<uint32_t*> fill_sets;
+        std::vector<uint32_t*> drain_sets;
+        stream_stats stats = stream.run(7,
+            [&](buffer<uint32_t>& in, size_t i){ filled.push_back(i); fill_sets.push_back(in.data()); },
+            [&](buffer<uint32_t>& out, size_t i){ drained.push_back(i); drain_sets.push_back(out.data()); });
+        CHECK_EQ(stats.items, 7ul);
+        CHECK_EQ(stats.depth, depth);
+        CHECK_EQ(stats.bytes_in, 7 * 1024 * sizeof(uint32_t));
+        CHECK_EQ(filled.size(), 7ul);
+        CHECK_EQ(drained.size(), 7ul);
+        for (size_t i = 0; i < 7; i++){
+            CHECK_EQ(filled[i], i);
+            CHECK_EQ(drained[i], i);
+            CHECK(fill_sets[i] == fill_sets[i % depth]);
+            CHECK(drain_sets[i] == drain_sets[i % depth]);
+        }
+    }
+}
+
+int main(){
+    test_utils::run("stream depth", test_depth);
+    test_utils::run("stream order", test_order);
+    return test_utils::failures();
+}
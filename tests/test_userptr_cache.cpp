@@ -0,0 +1,82 @@
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include "npu_device.hpp"
+#include "npu_userptr_cache.hpp"
+#include "test_utils.hpp"
+
+// Reuse and expiry of the user pointer BO cache on the simulated backend
+
+static void test_reuse(){
+    std::unique_ptr<npu_device> device = create_npu_device(npu_backend_sim);
+    npu_userptr_cache cache(*device);
+    uint8_t* memory = static_cast<uint8_t*>(std::aligned_alloc(4096, 8 * 4096));
+    CHECK_THROWS(cache.import(memory + 64, 4096, 3), "must start on a page boundary");
+    CHECK_THROWS(cache.import(memory, 0, 3), "cannot be empty");
+    {
+        npu_bo whole = cache.import(memory, 8 * 4096, 3);
+        CHECK(whole.map<uint8_t*>() == memory);
+        // the same range is the same BO
+        npu_bo again = cache.import(memory, 8 * 4096, 3);
+        CHECK(again.map<uint8_t*>() == memory);
+        // a range inside it is a sub-BO
+        npu_bo inside = cache.import(memory + 2 * 4096, 4096, 3);
+        CHECK_EQ(inside.size(), 4096ul);
+        CHECK(inside.map<uint8_t*>() == memory + 2 * 4096);
+        npu_userptr_stats stats = cache.stats();
+        CHECK_EQ(stats.requests, 3ul);
+        CHECK_EQ(stats.hits, 2ul);
+        CHECK_EQ(stats.misses, 1ul);
+        CHECK_EQ(stats.entries, 1ul);
+        CHECK_EQ(stats.registered_bytes, 8ul * 4096);
+
+        // another group, or a range past the end, is imported anew
+        npu_bo other_group = cache.import(memory, 4096, 4);
+        uint8_t* more = static_cast<uint8_t*>(std::aligned_alloc(4096, 4096));
+        npu_bo outside = cache.import(more, 4096, 3);
+        stats = cache.stats();
+        CHECK_EQ(stats.misses, 3ul);
+        CHECK_EQ(stats.entries, 3ul);
+        outside = npu_bo();
+        std::free(more);
+    }
+    npu_userptr_stats stats = cache.stats();
+    CHECK_EQ(stats.entries, 0ul);
+    CHECK_EQ(stats.releases, 3ul);
+    CHECK_EQ(stats.registered_bytes, 0ul);
+    std::free(memory);
+}
+
+// an entry lives as long as any BO handed out for it, sub-BOs included
+static void test_expiry(){
+    std::unique_ptr<npu_device> device = create_npu_device(npu_backend_sim);
+    npu_userptr_cache cache(*device);
+    uint8_t* memory = static_cast<uint8_t*>(std::aligned_alloc(4096, 4 * 4096));
+    npu_bo inside;
+    {
+        npu_bo whole = cache.import(memory, 4 * 4096, 3);
+        inside = cache.import(memory + 4096, 4096, 3);
+    }
+    CHECK_EQ(cache.stats().entries, 1ul);
+    npu_bo hit = cache.import(memory, 4 * 4096, 3);
+    CHECK_EQ(cache.stats().hits, 2ul);
+    hit = npu_bo();
+    inside = npu_bo();
+    CHECK_EQ(cache.stats().entries, 0ul);
+    CHECK_EQ(cache.stats().releases, 1ul);
+
+    // once released the range is pinned again, the memory may have been reallocated
+    npu_bo fresh = cache.import(memory, 4 * 4096, 3);
+    npu_userptr_stats stats = cache.stats();
+    CHECK_EQ(stats.hits, 2ul);
+    CHECK_EQ(stats.misses, 2ul);
+    CHECK_EQ(stats.entries, 1ul);
+    fresh = npu_bo();
+    std::free(memory);
+}
+
+int main(){
+    test_utils::run("userptr reuse", test_reuse);
+    test_utils::run("userptr expiry", test_expiry);
+    return test_utils::failures();
+}
@@ -0,0 +1,81 @@
+#ifndef __TEST_UTILS_HPP__
+#define __TEST_UTILS_HPP__
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+// Checks of the tests in tests/, run on the simulated backend by make test.
+// Each test file is one binary. main() runs its cases with test_utils::run() and returns
+// test_utils::failures(), so make test stops at the first binary with a failed case.
+
+namespace test_utils {
+
+struct check_failed : std::runtime_error{
+    using std::runtime_error::runtime_error;
+};
+
+inline int& failure_count(){
+    static int count = 0;
+    return count;
+}
+
+inline int failures() { return failure_count() > 0 ? 1 : 0; }
+
+// Runs one case, a failed check or any other exception fails it
+template<typename F>
+void run(const std::string& name, F test){
+    try{
+        test();
+        std::cout << "[ PASS ] " << name << std::endl;
+    }
+    catch (const std::exception& e){
+        failure_count()++;
+        std::cout << "[ FAIL ] " << name << ": " << e.what() << std::endl;
+    }
+}
+
+}
+
+#define CHECK(cond) \
+    do { \
+        if (!(cond)){ \
+            throw test_utils::check_failed(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #cond); \
+        } \
+    } while (0)
+
+#define CHECK_EQ(a, b) \
+    do { \
+        auto a_ = (a); \
+        auto b_ = (b); \
+        if (!(a_ == b_)){ \
+            std::ostringstream os_; \
+            os_ << __FILE__ << ":" << __LINE__ << ": " #a " == " #b ", got " << a_ << " and " << b_; \
+            throw test_utils::check_failed(os_.str()); \
+        } \
+    } while (0)
+
+// Checks that expr throws a std::exception whose message contains text
+#define CHECK_THROWS(expr, text) \
+    do { \
+        bool thrown_ = false; \
+        try{ \
+            expr; \
+        } \
+        catch (const test_utils::check_failed&){ \
+            throw; \
+        } \
+        catch (const std::exception& e_){ \
+            thrown_ = true; \
+            if (std::string(e_.what()).find(text) == std::string::npos){ \
+                throw test_utils::check_failed(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #expr \
+                    " threw \"" + e_.what() + "\", expected \"" + text + "\""); \
+            } \
+        } \
+        if (!thrown_){ \
+            throw test_utils::check_failed(std::string(__FILE__) + ":" + std::to_string(__LINE__) + ": " #expr " did not throw"); \
+        } \
+    } while (0)
+
+#endif
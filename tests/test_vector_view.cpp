@@ -0,0 +1,91 @@
+#include <cstdint>
+#include <vector>
+#include "vector_view.hpp"
+#include "test_utils.hpp"
+
+// gather and scatter of vector_view against the BD address formula, for every SIMD level of
+// this CPU and for one and several threads
+
+static std::vector<simd_level> cpu_levels(){
+    std::vector<simd_level> levels = {simd_scalar};
+    if (detect_simd_level() >= simd_avx2){
+        levels.push_back(simd_avx2);
+    }
+    if (detect_simd_level() >= simd_avx512){
+        levels.push_back(simd_avx512);
+    }
+    return levels;
+}
+
+static std::vector<buffer_ops_config> configs(){
+    std::vector<buffer_ops_config> cfgs;
+    for (simd_level level : cpu_levels()){
+        for (int threads : {1, 4}){
+            // small chunks, so the test sizes are split across the threads
+            cfgs.push_back({level, threads, 4096, nt_never});
+        }
+    }
+    return cfgs;
+}
+
+template<typename T>
+static void check_round_trip(size_t count, const bd_dims& dims){
+    for (const buffer_ops_config& cfg : configs()){
+        std::vector<T> data(count);
+        for (size_t i = 0; i < count; i++){
+            data[i] = (T)(i * 7 + 1);
+        }
+        vector_view<T> view(data.data(), data.size(), dims);
+        std::vector<T> packed(view.count());
+        view.gather(packed.data(), cfg);
+        for (size_t k = 0; k < packed.size(); k++){
+            if (packed[k] != data[view.index_at(k)]){
+                throw test_utils::check_failed("gather of " + bd_dims_str(dims) + " at " + simd_level_name(cfg.level)
+                    + " with " + std::to_string(cfg.threads) + " threads differs at element " + std::to_string(k));
+            }
+        }
+        CHECK_EQ(view.compare(packed.data(), 4, cfg).count, 0ul);
+
+        // scatter writes exactly the viewed elements
+        std::vector<T> out(count, (T)0);
+        vector_view<T> out_view(out.data(), out.size(), dims);
+        out_view.scatter(packed.data(), cfg);
+        std::vector<bool> viewed(count, false);
+        for (size_t k = 0; k < view.count(); k++){
+            viewed[view.index_at(k)] = true;
+        }
+        for (size_t i = 0; i < count; i++){
+            CHECK_EQ(out[i], viewed[i] ? data[i] : (T)0);
+        }
+    }
+}
+
+static void test_tiles(){
+    check_round_trip<uint32_t>(64 * 256, tile_dims(64, 256, 8, 16));
+    check_round_trip<uint32_t>(64 * 256, tile_dims(64, 256, 64, 4));
+    check_round_trip<uint16_t>(32 * 128, tile_dims(32, 128, 4, 32));
+    check_round_trip<uint8_t>(16 * 64, tile_dims(16, 64, 16, 64));
+    CHECK_THROWS(tile_dims(64, 256, 7, 16), "do not divide");
+}
+
+static void test_strided(){
+    // transpose of a 128 x 96 matrix: d0 walks down a column
+    check_round_trip<uint32_t>(128 * 96, bd_dims{2, {128, 96}, {96, 1}, 0});
+    check_round_trip<uint16_t>(128 * 96, bd_dims{2, {128, 96}, {96, 1}, 0});
+    // every third word, with an offset and a repeat
+    check_round_trip<uint32_t>(10000, bd_dims{3, {100, 10, 3}, {3, 300, 3000}, 5});
+    check_round_trip<uint32_t>(4096, linear_dims(1000, 17));
+}
+
+static void test_bounds(){
+    std::vector<uint32_t> data(100);
+    CHECK_THROWS(vector_view<uint32_t>(data.data(), data.size(), bd_dims{2, {10, 11}, {1, 10}, 0}), "reaches element 110");
+    CHECK_THROWS(vector_view<uint32_t>(data.data(), data.size(), bd_dims{2, {10, 0}, {1, 10}, 0}), "empty dimension");
+}
+
+int main(){
+    test_utils::run("tile gather and scatter", test_tiles);
+    test_utils::run("strided gather and scatter", test_strided);
+    test_utils::run("view bounds", test_bounds);
+    return test_utils::failures();
+}
@@ -0,0 +1,484 @@
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "debug_utils.hpp"
+
+// Offline regression check for bwbench results.
+// Reads the JSON lines or CSV files written by run.exe --json/--csv, matches the records of
+// the current run against a baseline by configuration, and compares the per-batch bandwidth
+// samples with a one sided Mann-Whitney U test. A point regresses when the test is significant
+// and the median dropped by more than the threshold. The exit code is 1 when any point
+// regressed. With --update the current records replace the matching baseline records.
+
+namespace po = boost::program_options;
+
+// One flat record, arrays are kept as ';' separated strings like in the CSV output.
+// The keys of string values are kept in strings, so the rest is written back unquoted.
+struct record : std::map<std::string, std::string>{
+    std::set<std::string> strings;
+};
+
+static std::vector<std::string> split(const std::string& s, char sep){
+    std::vector<std::string> items;
+    std::string item;
+    std::stringstream ss(s);
+    while (std::getline(ss, item, sep)){
+        items.push_back(item);
+    }
+    return items;
+}
+
+static std::string parse_json_string(const std::string& line, size_t& pos){
+    std::string out;
+    pos++; // opening quote
+    while (pos < line.size() && line[pos] != '"'){
+        char c = line[pos++];
+        if (c == '\\' && pos < line.size()){
+            char e = line[pos++];
+            switch (e){
+                case 'n': out += '\n'; break;
+                case 't': out += '\t'; break;
+                case 'r': out += '\r'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'u': out += (char)std::stoi(line.substr(pos, 4), nullptr, 16); pos += 4; break;
+                default: out += e;
+            }
+        }
+        else{
+            out += c;
+        }
+    }
+    pos++; // closing quote
+    return out;
+}
+
+static void skip_spaces(const std::string& line, size_t& pos){
+    while (pos < line.size() && std::isspace((unsigned char)line[pos])){
+        pos++;
+    }
+}
+
+// Flat objects only: strings, numbers, literals and arrays of numbers
+static record parse_json_line(const std::string& line){
+    record r;
+    size_t pos = line.find('{');
+    if (pos == std::string::npos){
+        throw std::runtime_error("Not a JSON object: " + line);
+    }
+    pos++;
+    while (true){
+        skip_spaces(line, pos);
+        if (pos >= line.size() || line[pos] == '}'){
+            break;
+        }
+        std::string key = parse_json_string(line, pos);
+        skip_spaces(line, pos);
+        pos++; // ':'
+        skip_spaces(line, pos);
+        std::string value;
+        if (line[pos] == '"'){
+            value = parse_json_string(line, pos);
+            r.strings.insert(key);
+        }
+        else if (line[pos] == '['){
+            size_t end = line.find(']', pos);
+            value = line.substr(pos + 1, end - pos - 1);
+            std::replace(value.begin(), value.end(), ',', ';');
+            value.erase(std::remove_if(value.begin(), value.end(), ::isspace), value.end());
+            pos = end + 1;
+        }
+        else{
+            size_t end = line.find_first_of(",}", pos);
+            value = line.substr(pos, end - pos);
+            value = (value == "null") ? "" : value;
+            pos = end;
+        }
+        r[key] = value;
+        skip_spaces(line, pos);
+        if (pos < line.size() && line[pos] == ','){
+            pos++;
+        }
+    }
+    return r;
+}
+
+static std::vector<std::string> parse_csv_line(const std::string& line){
+    std::vector<std::string> cells;
+    std::string cell;
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); i++){
+        char c = line[i];
+        if (quoted){
+            if (c == '"' && i + 1 < line.size() && line[i + 1] == '"'){
+                cell += '"';
+                i++;
+            }
+            else if (c == '"'){
+                quoted = false;
+            }
+            else{
+                cell += c;
+            }
+        }
+        else if (c == '"'){
+            quoted = true;
+        }
+        else if (c == ','){
+            cells.push_back(cell);
+            cell.clear();
+        }
+        else{
+            cell += c;
+        }
+    }
+    cells.push_back(cell);
+    return cells;
+}
+
+// Whole value is a JSON number, -?(0|[1-9][0-9]*)(.[0-9]+)?([eE][+-]?[0-9]+)?
+static bool is_json_number(const std::string& s){
+    size_t i = 0;
+    auto digits = [&](){
+        size_t start = i;
+        while (i < s.size() && std::isdigit((unsigned char)s[i])){
+            i++;
+        }
+        return i > start;
+    };
+    if (i < s.size() && s[i] == '-'){
+        i++;
+    }
+    if (i < s.size() && s[i] == '0'){
+        i++;
+    }
+    else if (!digits()){
+        return false;
+    }
+    if (i < s.size() && s[i] == '.'){
+        i++;
+        if (!digits()){
+            return false;
+        }
+    }
+    if (i < s.size() && (s[i] == 'e' || s[i] == 'E')){
+        i++;
+        if (i < s.size() && (s[i] == '+' || s[i] == '-')){
+            i++;
+        }
+        if (!digits()){
+            return false;
+        }
+    }
+    return i == s.size();
+}
+
+// Columns that run.exe writes as strings (result_writer.hpp). Their CSV cells stay strings
+// even when they read as numbers, like aie_version "2.0" or an empty fw_version.
+static const std::set<std::string> string_columns = {
+    "timestamp", "name", "device", "host", "kernel", "backend", "fw_version", "aie_version", "power_mode",
+    "integrity", "pattern", "path", "phase", "policy", "error", "op", "op_kernel", "shape", "dims", "format",
+    "qos", "competitor"
+};
+
+static std::vector<record> load_records(const std::string& path){
+    std::ifstream file(path);
+    if (!file){
+        throw std::runtime_error("Unable to open " + path);
+    }
+    std::vector<record> records;
+    std::vector<std::string> header;
+    std::string line;
+    while (std::getline(file, line)){
+        if (line.empty()){
+            continue;
+        }
+        if (line[0] == '{'){
+            records.push_back(parse_json_line(line));
+            continue;
+        }
+        std::vector<std::string> cells = parse_csv_line(line);
+        // Concatenated CSV files repeat the header
+        if (header.empty() || cells == header){
+            header = cells;
+            continue;
+        }
+        record r;
+        for (size_t i = 0; i < header.size() && i < cells.size(); i++){
+            r[header[i]] = cells[i];
+            // CSV cells have no type: the writer's string columns are strings, an empty cell of
+            // any other column is a null number, and unknown columns are told apart by their text
+            if (string_columns.count(header[i])){
+                r.strings.insert(header[i]);
+            }
+            else if (!cells[i].empty() && !is_json_number(cells[i]) && cells[i] != "true" && cells[i] != "false"){
+                r.strings.insert(header[i]);
+            }
+        }
+        records.push_back(r);
+    }
+    return records;
+}
+
+// Records of the same design point, batch size and backend are comparable
+static std::string key_of(const record& r){
+    auto get = [&](const std::string& k){
+        auto it = r.find(k);
+        return it == r.end() ? std::string() : it->second;
+    };
+    return get("name") + "/" + get("device") + "/" + get("backend") + "/i" + get("iterations");
+}
+
+static std::vector<double> samples_of(const record& r){
+    std::vector<double> samples;
+    auto it = r.find("bandwidth_samples_gibps");
+    if (it != r.end()){
+        for (const std::string& s : split(it->second, ';')){
+            if (!s.empty()){
+                samples.push_back(std::stod(s));
+            }
+        }
+    }
+    if (samples.empty() && r.count("bandwidth_gibps") && !r.at("bandwidth_gibps").empty()){
+        samples.push_back(std::stod(r.at("bandwidth_gibps")));
+    }
+    return samples;
+}
+
+static double median(std::vector<double> v){
+    std::sort(v.begin(), v.end());
+    size_t n = v.size();
+    return (n % 2) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+typedef struct {
+    double u;           // U statistic of the current samples
+    double p_less;      // one sided p value of current < baseline
+    double cliffs_delta; // in [-1, 1], negative when current is smaller
+} mann_whitney_result;
+
+// Mann-Whitney U with average ranks for ties and the tie corrected normal approximation
+static mann_whitney_result mann_whitney(const std::vector<double>& base, const std::vector<double>& cur){
+    size_t n1 = base.size();
+    size_t n2 = cur.size();
+    std::vector<std::pair<double, int>> all;
+    for (double v : base){
+        all.push_back({v, 0});
+    }
+    for (double v : cur){
+        all.push_back({v, 1});
+    }
+    std::sort(all.begin(), all.end());
+    double rank_sum_cur = 0.0;
+    double tie_term = 0.0;
+    for (size_t i = 0; i < all.size();){
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first){
+            j++;
+        }
+        double rank = 0.5 * (i + 1 + j); // average of ranks i+1 .. j
+        for (size_t k = i; k < j; k++){
+            rank_sum_cur += all[k].second ? rank : 0.0;
+        }
+        double t = j - i;
+        tie_term += t * t * t - t;
+        i = j;
+    }
+    mann_whitney_result result;
+    result.u = rank_sum_cur - n2 * (n2 + 1) / 2.0;
+    double n = n1 + n2;
+    double mean = n1 * n2 / 2.0;
+    double var = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)));
+    if (var <= 0.0){
+        result.p_less = 1.0;
+    }
+    else{
+        double z = (result.u - mean + 0.5) / std::sqrt(var); // continuity correction
+        result.p_less = 0.5 * std::erfc(-z / std::sqrt(2.0));
+    }
+    result.cliffs_delta = 2.0 * result.u / (n1 * n2) - 1.0;
+    return result;
+}
+
+static std::string json_string(const std::string& s){
+    std::string out = "\"";
+    for (char c : s){
+        switch (c){
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\t': out += "\\t"; break;
+            case '\r': out += "\\r"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                if ((unsigned char)c < 0x20){
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", (unsigned char)c);
+                    out += buf;
+                }
+                else{
+                    out += c;
+                }
+        }
+    }
+    return out + "\"";
+}
+
+static void write_records(const std::vector<record>& records, const std::string& path){
+    std::ofstream file(path);
+    if (!file){
+        throw std::runtime_error("Unable to write " + path);
+    }
+    for (const record& r : records){
+        file << "{";
+        bool first = true;
+        for (const auto& kv : r){
+            file << (first ? "" : ",") << json_string(kv.first) << ":";
+            first = false;
+            if (kv.first == "bandwidth_samples_gibps"){
+                std::string items = kv.second;
+                std::replace(items.begin(), items.end(), ';', ',');
+                file << "[" << items << "]";
+            }
+            else if (r.strings.count(kv.first)){
+                file << json_string(kv.second);
+            }
+            else{
+                file << (kv.second.empty() ? "null" : kv.second);
+            }
+        }
+        file << "}\n";
+    }
+}
+
+int main(int argc, const char *argv[]) {
+    po::options_description desc("Allowed options");
+    po::variables_map vm;
+    desc.add_options()("help,h", "produce help message");
+    desc.add_options()("baseline", po::value<std::string>()->required(), "Baseline results (JSON lines or CSV)");
+    desc.add_options()("current", po::value<std::string>()->required(), "Results of the new run (JSON lines or CSV)");
+    desc.add_options()("threshold", po::value<double>()->default_value(0.02), "Relative median drop that counts as a regression");
+    desc.add_options()("alpha", po::value<double>()->default_value(0.01), "Significance level of the test");
+    desc.add_options()("update", "Store the current records into the baseline file afterwards");
+    try {
+        po::store(po::parse_command_line(argc, argv, desc), vm);
+        if (vm.count("help")) {
+            std::cout << desc << "\n";
+            return 0;
+        }
+        po::notify(vm);
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << "\n\n";
+        std::cerr << "Usage:\n" << desc << "\n";
+        return 2;
+    }
+    double threshold = vm["threshold"].as<double>();
+    double alpha = vm["alpha"].as<double>();
+
+    std::vector<record> baseline;
+    std::vector<record> current;
+    try {
+        std::ifstream probe(vm["baseline"].as<std::string>());
+        if (probe || !vm.count("update")){
+            baseline = load_records(vm["baseline"].as<std::string>());
+        }
+        current = load_records(vm["current"].as<std::string>());
+    } catch (const std::exception &ex) {
+        header_print("error", ex.what());
+        return 2;
+    }
+
+    // The latest record of a configuration wins
+    std::map<std::string, record> base_by_key;
+    for (const record& r : baseline){
+        base_by_key[key_of(r)] = r;
+    }
+
+    int regressions = 0;
+    const int width = 120;
+    MSG_BONDLINE(width);
+    MSG_BOX_LINE(width, std::left << std::setw(44) << "point" << std::right << std::setw(12) << "base GiB/s" << std::setw(12) << "cur GiB/s"
+        << std::setw(10) << "change" << std::setw(12) << "p" << std::setw(10) << "delta" << std::setw(14) << "verdict");
+    MSG_BONDLINE(width);
+    for (const record& cur : current){
+        std::string key = key_of(cur);
+        auto integrity = cur.find("integrity");
+        if (integrity != cur.end() && integrity->second == "fail"){
+            // Bandwidth of corrupted transfers does not count
+            MSG_BOX_LINE(width, std::left << std::setw(44) << key << std::right << std::setw(70) << "CORRUPT");
+            regressions++;
+            continue;
+        }
+        auto it = base_by_key.find(key);
+        std::vector<double> cur_samples = samples_of(cur);
+        if (it == base_by_key.end() || cur_samples.empty()){
+            MSG_BOX_LINE(width, std::left << std::setw(44) << key << std::right << std::setw(70) << (cur_samples.empty() ? "no samples" : "no baseline"));
+            continue;
+        }
+        std::vector<double> base_samples = samples_of(it->second);
+        if (base_samples.empty()){
+            MSG_BOX_LINE(width, std::left << std::setw(44) << key << std::right << std::setw(70) << "no baseline samples");
+            continue;
+        }
+        double base_median = median(base_samples);
+        double cur_median = median(cur_samples);
+        double change = (cur_median - base_median) / base_median;
+        std::string verdict = "ok";
+        double p = NAN;
+        double delta = NAN;
+        if (base_samples.size() >= 2 && cur_samples.size() >= 2){
+            mann_whitney_result mw = mann_whitney(base_samples, cur_samples);
+            p = mw.p_less;
+            delta = mw.cliffs_delta;
+            if (p < alpha && -change > threshold){
+                verdict = "REGRESSION";
+            }
+            else if (-change > threshold){
+                verdict = "noisy";
+            }
+        }
+        else if (-change > threshold){
+            // A single number per side cannot be tested, only flagged
+            verdict = "REGRESSION?";
+        }
+        regressions += (verdict == "REGRESSION" || verdict == "REGRESSION?");
+        MSG_BOX_LINE(width, std::left << std::setw(44) << key << std::right << std::fixed << std::setprecision(3)
+            << std::setw(12) << base_median << std::setw(12) << cur_median
+            << std::setw(9) << std::setprecision(2) << change * 100 << "%" << std::setw(12) << std::scientific << std::setprecision(2) << p
+            << std::setw(10) << std::fixed << delta << std::setw(14) << verdict);
+    }
+    MSG_BONDLINE(width);
+
+    if (vm.count("update")){
+        for (const record& r : current){
+            auto integrity = r.find("integrity");
+            if (integrity == r.end() || integrity->second != "fail"){
+                base_by_key[key_of(r)] = r;
+            }
+        }
+        std::vector<record> merged;
+        for (const auto& kv : base_by_key){
+            merged.push_back(kv.second);
+        }
+        write_records(merged, vm["baseline"].as<std::string>());
+        header_print("info", "Stored " << merged.size() << " records in " << vm["baseline"].as<std::string>());
+    }
+
+    if (regressions > 0){
+        header_print("error", regressions << " regression(s) above " << threshold * 100 << "%");
+        return 1;
+    }
+    return 0;
+}